@@ -6,4 +6,7 @@
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, AfterCurfew, "AfterCurfew" );
 
 DEFINE_LOG_CATEGORY(LogAfterCurfew)
- 
\ No newline at end of file
+
+DEFINE_STAT(STAT_AfterCurfewProjectilesInFlight);
+
+FAfterCurfewCounters GAfterCurfewCounters;
@@ -5,3 +5,75 @@
 #include "CoreMinimal.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogAfterCurfew, Log, All);
+
+/**
+ * Everything the module measures, shown with "stat AfterCurfew".
+ * Cycle counters also show up as named events in external CPU profilers after "stat namedevents".
+ */
+DECLARE_STATS_GROUP(TEXT("AfterCurfew"), STATGROUP_AfterCurfew, STATCAT_Advanced);
+
+/** Projectiles in flight across both backends, kept up to date by whoever spawns or releases them */
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Projectiles In Flight"), STAT_AfterCurfewProjectilesInFlight, STATGROUP_AfterCurfew, AFTERCURFEW_API);
+
+/**
+ * Running totals of the work done by the module, updated on the game thread.
+ * Readers sample them once per frame and take differences to get rates.
+ */
+struct FAfterCurfewCounters
+{
+	/** Projectiles put into flight, by either backend */
+	uint64 ProjectilesSpawned;
+
+	/** Projectiles taken out of flight, by either backend */
+	uint64 ProjectilesReleased;
+
+	/** Sweeps issued by pawn movement */
+	uint64 MoveSweeps;
+
+	/** Sweeps issued by projectile movement, by either backend */
+	uint64 ProjectileSweeps;
+
+	/** Projectile hits queued with the hit resolver, by either backend */
+	uint64 ProjectileHits;
+
+	/** Cycles spent in pawn ticks, counted without stats so shipping builds have them too */
+	uint64 PawnTickCycles;
+
+	/** Frame time pawn movement dropped past its step limit, in microseconds */
+	uint64 MoveTimeDroppedUs;
+
+	FAfterCurfewCounters()
+		: ProjectilesSpawned(0)
+		, ProjectilesReleased(0)
+		, MoveSweeps(0)
+		, ProjectileSweeps(0)
+		, ProjectileHits(0)
+		, PawnTickCycles(0)
+		, MoveTimeDroppedUs(0)
+	{
+	}
+
+	/** Projectiles currently in flight */
+	FORCEINLINE int64 GetProjectilesAlive() const { return int64(ProjectilesSpawned) - int64(ProjectilesReleased); }
+};
+
+extern AFTERCURFEW_API FAfterCurfewCounters GAfterCurfewCounters;
+
+/** Adds the cycles spent in its scope to one of the counters */
+struct FAfterCurfewScopeCycles
+{
+	explicit FAfterCurfewScopeCycles(uint64& InTotal)
+		: Total(InTotal)
+		, StartCycles(FPlatformTime::Cycles64())
+	{
+	}
+
+	~FAfterCurfewScopeCycles()
+	{
+		Total += FPlatformTime::Cycles64() - StartCycles;
+	}
+
+private:
+	uint64& Total;
+	uint64 StartCycles;
+};
@@ -0,0 +1,43 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewAIController.h"
+#include "AfterCurfewPawn.h"
+#include "AfterCurfewSteeringManager.h"
+#include "Engine/World.h"
+
+AAfterCurfewAIController::AAfterCurfewAIController()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	bWantsPlayerState = false;
+}
+
+void AAfterCurfewAIController::OnPossess(APawn* InPawn)
+{
+	Super::OnPossess(InPawn);
+
+	AAfterCurfewPawn* AfterCurfewPawn = Cast<AAfterCurfewPawn>(InPawn);
+	if (AfterCurfewPawn == nullptr)
+	{
+		return;
+	}
+
+	SteeringManager = AAfterCurfewSteeringManager::Get(GetWorld());
+	if (SteeringManager.IsValid())
+	{
+		SteeringManager->RegisterPawn(AfterCurfewPawn);
+	}
+}
+
+void AAfterCurfewAIController::OnUnPossess()
+{
+	AAfterCurfewPawn* AfterCurfewPawn = Cast<AAfterCurfewPawn>(GetPawn());
+	if (AfterCurfewPawn != nullptr && SteeringManager.IsValid())
+	{
+		SteeringManager->UnregisterPawn(AfterCurfewPawn);
+	}
+	SteeringManager.Reset();
+
+	Super::OnUnPossess();
+}
@@ -0,0 +1,33 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Controller.h"
+#include "AfterCurfewAIController.generated.h"
+
+class AAfterCurfewSteeringManager;
+
+/**
+ * Drives an AfterCurfew pawn without a player.
+ * The controller itself does no work: the world's steering manager decides for all AI pawns at once and feeds each
+ * of them the same move, lift, aim and fire intents a player's input bindings would.
+ */
+UCLASS()
+class AFTERCURFEW_API AAfterCurfewAIController : public AController
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewAIController();
+
+protected:
+	// Begin Controller Interface
+	virtual void OnPossess(APawn* InPawn) override;
+	virtual void OnUnPossess() override;
+	// End Controller Interface
+
+private:
+	/** Manager steering our pawn */
+	TWeakObjectPtr<AAfterCurfewSteeringManager> SteeringManager;
+};
@@ -0,0 +1,222 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewAimComponent.h"
+#include "AfterCurfew.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "DrawDebugHelpers.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Aim Resolve"), STAT_AfterCurfewAim, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Aim Resolves"), STAT_AfterCurfewAimResolves, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Aim Traces"), STAT_AfterCurfewAimTraces, STATGROUP_AfterCurfew);
+
+#if ENABLE_DRAW_DEBUG
+static TAutoConsoleVariable<int32> CVarAimDrawDebug(
+	TEXT("ac.Aim.DrawDebug"),
+	1,
+	TEXT("Draws a line from each player pawn to its aim location."),
+	ECVF_Cheat);
+#endif
+
+UAfterCurfewAimComponent::UAfterCurfewAimComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	AimMode = EAfterCurfewAimMode::AimPlane;
+	CameraTolerance = 0.1f;
+
+	LastMousePosition = FVector2D::ZeroVector;
+	LastCameraLocation = FVector::ZeroVector;
+	LastCameraRotation = FRotator::ZeroRotator;
+	LastPlaneZ = 0.f;
+	AimLocation = FVector::ZeroVector;
+	AimTarget = FVector::ZeroVector;
+	bHasCachedAim = false;
+	bHasAimTarget = false;
+	bCosmeticsEnabled = true;
+}
+
+void UAfterCurfewAimComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	TraceService = AAfterCurfewTraceService::Get(GetWorld());
+}
+
+void UAfterCurfewAimComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (TraceService.IsValid())
+	{
+		TraceService->Cancel(CursorTrace);
+	}
+	CursorTrace.Reset();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UAfterCurfewAimComponent::SetAimTarget(const FVector& Target)
+{
+	AimTarget = Target;
+	bHasAimTarget = true;
+}
+
+void UAfterCurfewAimComponent::ClearAimTarget()
+{
+	bHasAimTarget = false;
+	bHasCachedAim = false;
+}
+
+APlayerController* UAfterCurfewAimComponent::GetPlayerController()
+{
+	APawn* PawnOwner = Cast<APawn>(GetOwner());
+	AController* Controller = PawnOwner != nullptr ? PawnOwner->GetController() : nullptr;
+
+	if (Controller != CachedController.Get())
+	{
+		CachedController = Cast<APlayerController>(Controller);
+		bHasCachedAim = false;
+	}
+	return CachedController.Get();
+}
+
+FVector UAfterCurfewAimComponent::UpdateAim()
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewAim);
+
+	AActor* const Owner = GetOwner();
+	const FVector OwnerLocation = Owner->GetActorLocation();
+
+	APlayerController* const PlayerController = GetPlayerController();
+
+	if (bHasAimTarget)
+	{
+		AimLocation = AimTarget;
+	}
+	else if (PlayerController != nullptr && PlayerController->IsLocalController())
+	{
+		FVector2D MousePosition(LastMousePosition);
+		PlayerController->GetMousePosition(MousePosition.X, MousePosition.Y);
+
+		const APlayerCameraManager* CameraManager = PlayerController->PlayerCameraManager;
+		const FVector CameraLocation = CameraManager != nullptr ? CameraManager->GetCameraLocation() : FVector::ZeroVector;
+		const FRotator CameraRotation = CameraManager != nullptr ? CameraManager->GetCameraRotation() : FRotator::ZeroRotator;
+
+		// The plane follows the pawn up and down, a trace only depends on the view
+		const float PlaneZ = AimMode == EAfterCurfewAimMode::AimPlane ? OwnerLocation.Z : 0.f;
+
+		// A trace started on an earlier frame may have come back
+		FVector TracedLocation;
+		if (FetchCursorTrace(TracedLocation))
+		{
+			AimLocation = TracedLocation;
+			bHasCachedAim = true;
+		}
+
+		// Without an aim yet keep resolving, unless a trace for this view is still on its way
+		const bool bViewChanged = (!bHasCachedAim && !CursorTrace.IsValid())
+			|| MousePosition != LastMousePosition
+			|| !CameraLocation.Equals(LastCameraLocation, CameraTolerance)
+			|| !CameraRotation.Equals(LastCameraRotation, KINDA_SMALL_NUMBER)
+			|| PlaneZ != LastPlaneZ;
+
+		if (bViewChanged)
+		{
+			FVector CursorLocation;
+			if (ResolveCursor(PlayerController, PlaneZ, CursorLocation))
+			{
+				AimLocation = CursorLocation;
+				bHasCachedAim = true;
+			}
+
+			LastMousePosition = MousePosition;
+			LastCameraLocation = CameraLocation;
+			LastCameraRotation = CameraRotation;
+			LastPlaneZ = PlaneZ;
+		}
+	}
+
+	if (!bHasAimTarget && !bHasCachedAim)
+	{
+		// Nothing to aim at yet, keep facing forward
+		AimLocation = OwnerLocation + Owner->GetActorForwardVector() * 1000.f;
+	}
+
+#if ENABLE_DRAW_DEBUG
+	if (bCosmeticsEnabled && CVarAimDrawDebug.GetValueOnGameThread() != 0 && PlayerController != nullptr)
+	{
+		DrawDebugLine(GetWorld(), OwnerLocation, AimLocation, FColor::Red, false);
+	}
+#endif
+
+	return AimLocation;
+}
+
+bool UAfterCurfewAimComponent::ResolveCursor(APlayerController* PlayerController, float PlaneZ, FVector& OutLocation)
+{
+	INC_DWORD_STAT(STAT_AfterCurfewAimResolves);
+
+	FVector RayOrigin;
+	FVector RayDirection;
+	if (!PlayerController->DeprojectMousePositionToWorld(RayOrigin, RayDirection))
+	{
+		return false;
+	}
+
+	if (AimMode == EAfterCurfewAimMode::AimPlane && !FMath::IsNearlyZero(RayDirection.Z))
+	{
+		const float Distance = (PlaneZ - RayOrigin.Z) / RayDirection.Z;
+		if (Distance > 0.f)
+		{
+			OutLocation = RayOrigin + RayDirection * Distance;
+			return true;
+		}
+	}
+
+	// Ray runs parallel to or away from the plane, fall back to the scene
+	INC_DWORD_STAT(STAT_AfterCurfewAimTraces);
+
+	// Same query as GetHitResultUnderCursor, run off the game thread and picked up on a later update
+	if (TraceService.IsValid())
+	{
+		TraceService->Cancel(CursorTrace);
+
+		const FVector TraceEnd = RayOrigin + RayDirection * PlayerController->HitResultTraceDistance;
+		const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(AfterCurfewAimTrace), true);
+		CursorTrace = TraceService->RequestLineTrace(RayOrigin, TraceEnd, ECC_Camera, QueryParams, EAfterCurfewTracePriority::High);
+		return false;
+	}
+
+	FHitResult TraceHitResult;
+	if (PlayerController->GetHitResultUnderCursor(ECC_Camera, true, TraceHitResult))
+	{
+		OutLocation = TraceHitResult.Location;
+		return true;
+	}
+	return false;
+}
+
+bool UAfterCurfewAimComponent::FetchCursorTrace(FVector& OutLocation)
+{
+	if (!CursorTrace.IsValid() || !TraceService.IsValid())
+	{
+		return false;
+	}
+
+	FHitResult TraceHitResult;
+	const EAfterCurfewTraceStatus Status = TraceService->FetchResult(CursorTrace, TraceHitResult);
+	if (Status == EAfterCurfewTraceStatus::Pending)
+	{
+		return false;
+	}
+
+	CursorTrace.Reset();
+	if (Status == EAfterCurfewTraceStatus::Done && TraceHitResult.bBlockingHit)
+	{
+		OutLocation = TraceHitResult.Location;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,102 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "AfterCurfewTraceService.h"
+#include "AfterCurfewAimComponent.generated.h"
+
+class APlayerController;
+
+/** How the cursor is turned into a world aim location */
+UENUM()
+enum class EAfterCurfewAimMode : uint8
+{
+	/** Intersect the cursor ray with a horizontal plane at the pawn's height, tracing only when the ray misses the plane */
+	AimPlane,
+	/** Trace the cursor ray against complex collision */
+	ComplexTrace,
+};
+
+/**
+ * Resolves where a pawn is aiming.
+ * The result is cached and only recomputed when the cursor, the camera or the pawn's height changed since the last update.
+ * Cursor traces go through the world's trace service, so a traced aim location lands the frame after the cursor moved.
+ */
+UCLASS(ClassGroup = (AfterCurfew), meta = (BlueprintSpawnableComponent))
+class AFTERCURFEW_API UAfterCurfewAimComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UAfterCurfewAimComponent();
+
+	// Begin ActorComponent Interface
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	// End ActorComponent Interface
+
+	/** Resolves the aim location for this frame and returns it */
+	FVector UpdateAim();
+
+	/** Returns the aim location from the last update */
+	FORCEINLINE FVector GetAimLocation() const { return AimLocation; }
+
+	/** Aims at a fixed world location instead of the cursor, for pawns without a player controller */
+	void SetAimTarget(const FVector& Target);
+
+	/** Goes back to aiming with the cursor */
+	void ClearAimTarget();
+
+	/** Turns debug drawing on or off */
+	FORCEINLINE void SetCosmeticsEnabled(bool bEnabled) { bCosmeticsEnabled = bEnabled; }
+
+	/** How the cursor is resolved */
+	UPROPERTY(Category = Aim, EditAnywhere)
+	EAfterCurfewAimMode AimMode;
+
+	/** How far the camera may move, in cm, before the aim is resolved again */
+	UPROPERTY(Category = Aim, EditAnywhere)
+	float CameraTolerance;
+
+private:
+	/** Returns the player controller possessing our pawn, refreshing the cached one if the pawn changed hands */
+	APlayerController* GetPlayerController();
+
+	/** Computes the world location under the cursor, returns false if the cursor could not be resolved yet */
+	bool ResolveCursor(APlayerController* PlayerController, float PlaneZ, FVector& OutLocation);
+
+	/** Picks up the cursor trace once it finished, returns true if it hit something */
+	bool FetchCursorTrace(FVector& OutLocation);
+
+	/** Service running our cursor traces, cached on BeginPlay */
+	TWeakObjectPtr<AAfterCurfewTraceService> TraceService;
+
+	/** Cursor trace in flight, only the latest one counts */
+	FAfterCurfewTraceHandle CursorTrace;
+
+	/** Controller last seen possessing our pawn */
+	TWeakObjectPtr<APlayerController> CachedController;
+
+	/** View state the cached aim location was computed from */
+	FVector2D LastMousePosition;
+	FVector LastCameraLocation;
+	FRotator LastCameraRotation;
+	float LastPlaneZ;
+
+	/** Aim location from the last update */
+	FVector AimLocation;
+
+	/** Fixed aim location set through SetAimTarget */
+	FVector AimTarget;
+
+	/** Flag set once AimLocation holds a resolved cursor location */
+	uint32 bHasCachedAim : 1;
+
+	/** Flag set while aiming at AimTarget instead of the cursor */
+	uint32 bHasAimTarget : 1;
+
+	/** Flag cleared while the owner is too insignificant for debug drawing */
+	uint32 bCosmeticsEnabled : 1;
+};
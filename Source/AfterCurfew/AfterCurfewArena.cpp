@@ -0,0 +1,479 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewArena.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewPawn.h"
+#include "AfterCurfewSpatialHash.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DECLARE_CYCLE_STAT(TEXT("Arena Streaming Update"), STAT_AfterCurfewArenaStreaming, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Arena Chunk Build"), STAT_AfterCurfewArenaBuild, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Arena Chunks Loaded"), STAT_AfterCurfewArenaChunks, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Arena Instances"), STAT_AfterCurfewArenaInstances, STATGROUP_AfterCurfew);
+
+FAfterCurfewArenaLayout::FAfterCurfewArenaLayout()
+	: Width(0)
+	, Height(0)
+	, TileSize(400.f)
+	, WallHeight(400.f)
+	, ChunkSize(16)
+{
+}
+
+void FAfterCurfewArenaLayout::Init(int32 InWidth, int32 InHeight)
+{
+	Width = InWidth;
+	Height = InHeight;
+	Tiles.Reset();
+	Tiles.AddZeroed(Width * Height);
+}
+
+bool FAfterCurfewArenaLayout::Parse(const FString& Text, FString& OutError)
+{
+	*this = FAfterCurfewArenaLayout();
+
+	TArray<FString> Lines;
+	Text.ParseIntoArrayLines(Lines, false);
+
+	TArray<const FString*> Rows;
+	for (int32 LineIndex = 0; LineIndex < Lines.Num(); ++LineIndex)
+	{
+		const FString& Line = Lines[LineIndex];
+		if (Line.StartsWith(TEXT(";")) || (Rows.Num() == 0 && Line.TrimStartAndEnd().IsEmpty()))
+		{
+			continue;
+		}
+
+		FString Key;
+		FString Value;
+		if (Rows.Num() == 0 && Line.Split(TEXT("="), &Key, &Value))
+		{
+			if (Key == TEXT("TileSize"))
+			{
+				TileSize = FCString::Atof(*Value);
+			}
+			else if (Key == TEXT("WallHeight"))
+			{
+				WallHeight = FCString::Atof(*Value);
+			}
+			else if (Key == TEXT("ChunkSize"))
+			{
+				ChunkSize = FCString::Atoi(*Value);
+			}
+			else
+			{
+				OutError = FString::Printf(TEXT("line %d: unknown key %s"), LineIndex + 1, *Key);
+				*this = FAfterCurfewArenaLayout();
+				return false;
+			}
+			continue;
+		}
+
+		Rows.Add(&Line);
+	}
+
+	// Trailing blank lines are not rows
+	while (Rows.Num() > 0 && Rows.Last()->TrimStartAndEnd().IsEmpty())
+	{
+		Rows.Pop(false);
+	}
+
+	if (TileSize <= 0.f || WallHeight <= 0.f || ChunkSize < 1)
+	{
+		OutError = TEXT("TileSize, WallHeight and ChunkSize must be positive");
+		*this = FAfterCurfewArenaLayout();
+		return false;
+	}
+
+	int32 NewWidth = 0;
+	for (const FString* Row : Rows)
+	{
+		NewWidth = FMath::Max(NewWidth, Row->Len());
+	}
+	Init(NewWidth, Rows.Num());
+
+	for (int32 Y = 0; Y < Rows.Num(); ++Y)
+	{
+		const FString& Row = *Rows[Y];
+		for (int32 X = 0; X < Row.Len(); ++X)
+		{
+			switch (Row[X])
+			{
+			case TEXT('.'):
+				SetTile(X, Y, EAfterCurfewArenaTile::Floor);
+				break;
+			case TEXT('X'):
+				SetTile(X, Y, EAfterCurfewArenaTile::Wall);
+				break;
+			case TEXT('P'):
+				SetTile(X, Y, EAfterCurfewArenaTile::Pillar);
+				break;
+			case TEXT(' '):
+			case TEXT('-'):
+				break;
+			default:
+				OutError = FString::Printf(TEXT("row %d: unknown tile '%c'"), Y + 1, Row[X]);
+				*this = FAfterCurfewArenaLayout();
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+AAfterCurfewArena::AAfterCurfewArena()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+	RootComponent->SetMobility(EComponentMobility::Static);
+
+	BlockMesh = TSoftObjectPtr<UStaticMesh>(FSoftObjectPath(TEXT("/Game/Geometry/Meshes/1M_Cube.1M_Cube")));
+	FloorThickness = 100.f;
+	PillarScale = 0.5f;
+	bStreamChunks = true;
+	StreamInRadius = 8000.f;
+	StreamOutRadius = 10000.f;
+	MaxChunkBuildsPerUpdate = 2;
+	StreamingInterval = 0.2f;
+
+	LoadedBlockMesh = nullptr;
+	LayoutOrigin = FVector::ZeroVector;
+}
+
+void AAfterCurfewArena::BeginPlay()
+{
+	Super::BeginPlay();
+
+	SetActorTickInterval(StreamingInterval);
+
+	// Tiny and shared by every chunk, there is nothing to gain from loading it asynchronously
+	LoadedBlockMesh = BlockMesh.LoadSynchronous();
+	if (LoadedBlockMesh == nullptr)
+	{
+		UE_LOG(LogAfterCurfew, Warning, TEXT("Arena: could not load %s"), *BlockMesh.ToString());
+	}
+
+	SpatialHash = AAfterCurfewSpatialHash::Get(GetWorld());
+
+	if (Layout.IsEmpty() && !LayoutFile.IsEmpty())
+	{
+		FString Text;
+		FString Error;
+		FAfterCurfewArenaLayout FileLayout;
+		const FString LayoutPath = FPaths::ProjectContentDir() / LayoutFile;
+		if (!FFileHelper::LoadFileToString(Text, *LayoutPath))
+		{
+			UE_LOG(LogAfterCurfew, Warning, TEXT("Arena: could not read %s"), *LayoutPath);
+		}
+		else if (!FileLayout.Parse(Text, Error))
+		{
+			UE_LOG(LogAfterCurfew, Warning, TEXT("Arena: %s: %s"), *LayoutPath, *Error);
+		}
+		else
+		{
+			SetLayout(FileLayout);
+		}
+	}
+
+	UpdateStreaming();
+}
+
+void AAfterCurfewArena::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	DestroyAllChunks();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AAfterCurfewArena::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	UpdateStreaming();
+}
+
+void AAfterCurfewArena::SetLayout(const FAfterCurfewArenaLayout& NewLayout)
+{
+	DestroyAllChunks();
+
+	Layout = NewLayout;
+	LayoutOrigin = FVector(-Layout.Width * Layout.TileSize * 0.5f, -Layout.Height * Layout.TileSize * 0.5f, 0.f);
+
+	if (HasActorBegunPlay())
+	{
+		UpdateStreaming();
+	}
+}
+
+void AAfterCurfewArena::GatherStreamingSources(TArray<FVector2D>& OutSources) const
+{
+	TArray<FVector, TInlineAllocator<8>> WorldSources;
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController == nullptr || !PlayerController->IsLocalController())
+		{
+			continue;
+		}
+
+		if (PlayerController->GetPawn() != nullptr)
+		{
+			WorldSources.Add(PlayerController->GetPawn()->GetActorLocation());
+		}
+		else
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+			WorldSources.Add(ViewLocation);
+		}
+	}
+
+	for (const FVector& WorldSource : WorldSources)
+	{
+		const FVector Local = GetActorTransform().InverseTransformPosition(WorldSource) - LayoutOrigin;
+		OutSources.Add(FVector2D(Local.X, Local.Y) / Layout.TileSize);
+	}
+
+	// Pawns sweep against the arena wherever movement is simulated, not only near the view
+	if (HasAuthority())
+	{
+		for (TActorIterator<AAfterCurfewPawn> It(GetWorld()); It; ++It)
+		{
+			const FVector Local = GetActorTransform().InverseTransformPosition(It->GetActorLocation()) - LayoutOrigin;
+			OutSources.Add(FVector2D(Local.X, Local.Y) / Layout.TileSize);
+		}
+	}
+}
+
+void AAfterCurfewArena::UpdateStreaming()
+{
+	if (Layout.IsEmpty() || LoadedBlockMesh == nullptr)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewArenaStreaming);
+
+	const int32 NumChunksX = Layout.GetNumChunksX();
+	const int32 NumChunksY = Layout.GetNumChunksY();
+
+	// Without streaming everything is built once, on the first update
+	if (!bStreamChunks)
+	{
+		if (LoadedChunks.Num() < NumChunksX * NumChunksY)
+		{
+			for (int32 ChunkY = 0; ChunkY < NumChunksY; ++ChunkY)
+			{
+				for (int32 ChunkX = 0; ChunkX < NumChunksX; ++ChunkX)
+				{
+					const FIntPoint Chunk(ChunkX, ChunkY);
+					if (!LoadedChunks.Contains(Chunk))
+					{
+						LoadedChunks.Add(Chunk, BuildChunk(Chunk));
+					}
+				}
+			}
+		}
+		SET_DWORD_STAT(STAT_AfterCurfewArenaChunks, LoadedChunks.Num());
+		return;
+	}
+
+	TArray<FVector2D> Sources;
+	GatherStreamingSources(Sources);
+
+	// Distances are in tiles from here on
+	const float InRadius = StreamInRadius / Layout.TileSize;
+	const float OutRadius = FMath::Max(StreamOutRadius, StreamInRadius) / Layout.TileSize;
+	const float InRadiusSquared = FMath::Square(InRadius);
+	const float OutRadiusSquared = FMath::Square(OutRadius);
+	const float ChunkTiles = (float)Layout.ChunkSize;
+
+	TMap<FIntPoint, float> WantedChunks;
+	TSet<FIntPoint> KeptChunks;
+	for (const FVector2D& Source : Sources)
+	{
+		const int32 MinX = FMath::Max(FMath::FloorToInt((Source.X - OutRadius) / ChunkTiles), 0);
+		const int32 MinY = FMath::Max(FMath::FloorToInt((Source.Y - OutRadius) / ChunkTiles), 0);
+		const int32 MaxX = FMath::Min(FMath::FloorToInt((Source.X + OutRadius) / ChunkTiles), NumChunksX - 1);
+		const int32 MaxY = FMath::Min(FMath::FloorToInt((Source.Y + OutRadius) / ChunkTiles), NumChunksY - 1);
+		for (int32 ChunkY = MinY; ChunkY <= MaxY; ++ChunkY)
+		{
+			for (int32 ChunkX = MinX; ChunkX <= MaxX; ++ChunkX)
+			{
+				const FBox2D ChunkBox(FVector2D(ChunkX, ChunkY) * ChunkTiles, FVector2D(ChunkX + 1, ChunkY + 1) * ChunkTiles);
+				const float DistanceSquared = ChunkBox.ComputeSquaredDistanceToPoint(Source);
+				if (DistanceSquared > OutRadiusSquared)
+				{
+					continue;
+				}
+
+				const FIntPoint Chunk(ChunkX, ChunkY);
+				KeptChunks.Add(Chunk);
+				if (DistanceSquared <= InRadiusSquared && !LoadedChunks.Contains(Chunk))
+				{
+					float* WantedDistanceSquared = WantedChunks.Find(Chunk);
+					if (WantedDistanceSquared == nullptr)
+					{
+						WantedChunks.Add(Chunk, DistanceSquared);
+					}
+					else
+					{
+						*WantedDistanceSquared = FMath::Min(*WantedDistanceSquared, DistanceSquared);
+					}
+				}
+			}
+		}
+	}
+
+	for (auto It = LoadedChunks.CreateIterator(); It; ++It)
+	{
+		if (!KeptChunks.Contains(It.Key()))
+		{
+			DestroyChunk(It.Value());
+			It.RemoveCurrent();
+		}
+	}
+
+	// Nearest first, the rest wait for the next update
+	WantedChunks.ValueSort(TLess<float>());
+	int32 NumBuilt = 0;
+	for (const TPair<FIntPoint, float>& Wanted : WantedChunks)
+	{
+		if (NumBuilt++ >= MaxChunkBuildsPerUpdate)
+		{
+			break;
+		}
+		LoadedChunks.Add(Wanted.Key, BuildChunk(Wanted.Key));
+	}
+
+	SET_DWORD_STAT(STAT_AfterCurfewArenaChunks, LoadedChunks.Num());
+}
+
+void AAfterCurfewArena::AddBox(UHierarchicalInstancedStaticMeshComponent* Component, const FVector& Min, const FVector& Max) const
+{
+	// Fit the mesh bounds to the box
+	const FBox MeshBox = LoadedBlockMesh->GetBoundingBox();
+	const FVector Size = Max - Min;
+	const FVector Scale = Size / MeshBox.GetSize().ComponentMax(FVector(1.f));
+	const FVector Center = (Min + Max) * 0.5f;
+	Component->AddInstance(FTransform(FQuat::Identity, Center - MeshBox.GetCenter() * Scale, Scale));
+}
+
+UHierarchicalInstancedStaticMeshComponent* AAfterCurfewArena::BuildChunk(const FIntPoint& Chunk)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewArenaBuild);
+
+	const int32 MinX = Chunk.X * Layout.ChunkSize;
+	const int32 MinY = Chunk.Y * Layout.ChunkSize;
+	const int32 MaxX = FMath::Min(MinX + Layout.ChunkSize, Layout.Width);
+	const int32 MaxY = FMath::Min(MinY + Layout.ChunkSize, Layout.Height);
+	const float TileSize = Layout.TileSize;
+
+	UHierarchicalInstancedStaticMeshComponent* Component = nullptr;
+	for (int32 Y = MinY; Y < MaxY; ++Y)
+	{
+		int32 X = MinX;
+		while (X < MaxX)
+		{
+			const EAfterCurfewArenaTile Tile = Layout.GetTile(X, Y);
+			if (Tile == EAfterCurfewArenaTile::Void)
+			{
+				++X;
+				continue;
+			}
+
+			if (Component == nullptr)
+			{
+				Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(this);
+				Component->SetMobility(EComponentMobility::Static);
+				Component->SetStaticMesh(LoadedBlockMesh);
+				Component->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+				Component->bAutoRebuildTreeOnInstanceChanges = false;
+				Component->SetupAttachment(RootComponent);
+			}
+
+			// A wall run becomes one block, any other run of floor one slab
+			const bool bWall = Tile == EAfterCurfewArenaTile::Wall;
+			int32 RunEnd = X + 1;
+			while (RunEnd < MaxX && Layout.GetTile(RunEnd, Y) != EAfterCurfewArenaTile::Void && (Layout.GetTile(RunEnd, Y) == EAfterCurfewArenaTile::Wall) == bWall)
+			{
+				++RunEnd;
+			}
+
+			const FVector RunMin = LayoutOrigin + FVector(X * TileSize, Y * TileSize, 0.f);
+			const FVector RunMax = LayoutOrigin + FVector(RunEnd * TileSize, (Y + 1) * TileSize, 0.f);
+			if (bWall)
+			{
+				AddBox(Component, RunMin - FVector(0.f, 0.f, FloorThickness), RunMax + FVector(0.f, 0.f, Layout.WallHeight));
+			}
+			else
+			{
+				AddBox(Component, RunMin - FVector(0.f, 0.f, FloorThickness), RunMax);
+
+				for (int32 PillarX = X; PillarX < RunEnd; ++PillarX)
+				{
+					if (Layout.GetTile(PillarX, Y) == EAfterCurfewArenaTile::Pillar)
+					{
+						const FVector TileCenter = LayoutOrigin + FVector((PillarX + 0.5f) * TileSize, (Y + 0.5f) * TileSize, 0.f);
+						const FVector HalfPillar(TileSize * PillarScale * 0.5f, TileSize * PillarScale * 0.5f, 0.f);
+						AddBox(Component, TileCenter - HalfPillar, TileCenter + HalfPillar + FVector(0.f, 0.f, Layout.WallHeight));
+					}
+				}
+			}
+			X = RunEnd;
+		}
+	}
+
+	if (Component == nullptr)
+	{
+		return nullptr;
+	}
+
+	Component->RegisterComponent();
+	Component->BuildTreeIfOutdated(true, true);
+	INC_DWORD_STAT_BY(STAT_AfterCurfewArenaInstances, Component->GetInstanceCount());
+
+	if (SpatialHash.IsValid())
+	{
+		SpatialHash->Register(Component);
+	}
+	return Component;
+}
+
+void AAfterCurfewArena::DestroyChunk(UHierarchicalInstancedStaticMeshComponent* Component)
+{
+	if (Component == nullptr)
+	{
+		return;
+	}
+
+	DEC_DWORD_STAT_BY(STAT_AfterCurfewArenaInstances, Component->GetInstanceCount());
+	if (SpatialHash.IsValid())
+	{
+		SpatialHash->Unregister(Component);
+	}
+	Component->DestroyComponent();
+}
+
+void AAfterCurfewArena::DestroyAllChunks()
+{
+	for (const TPair<FIntPoint, UHierarchicalInstancedStaticMeshComponent*>& Loaded : LoadedChunks)
+	{
+		DestroyChunk(Loaded.Value);
+	}
+	LoadedChunks.Empty();
+
+	SET_DWORD_STAT(STAT_AfterCurfewArenaChunks, 0);
+}
@@ -0,0 +1,163 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "AfterCurfewArena.generated.h"
+
+class AAfterCurfewSpatialHash;
+class UHierarchicalInstancedStaticMeshComponent;
+class UStaticMesh;
+
+/** What fills one tile of an arena */
+enum class EAfterCurfewArenaTile : uint8
+{
+	Void,
+	Floor,
+	Wall,
+	/** Floor with a pillar in the middle of the tile */
+	Pillar,
+};
+
+/**
+ * Tiles of an arena, one byte each.
+ * The text form has optional Key=Value lines for TileSize, WallHeight and ChunkSize followed by one line per row of
+ * tiles, first row at the lowest Y: '.' floor, 'X' wall, 'P' pillar, ' ' or '-' nothing. Lines starting with ';'
+ * are comments, shorter rows are padded with nothing.
+ */
+struct AFTERCURFEW_API FAfterCurfewArenaLayout
+{
+	FAfterCurfewArenaLayout();
+
+	/** Replaces the layout with the one in Text, returns false and leaves the layout empty if it is malformed */
+	bool Parse(const FString& Text, FString& OutError);
+
+	/** Sets the size of the layout, every tile becomes Void */
+	void Init(int32 InWidth, int32 InHeight);
+
+	FORCEINLINE bool IsEmpty() const { return Tiles.Num() == 0; }
+
+	FORCEINLINE EAfterCurfewArenaTile GetTile(int32 X, int32 Y) const { return (EAfterCurfewArenaTile)Tiles[Y * Width + X]; }
+
+	FORCEINLINE void SetTile(int32 X, int32 Y, EAfterCurfewArenaTile Tile) { Tiles[Y * Width + X] = (uint8)Tile; }
+
+	FORCEINLINE int32 GetNumChunksX() const { return (Width + ChunkSize - 1) / ChunkSize; }
+	FORCEINLINE int32 GetNumChunksY() const { return (Height + ChunkSize - 1) / ChunkSize; }
+
+	/** Tiles along X and Y */
+	int32 Width;
+	int32 Height;
+
+	/** Side of a tile, in cm */
+	float TileSize;
+
+	/** Height of walls and pillars, in cm */
+	float WallHeight;
+
+	/** Side of a streaming chunk, in tiles */
+	int32 ChunkSize;
+
+	/** Row major tiles, EAfterCurfewArenaTile values */
+	TArray<uint8> Tiles;
+};
+
+/**
+ * Arena geometry built from a layout instead of placed by hand.
+ * The layout is split into square chunks and each chunk is built as a single hierarchical instanced static mesh
+ * component, with runs of floor or wall along a row merged into one instance, so a chunk is one draw call and few
+ * collision bodies. Chunks are built when a streaming source comes within StreamInRadius and destroyed once every
+ * source is farther than StreamOutRadius, nearest first and a few per update. Streaming sources are the local
+ * players and, where movement is simulated, every AfterCurfew pawn.
+ * The arena is centred on the actor's location with the floor's top at its height.
+ */
+UCLASS(config=Game)
+class AFTERCURFEW_API AAfterCurfewArena : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewArena();
+
+	// Begin Actor Interface
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+	// End Actor Interface
+
+	/** Replaces the layout, chunks of the old one are destroyed */
+	void SetLayout(const FAfterCurfewArenaLayout& NewLayout);
+
+	FORCEINLINE const FAfterCurfewArenaLayout& GetLayout() const { return Layout; }
+
+	/** Number of chunks built, empty ones included */
+	FORCEINLINE int32 GetNumLoadedChunks() const { return LoadedChunks.Num(); }
+
+	/** Layout file to build, relative to the project's content directory, e.g. Arenas/Example.arena */
+	UPROPERTY(Category = Arena, EditAnywhere)
+	FString LayoutFile;
+
+	/** Mesh every tile is built from, scaled to fit */
+	UPROPERTY(Category = Arena, EditAnywhere, config)
+	TSoftObjectPtr<UStaticMesh> BlockMesh;
+
+	/** Thickness of the floor, in cm */
+	UPROPERTY(Category = Arena, EditAnywhere, config)
+	float FloorThickness;
+
+	/** Side of a pillar as a fraction of the tile */
+	UPROPERTY(Category = Arena, EditAnywhere, config, meta = (ClampMin = "0.01", ClampMax = "1"))
+	float PillarScale;
+
+	/** Stream chunks around the players, otherwise the whole arena is built on BeginPlay */
+	UPROPERTY(Category = Streaming, EditAnywhere, config)
+	bool bStreamChunks;
+
+	/** Chunks closer than this to a streaming source are built */
+	UPROPERTY(Category = Streaming, EditAnywhere, config)
+	float StreamInRadius;
+
+	/** Chunks farther than this from every streaming source are destroyed, larger than StreamInRadius */
+	UPROPERTY(Category = Streaming, EditAnywhere, config)
+	float StreamOutRadius;
+
+	/** Most chunks built in one streaming update */
+	UPROPERTY(Category = Streaming, EditAnywhere, config, meta = (ClampMin = "1"))
+	int32 MaxChunkBuildsPerUpdate;
+
+	/** Seconds between streaming updates */
+	UPROPERTY(Category = Streaming, EditAnywhere, config, meta = (ClampMin = "0"))
+	float StreamingInterval;
+
+private:
+	/** Builds or destroys chunks around the streaming sources */
+	void UpdateStreaming();
+
+	/** Locations chunks are streamed around, in tiles */
+	void GatherStreamingSources(TArray<FVector2D>& OutSources) const;
+
+	/** Builds the chunk at Chunk, returns nullptr for a chunk with nothing in it */
+	UHierarchicalInstancedStaticMeshComponent* BuildChunk(const FIntPoint& Chunk);
+
+	void DestroyChunk(UHierarchicalInstancedStaticMeshComponent* Component);
+
+	void DestroyAllChunks();
+
+	/** Adds an instance filling the box from Min to Max, in actor space */
+	void AddBox(UHierarchicalInstancedStaticMeshComponent* Component, const FVector& Min, const FVector& Max) const;
+
+	FAfterCurfewArenaLayout Layout;
+
+	/** Built chunks, nullptr for chunks with nothing to build */
+	UPROPERTY(Transient)
+	TMap<FIntPoint, UHierarchicalInstancedStaticMeshComponent*> LoadedChunks;
+
+	UPROPERTY(Transient)
+	UStaticMesh* LoadedBlockMesh;
+
+	/** Spatial hash projectiles sweep against, told about every chunk we build */
+	TWeakObjectPtr<AAfterCurfewSpatialHash> SpatialHash;
+
+	/** Actor space location of the corner of tile 0, 0 */
+	FVector LayoutOrigin;
+};
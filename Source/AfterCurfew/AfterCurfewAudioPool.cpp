@@ -0,0 +1,251 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewAudioPool.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewFireAudioComponent.h"
+#include "AfterCurfewWorldManager.h"
+#include "Components/AudioComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Sound/SoundBase.h"
+
+DECLARE_CYCLE_STAT(TEXT("Audio Pool Start Voices"), STAT_AfterCurfewAudioStart, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Fire Voices Playing"), STAT_AfterCurfewAudioPlaying, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fire Sounds Started"), STAT_AfterCurfewAudioStarted, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fire Sounds Dropped"), STAT_AfterCurfewAudioDropped, STATGROUP_AfterCurfew);
+
+AAfterCurfewAudioPool::AAfterCurfewAudioPool()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+
+	MaxVoices = 16;
+	MaxVoicesPerRequester = 2;
+	MaxStartsPerFrame = 4;
+	MaxAudibleDistance = 8000.f;
+
+	ListenerLocation = FVector::ZeroVector;
+}
+
+AAfterCurfewAudioPool* AAfterCurfewAudioPool::Get(UWorld* World)
+{
+	if (World == nullptr || World->GetNetMode() == NM_DedicatedServer || World->GetAudioDevice() == nullptr)
+	{
+		return nullptr;
+	}
+	return FindOrSpawnWorldManager<AAfterCurfewAudioPool>(World);
+}
+
+void AAfterCurfewAudioPool::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Voices.Reserve(MaxVoices);
+	VoiceStates.Reserve(MaxVoices);
+	for (int32 Index = 0; Index < MaxVoices; ++Index)
+	{
+		UAudioComponent* Voice = NewObject<UAudioComponent>(this);
+		Voice->bAutoActivate = false;
+		Voice->bAutoDestroy = false;
+		Voice->bAllowSpatialization = true;
+		Voice->RegisterComponent();
+		Voices.Add(Voice);
+
+		FVoiceState& State = VoiceStates[VoiceStates.AddDefaulted()];
+		State.DistanceSquared = 0.f;
+		State.StartTime = 0.f;
+		State.bLoop = false;
+	}
+
+	Requests.Reserve(MaxStartsPerFrame * 4);
+}
+
+void AAfterCurfewAudioPool::PlayOneShot(UAfterCurfewFireAudioComponent* Requester, USoundBase* Sound, const FVector& Location)
+{
+	QueueRequest(Requester, Sound, Location, false);
+}
+
+void AAfterCurfewAudioPool::PlayLoop(UAfterCurfewFireAudioComponent* Requester, USoundBase* Sound)
+{
+	QueueRequest(Requester, Sound, Requester->GetOwner()->GetActorLocation(), true);
+}
+
+void AAfterCurfewAudioPool::QueueRequest(UAfterCurfewFireAudioComponent* Requester, USoundBase* Sound, const FVector& Location, bool bLoop)
+{
+	if (Requester == nullptr || Sound == nullptr)
+	{
+		return;
+	}
+
+	FSoundRequest& Request = Requests[Requests.AddDefaulted()];
+	Request.Requester = Requester;
+	Request.Sound = Sound;
+	Request.Location = Location;
+	Request.DistanceSquared = 0.f;
+	Request.bLoop = bLoop;
+}
+
+void AAfterCurfewAudioPool::StopVoice(UAudioComponent* Voice)
+{
+	const int32 VoiceIndex = Voices.IndexOfByKey(Voice);
+	if (VoiceIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	Voice->Stop();
+	if (Voice->GetAttachParent() != nullptr)
+	{
+		Voice->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+	}
+	VoiceStates[VoiceIndex].Requester.Reset();
+	VoiceStates[VoiceIndex].bLoop = false;
+}
+
+int32 AAfterCurfewAudioPool::GetNumPlaying() const
+{
+	int32 NumPlaying = 0;
+	for (const UAudioComponent* Voice : Voices)
+	{
+		NumPlaying += Voice->IsPlaying() ? 1 : 0;
+	}
+	return NumPlaying;
+}
+
+bool AAfterCurfewAudioPool::UpdateListener()
+{
+	const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	if (PlayerController == nullptr)
+	{
+		return false;
+	}
+
+	FVector FrontDir;
+	FVector RightDir;
+	PlayerController->GetAudioListenerPosition(ListenerLocation, FrontDir, RightDir);
+	return true;
+}
+
+int32 AAfterCurfewAudioPool::FindVoice(const FSoundRequest& Request) const
+{
+	int32 NumOwnVoices = 0;
+	int32 OldestOwnOneShot = INDEX_NONE;
+	int32 FreeVoice = INDEX_NONE;
+	int32 FarthestOneShot = INDEX_NONE;
+
+	for (int32 Index = 0; Index < Voices.Num(); ++Index)
+	{
+		const FVoiceState& State = VoiceStates[Index];
+		if (!Voices[Index]->IsPlaying())
+		{
+			FreeVoice = FreeVoice == INDEX_NONE ? Index : FreeVoice;
+			continue;
+		}
+
+		if (State.Requester == Request.Requester)
+		{
+			++NumOwnVoices;
+			if (!State.bLoop && (OldestOwnOneShot == INDEX_NONE || State.StartTime < VoiceStates[OldestOwnOneShot].StartTime))
+			{
+				OldestOwnOneShot = Index;
+			}
+		}
+		if (!State.bLoop && State.DistanceSquared > Request.DistanceSquared && (FarthestOneShot == INDEX_NONE || State.DistanceSquared > VoiceStates[FarthestOneShot].DistanceSquared))
+		{
+			FarthestOneShot = Index;
+		}
+	}
+
+	// A requester at its limit restarts its own oldest shot rather than taking another voice
+	if (NumOwnVoices >= MaxVoicesPerRequester)
+	{
+		return OldestOwnOneShot;
+	}
+	return FreeVoice != INDEX_NONE ? FreeVoice : FarthestOneShot;
+}
+
+void AAfterCurfewAudioPool::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (Requests.Num() > 0 && UpdateListener())
+	{
+		SCOPE_CYCLE_COUNTER(STAT_AfterCurfewAudioStart);
+
+		const float MaxDistanceSquared = FMath::Square(MaxAudibleDistance);
+		for (FSoundRequest& Request : Requests)
+		{
+			Request.DistanceSquared = FVector::DistSquared(Request.Location, ListenerLocation);
+		}
+
+		// Nearest first, so the budget goes to the sounds the player hears best
+		if (Requests.Num() > MaxStartsPerFrame)
+		{
+			Requests.Sort([](const FSoundRequest& A, const FSoundRequest& B) { return A.DistanceSquared < B.DistanceSquared; });
+		}
+
+		const float Now = GetWorld()->GetAudioTimeSeconds();
+		int32 NumStarted = 0;
+		for (const FSoundRequest& Request : Requests)
+		{
+			UAfterCurfewFireAudioComponent* Requester = Request.Requester.Get();
+			const int32 VoiceIndex = NumStarted < MaxStartsPerFrame && Requester != nullptr && Request.DistanceSquared <= MaxDistanceSquared ? FindVoice(Request) : INDEX_NONE;
+			if (VoiceIndex == INDEX_NONE)
+			{
+				INC_DWORD_STAT(STAT_AfterCurfewAudioDropped);
+				if (Request.bLoop && Requester != nullptr)
+				{
+					Requester->OnLoopDropped();
+				}
+				continue;
+			}
+
+			UAudioComponent* Voice = Voices[VoiceIndex];
+			Voice->Stop();
+			Voice->SetSound(Request.Sound);
+			if (Request.bLoop)
+			{
+				Voice->AttachToComponent(Requester->GetOwner()->GetRootComponent(), FAttachmentTransformRules::SnapToTargetNotIncludingScale);
+			}
+			else
+			{
+				if (Voice->GetAttachParent() != nullptr)
+				{
+					Voice->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+				}
+				Voice->SetWorldLocation(Request.Location);
+			}
+			Voice->Play();
+
+			FVoiceState& State = VoiceStates[VoiceIndex];
+			State.Requester = Requester;
+			State.DistanceSquared = Request.DistanceSquared;
+			State.StartTime = Now;
+			State.bLoop = Request.bLoop;
+			++NumStarted;
+
+			if (Request.bLoop)
+			{
+				Requester->OnLoopStarted(Voice);
+			}
+		}
+
+		INC_DWORD_STAT_BY(STAT_AfterCurfewAudioStarted, NumStarted);
+	}
+	else
+	{
+		// Nobody to hear them, loops still need to know so they ask again
+		for (const FSoundRequest& Request : Requests)
+		{
+			UAfterCurfewFireAudioComponent* Requester = Request.Requester.Get();
+			if (Request.bLoop && Requester != nullptr)
+			{
+				Requester->OnLoopDropped();
+			}
+		}
+	}
+	Requests.Reset();
+
+	SET_DWORD_STAT(STAT_AfterCurfewAudioPlaying, GetNumPlaying());
+}
@@ -0,0 +1,102 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "AfterCurfewAudioPool.generated.h"
+
+class UAfterCurfewFireAudioComponent;
+class UAudioComponent;
+class USoundBase;
+
+/**
+ * Plays every weapon sound in a world through a fixed set of reused audio components.
+ * Sounds are requested during the frame and started together at the end of it, nearest to the listener first,
+ * no more than MaxStartsPerFrame of them. Requests beyond MaxAudibleDistance are dropped, and when every voice is
+ * busy a new sound only plays by taking the voice of a farther one-shot.
+ * Each requester may hold MaxVoicesPerRequester voices, a further one-shot restarts its oldest voice.
+ */
+UCLASS(config=Game, notplaceable)
+class AFTERCURFEW_API AAfterCurfewAudioPool : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewAudioPool();
+
+	/** Returns the audio pool for this world, creating it on first use, or nullptr where no audio is played */
+	static AAfterCurfewAudioPool* Get(UWorld* World);
+
+	// Begin Actor Interface
+	virtual void BeginPlay() override;
+	virtual void Tick(float DeltaSeconds) override;
+	// End Actor Interface
+
+	/** Queues a one-shot Sound at Location for the end of the frame */
+	void PlayOneShot(UAfterCurfewFireAudioComponent* Requester, USoundBase* Sound, const FVector& Location);
+
+	/** Queues a looping Sound following Requester, it is handed its voice through OnLoopStarted */
+	void PlayLoop(UAfterCurfewFireAudioComponent* Requester, USoundBase* Sound);
+
+	/** Stops Voice and gives it back to the pool */
+	void StopVoice(UAudioComponent* Voice);
+
+	/** Number of voices playing */
+	int32 GetNumPlaying() const;
+
+	/** Number of audio components the pool plays sounds on */
+	UPROPERTY(Category = Audio, EditAnywhere, config, meta = (ClampMin = "1"))
+	int32 MaxVoices;
+
+	/** Most voices one requester may hold at a time */
+	UPROPERTY(Category = Audio, EditAnywhere, config, meta = (ClampMin = "1"))
+	int32 MaxVoicesPerRequester;
+
+	/** Most sounds started in one frame, the farthest requests are dropped */
+	UPROPERTY(Category = Audio, EditAnywhere, config, meta = (ClampMin = "1"))
+	int32 MaxStartsPerFrame;
+
+	/** Requests farther than this from the listener are dropped, in cm */
+	UPROPERTY(Category = Audio, EditAnywhere, config)
+	float MaxAudibleDistance;
+
+private:
+	struct FSoundRequest
+	{
+		TWeakObjectPtr<UAfterCurfewFireAudioComponent> Requester;
+		USoundBase* Sound;
+		FVector Location;
+		float DistanceSquared;
+		bool bLoop;
+	};
+
+	/** What a pooled voice is playing */
+	struct FVoiceState
+	{
+		TWeakObjectPtr<UAfterCurfewFireAudioComponent> Requester;
+		float DistanceSquared;
+		float StartTime;
+		bool bLoop;
+	};
+
+	void QueueRequest(UAfterCurfewFireAudioComponent* Requester, USoundBase* Sound, const FVector& Location, bool bLoop);
+
+	/** Returns the voice Request should play on, or INDEX_NONE if it does not get one */
+	int32 FindVoice(const FSoundRequest& Request) const;
+
+	/** Updates the listener location, returns false if there is no listener */
+	bool UpdateListener();
+
+	/** Audio components sounds are played on */
+	UPROPERTY(Transient)
+	TArray<UAudioComponent*> Voices;
+
+	/** State of each entry of Voices */
+	TArray<FVoiceState> VoiceStates;
+
+	/** Sounds asked for since the last tick, nearest first once more than MaxStartsPerFrame compete for voices */
+	TArray<FSoundRequest> Requests;
+
+	FVector ListenerLocation;
+};
@@ -0,0 +1,355 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewBenchmark.h"
+#include "AfterCurfewArena.h"
+#include "AfterCurfewGameMode.h"
+#include "AfterCurfewPawn.h"
+#include "AfterCurfewProjectile.h"
+#include "AfterCurfewProjectilePool.h"
+#include "AfterCurfewWeaponDefinition.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/PlatformMemory.h"
+#include "Serialization/JsonWriter.h"
+#include "Policies/PrettyJsonPrintPolicy.h"
+
+AAfterCurfewBenchmark::AAfterCurfewBenchmark()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	NumPawns = 32;
+	NumFrames = 1800;
+	NumWarmupFrames = 120;
+	FixedDeltaTime = 1.f / 60.f;
+	ArenaSize = 8000.f;
+	NumRewindsPerFrame = 64;
+	CheckpointInterval = 0.f;
+	bExitWhenDone = true;
+	bCaptureStats = false;
+
+	FrameNumber = 0;
+	MeasureStartTime = 0.0;
+	LastFrameTime = 0.0;
+	TotalFrameSeconds = 0.0;
+	MaxFrameSeconds = 0.0;
+	ProjectilesAliveSum = 0;
+	ProjectilesAlivePeak = 0;
+	RewindSeconds = 0.0;
+	NumRewinds = 0;
+	NumRewindHits = 0;
+}
+
+bool AAfterCurfewBenchmark::IsRequested()
+{
+	return FParse::Param(FCommandLine::Get(), TEXT("ACBench"));
+}
+
+void AAfterCurfewBenchmark::BeginPlay()
+{
+	Super::BeginPlay();
+
+	const TCHAR* CommandLine = FCommandLine::Get();
+	FParse::Value(CommandLine, TEXT("ACBenchPawns="), NumPawns);
+	FParse::Value(CommandLine, TEXT("ACBenchFrames="), NumFrames);
+	FParse::Value(CommandLine, TEXT("ACBenchWarmup="), NumWarmupFrames);
+	FParse::Value(CommandLine, TEXT("ACBenchDelta="), FixedDeltaTime);
+	FParse::Value(CommandLine, TEXT("ACBenchArena="), ArenaSize);
+	FParse::Value(CommandLine, TEXT("ACBenchRewinds="), NumRewindsPerFrame);
+	FParse::Value(CommandLine, TEXT("ACBenchCheckpoints="), CheckpointInterval);
+	if (FParse::Param(CommandLine, TEXT("ACBenchNoExit")))
+	{
+		bExitWhenDone = false;
+	}
+	if (FParse::Param(CommandLine, TEXT("ACBenchCapture")))
+	{
+		bCaptureStats = true;
+	}
+
+	// Step the world at a fixed rate and as fast as possible, independent of wall clock time
+	FApp::SetBenchmarking(true);
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(FixedDeltaTime);
+
+	const AAfterCurfewGameMode* GameMode = GetWorld()->GetAuthGameMode<AAfterCurfewGameMode>();
+	Random.Initialize(GameMode != nullptr ? GameMode->GetRandomSeed() : 0);
+
+	UE_LOG(LogAfterCurfew, Display, TEXT("Benchmark: %d pawns, %d frames after %d warm-up frames at %.4fs, seed %d"), NumPawns, NumFrames, NumWarmupFrames, FixedDeltaTime, Random.GetInitialSeed());
+
+	BuildArena();
+	SpawnPawns();
+
+	// Standalone games do not record a history, the benchmark needs one either way
+	if (NumRewindsPerFrame > 0)
+	{
+		LagCompensation = AAfterCurfewLagCompensation::Get(GetWorld());
+		if (LagCompensation.IsValid())
+		{
+			LagCompensation->SetRecording(true);
+		}
+	}
+}
+
+void AAfterCurfewBenchmark::BuildArena()
+{
+	static const float TileSize = 200.f;
+
+	FAfterCurfewArenaLayout Layout;
+	Layout.TileSize = TileSize;
+	Layout.WallHeight = 400.f;
+
+	const int32 NumTiles = FMath::Max(3, FMath::RoundToInt(ArenaSize / TileSize));
+	Layout.Init(NumTiles, NumTiles);
+	for (int32 Y = 0; Y < NumTiles; ++Y)
+	{
+		for (int32 X = 0; X < NumTiles; ++X)
+		{
+			const bool bBorder = X == 0 || Y == 0 || X == NumTiles - 1 || Y == NumTiles - 1;
+			Layout.SetTile(X, Y, bBorder ? EAfterCurfewArenaTile::Wall : EAfterCurfewArenaTile::Floor);
+		}
+	}
+
+	// A pillar per 16m square gives the pawns something to slide along, kept to the middle 80% of the arena
+	const int32 NumPillars = FMath::Max(1, FMath::RoundToInt(FMath::Square(ArenaSize / 1600.f)));
+	const int32 PillarMin = FMath::Max(1, FMath::RoundToInt(NumTiles * 0.1f));
+	const int32 PillarMax = FMath::Min(NumTiles - 2, NumTiles - 1 - PillarMin);
+	for (int32 Index = 0; Index < NumPillars; ++Index)
+	{
+		Layout.SetTile(Random.RandRange(PillarMin, PillarMax), Random.RandRange(PillarMin, PillarMax), EAfterCurfewArenaTile::Wall);
+	}
+
+	// Built whole rather than streamed, so every run measures the same geometry
+	AAfterCurfewArena* Arena = GetWorld()->SpawnActorDeferred<AAfterCurfewArena>(AAfterCurfewArena::StaticClass(), FTransform::Identity, this);
+	if (Arena != nullptr)
+	{
+		Arena->bStreamChunks = false;
+		Arena->SetLayout(Layout);
+		Arena->FinishSpawning(FTransform::Identity);
+	}
+}
+
+void AAfterCurfewBenchmark::SpawnPawns()
+{
+	const float SpawnExtent = ArenaSize * 0.4f;
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	BenchPawns.Reserve(NumPawns);
+	for (int32 Index = 0; Index < NumPawns; ++Index)
+	{
+		const FVector Location(Random.FRandRange(-SpawnExtent, SpawnExtent), Random.FRandRange(-SpawnExtent, SpawnExtent), 150.f);
+		const FRotator Rotation(0.f, Random.FRandRange(-180.f, 180.f), 0.f);
+
+		AAfterCurfewPawn* Pawn = GetWorld()->SpawnActor<AAfterCurfewPawn>(AAfterCurfewPawn::StaticClass(), Location, Rotation, SpawnParams);
+		if (Pawn == nullptr)
+		{
+			continue;
+		}
+
+		// Driven the same way as gameplay AI, by the steering manager
+		Pawn->SpawnDefaultController();
+
+		BenchPawns.Add(Pawn);
+	}
+}
+
+void AAfterCurfewBenchmark::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	const double Now = FPlatformTime::Seconds();
+
+	if (FrameNumber == NumWarmupFrames)
+	{
+		StartFromSnapshot();
+
+		StartCounters = GAfterCurfewCounters;
+		MeasureStartTime = Now;
+
+		if (bCaptureStats)
+		{
+			GEngine->Exec(GetWorld(), TEXT("stat startfile"));
+		}
+	}
+	else if (FrameNumber > NumWarmupFrames)
+	{
+		const double FrameSeconds = Now - LastFrameTime;
+		TotalFrameSeconds += FrameSeconds;
+		MaxFrameSeconds = FMath::Max(MaxFrameSeconds, FrameSeconds);
+
+		const int64 ProjectilesAlive = GAfterCurfewCounters.GetProjectilesAlive();
+		ProjectilesAliveSum += ProjectilesAlive;
+		ProjectilesAlivePeak = FMath::Max(ProjectilesAlivePeak, ProjectilesAlive);
+
+		RunRewinds();
+
+		if (FrameNumber - NumWarmupFrames >= NumFrames)
+		{
+			Finish();
+			return;
+		}
+	}
+
+	LastFrameTime = Now;
+
+	++FrameNumber;
+}
+
+void AAfterCurfewBenchmark::StartFromSnapshot()
+{
+	const TCHAR* CommandLine = FCommandLine::Get();
+	FString LoadFile;
+	FString SaveFile;
+	const bool bLoad = FParse::Value(CommandLine, TEXT("ACBenchLoadSnapshot="), LoadFile);
+	const bool bSave = FParse::Value(CommandLine, TEXT("ACBenchSaveSnapshot="), SaveFile);
+	if (!bLoad && !bSave && CheckpointInterval <= 0.f)
+	{
+		return;
+	}
+
+	SnapshotManager = AAfterCurfewSnapshotManager::Get(GetWorld());
+	if (!SnapshotManager.IsValid())
+	{
+		return;
+	}
+
+	if (bLoad && !SnapshotManager->LoadFromFile(LoadFile))
+	{
+		UE_LOG(LogAfterCurfew, Error, TEXT("Benchmark could not restart from %s, measuring from the warmed up state"), *LoadFile);
+	}
+	if (bSave)
+	{
+		SnapshotManager->SaveToFile(SaveFile);
+	}
+	SnapshotManager->CheckpointInterval = CheckpointInterval;
+}
+
+void AAfterCurfewBenchmark::RunRewinds()
+{
+	AAfterCurfewLagCompensation* const LagComp = LagCompensation.Get();
+	if (LagComp == nullptr || NumRewindsPerFrame <= 0 || BenchPawns.Num() == 0)
+	{
+		return;
+	}
+
+	const float Now = GetWorld()->GetTimeSeconds();
+	const UAfterCurfewWeaponDefinition* Weapon = GetDefault<UAfterCurfewWeaponDefinition>();
+	const float Speed = FMath::Min(Weapon->ProjectileInitialSpeed, Weapon->ProjectileMaxSpeed);
+
+	// Shots are made up front so only the rewinds are timed
+	RewindShots.Reset();
+	RewindShooters.Reset();
+	for (int32 Index = 0; Index < NumRewindsPerFrame; ++Index)
+	{
+		AAfterCurfewPawn* Shooter = BenchPawns[Random.RandHelper(BenchPawns.Num())].Get();
+		if (Shooter == nullptr)
+		{
+			continue;
+		}
+
+		FAfterCurfewRewindShot& Shot = RewindShots[RewindShots.AddDefaulted()];
+		Shot.Origin = Shooter->GetActorLocation();
+		Shot.Velocity = FRotator(0.f, Random.FRandRange(-180.f, 180.f), 0.f).Vector() * Speed;
+		Shot.Radius = 10.f * Weapon->ProjectileScale;
+		Shot.FireTime = Now - Random.FRand() * LagComp->MaxRewindTime;
+		Shot.MaxFlightTime = GetDefault<AAfterCurfewProjectile>()->InitialLifeSpan;
+		RewindShooters.Add(Shooter);
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < RewindShots.Num(); ++Index)
+	{
+		AAfterCurfewPawn* HitPawn;
+		float HitTime;
+		if (LagComp->RewindShot(RewindShots[Index], RewindShooters[Index], HitPawn, HitTime))
+		{
+			++NumRewindHits;
+		}
+	}
+	RewindSeconds += FPlatformTime::Seconds() - StartTime;
+	NumRewinds += RewindShots.Num();
+}
+
+void AAfterCurfewBenchmark::Finish()
+{
+	SetActorTickEnabled(false);
+
+	if (bCaptureStats)
+	{
+		GEngine->Exec(GetWorld(), TEXT("stat stopfile"));
+	}
+
+	const int32 MeasuredFrames = FMath::Max(FrameNumber - NumWarmupFrames, 1);
+	const double SimulatedSeconds = MeasuredFrames * double(FixedDeltaTime);
+	const uint64 Spawned = GAfterCurfewCounters.ProjectilesSpawned - StartCounters.ProjectilesSpawned;
+	const uint64 Released = GAfterCurfewCounters.ProjectilesReleased - StartCounters.ProjectilesReleased;
+	const uint64 MoveSweeps = GAfterCurfewCounters.MoveSweeps - StartCounters.MoveSweeps;
+	const uint64 ProjectileSweeps = GAfterCurfewCounters.ProjectileSweeps - StartCounters.ProjectileSweeps;
+	const uint64 ProjectileHits = GAfterCurfewCounters.ProjectileHits - StartCounters.ProjectileHits;
+	const uint64 MoveTimeDroppedUs = GAfterCurfewCounters.MoveTimeDroppedUs - StartCounters.MoveTimeDroppedUs;
+	const AAfterCurfewProjectilePool* Pool = AAfterCurfewProjectilePool::Get(GetWorld());
+	const AAfterCurfewGameMode* GameMode = GetWorld()->GetAuthGameMode<AAfterCurfewGameMode>();
+
+	FString Report;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Report);
+	Writer->WriteObjectStart();
+	Writer->WriteValue(TEXT("seed"), Random.GetInitialSeed());
+	Writer->WriteValue(TEXT("pawns"), BenchPawns.Num());
+	Writer->WriteValue(TEXT("frames"), MeasuredFrames);
+	Writer->WriteValue(TEXT("fixed_delta_seconds"), FixedDeltaTime);
+	Writer->WriteValue(TEXT("wall_seconds"), FPlatformTime::Seconds() - MeasureStartTime);
+	Writer->WriteValue(TEXT("ms_per_frame_avg"), TotalFrameSeconds * 1000.0 / MeasuredFrames);
+	Writer->WriteValue(TEXT("ms_per_frame_max"), MaxFrameSeconds * 1000.0);
+	Writer->WriteValue(TEXT("projectiles_alive_avg"), double(ProjectilesAliveSum) / MeasuredFrames);
+	Writer->WriteValue(TEXT("projectiles_alive_peak"), int64(ProjectilesAlivePeak));
+	Writer->WriteValue(TEXT("projectile_spawns_per_second"), Spawned / SimulatedSeconds);
+	Writer->WriteValue(TEXT("projectile_destroys_per_second"), Released / SimulatedSeconds);
+	Writer->WriteValue(TEXT("move_sweeps_per_frame"), double(MoveSweeps) / MeasuredFrames);
+	Writer->WriteValue(TEXT("move_time_dropped_ms"), MoveTimeDroppedUs / 1000.0);
+	Writer->WriteValue(TEXT("projectile_sweeps_per_frame"), double(ProjectileSweeps) / MeasuredFrames);
+	Writer->WriteValue(TEXT("projectile_hits_per_second"), ProjectileHits / SimulatedSeconds);
+	Writer->WriteValue(TEXT("projectile_pool_high_water_mark"), Pool != nullptr ? Pool->GetHighWaterMark() : 0);
+	Writer->WriteValue(TEXT("peak_used_physical_mb"), double(FPlatformMemory::GetStats().PeakUsedPhysical) / (1024.0 * 1024.0));
+	Writer->WriteValue(TEXT("rewinds_per_frame"), double(NumRewinds) / MeasuredFrames);
+	Writer->WriteValue(TEXT("rewind_us_avg"), NumRewinds > 0 ? RewindSeconds * 1000000.0 / NumRewinds : 0.0);
+	Writer->WriteValue(TEXT("rewind_hit_ratio"), NumRewinds > 0 ? double(NumRewindHits) / NumRewinds : 0.0);
+	Writer->WriteValue(TEXT("lag_compensation_history_kb"), LagCompensation.IsValid() ? double(LagCompensation->GetHistoryBytes()) / 1024.0 : 0.0);
+	Writer->WriteValue(TEXT("preload_seconds"), GameMode != nullptr ? GameMode->GetPreloadSeconds() : 0.0);
+	Writer->WriteValue(TEXT("preloaded_asset_mb"), GameMode != nullptr ? double(GameMode->GetPreloadedBytes()) / (1024.0 * 1024.0) : 0.0);
+	Writer->WriteValue(TEXT("time_to_first_frame_seconds"), GameMode != nullptr ? GameMode->GetTimeToFirstFrame() : 0.0);
+	Writer->WriteValue(TEXT("checkpoints"), SnapshotManager.IsValid() ? SnapshotManager->GetNumCheckpoints() : 0);
+	Writer->WriteValue(TEXT("checkpoint_ms_avg"), SnapshotManager.IsValid() ? SnapshotManager->GetAverageCheckpointSeconds() * 1000.0 : 0.0);
+	Writer->WriteValue(TEXT("snapshot_kb"), SnapshotManager.IsValid() ? SnapshotManager->GetLastRawBytes() / 1024.0 : 0.0);
+	Writer->WriteValue(TEXT("checkpoint_encoded_kb"), SnapshotManager.IsValid() ? SnapshotManager->GetLastEncodedBytes() / 1024.0 : 0.0);
+	Writer->WriteValue(TEXT("checkpoint_memory_kb"), SnapshotManager.IsValid() ? double(SnapshotManager->GetCheckpointBytes()) / 1024.0 : 0.0);
+	Writer->WriteObjectEnd();
+	Writer->Close();
+
+	FString OutputPath;
+	if (!FParse::Value(FCommandLine::Get(), TEXT("ACBenchOut="), OutputPath))
+	{
+		OutputPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / FString::Printf(TEXT("AfterCurfewBench-%s.json"), *FDateTime::Now().ToString());
+	}
+
+	if (FFileHelper::SaveStringToFile(Report, *OutputPath))
+	{
+		UE_LOG(LogAfterCurfew, Display, TEXT("Benchmark report written to %s"), *OutputPath);
+	}
+	else
+	{
+		UE_LOG(LogAfterCurfew, Error, TEXT("Benchmark could not write %s"), *OutputPath);
+	}
+	UE_LOG(LogAfterCurfew, Display, TEXT("%s"), *Report);
+
+	if (bExitWhenDone)
+	{
+		FPlatformMisc::RequestExit(false);
+	}
+}
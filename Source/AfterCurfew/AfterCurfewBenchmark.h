@@ -0,0 +1,131 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewLagCompensation.h"
+#include "AfterCurfewSnapshot.h"
+#include "AfterCurfewBenchmark.generated.h"
+
+class AAfterCurfewPawn;
+
+/**
+ * Headless benchmark of pawns and projectiles.
+ * Spawned by AAfterCurfewGameMode when the game is started with -ACBench, e.g.
+ *
+ *   UE4Editor AfterCurfew /Engine/Maps/Entry -game -nullrhi -nosound -unattended -ACBench -ACBenchPawns=64 -ACBenchFrames=3600 -ACSeed=1234
+ *
+ * Builds a walled arena, spawns AI controlled pawns that fight each other, steps the world at a fixed delta time
+ * and writes frame time, projectile and sweep counts and peak memory as JSON to Saved/Benchmarks before exiting.
+ * With -ACBenchCapture the measured frames are also recorded to a stats file in Saved/Profiling for the
+ * Session Frontend profiler, add -statnamedevents to see the same scopes in an external CPU profiler.
+ *
+ * Every measured frame also rewinds random shots through the lag compensation history, to see how rewinding scales
+ * with the pawn count. To measure it where it runs, start the benchmark on a local dedicated server, e.g.
+ *
+ *   UE4Editor AfterCurfew /Engine/Maps/Entry -server -log -unattended -ACBench -ACBenchPawns=128 -ACBenchRewinds=256
+ *
+ * The state measuring starts from can be saved with -ACBenchSaveSnapshot=<file> and a later run restarted from it with
+ * -ACBenchLoadSnapshot=<file>, as long as it spawns the same number of pawns. -ACBenchCheckpoints=<seconds> keeps
+ * checkpoints in memory while measuring, to see what they cost.
+ */
+UCLASS(notplaceable)
+class AFTERCURFEW_API AAfterCurfewBenchmark : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewBenchmark();
+
+	/** Returns true if the command line asks for a benchmark run */
+	static bool IsRequested();
+
+	/** Number of pawns fighting in the arena, -ACBenchPawns= */
+	UPROPERTY(Category = Benchmark, EditAnywhere)
+	int32 NumPawns;
+
+	/** Frames measured after warm-up, -ACBenchFrames= */
+	UPROPERTY(Category = Benchmark, EditAnywhere)
+	int32 NumFrames;
+
+	/** Frames simulated before measuring starts, -ACBenchWarmup= */
+	UPROPERTY(Category = Benchmark, EditAnywhere)
+	int32 NumWarmupFrames;
+
+	/** Fixed delta time the world is stepped with, -ACBenchDelta= */
+	UPROPERTY(Category = Benchmark, EditAnywhere)
+	float FixedDeltaTime;
+
+	/** Width of the square arena, -ACBenchArena= */
+	UPROPERTY(Category = Benchmark, EditAnywhere)
+	float ArenaSize;
+
+	/** Exit once the report is written, disable with -ACBenchNoExit */
+	UPROPERTY(Category = Benchmark, EditAnywhere)
+	bool bExitWhenDone;
+
+	/** Shots rewound through the lag compensation history each measured frame, -ACBenchRewinds= */
+	UPROPERTY(Category = Benchmark, EditAnywhere)
+	int32 NumRewindsPerFrame;
+
+	/** Seconds between in-memory checkpoints while measuring, -ACBenchCheckpoints=, zero for none */
+	UPROPERTY(Category = Benchmark, EditAnywhere)
+	float CheckpointInterval;
+
+	/** Record a stats capture of the measured frames, -ACBenchCapture */
+	UPROPERTY(Category = Benchmark, EditAnywhere)
+	bool bCaptureStats;
+
+	// Begin Actor Interface
+	virtual void BeginPlay() override;
+	virtual void Tick(float DeltaSeconds) override;
+	// End Actor Interface
+
+private:
+	/** Builds an arena of floor, walls around it and a few pillars */
+	void BuildArena();
+
+	/** Spawns the pawns, each possessed by an AI controller */
+	void SpawnPawns();
+
+	/** Rewinds NumRewindsPerFrame shots fired from random pawns at random times in the history */
+	void RunRewinds();
+
+	/** Saves or restores the state measuring starts from, as asked on the command line */
+	void StartFromSnapshot();
+
+	/** Writes the report and ends the run */
+	void Finish();
+
+	/** Stream all benchmark decisions come from, seeded from the game mode */
+	FRandomStream Random;
+
+	TArray<TWeakObjectPtr<AAfterCurfewPawn>> BenchPawns;
+
+	/** Frames ticked so far, warm-up included */
+	int32 FrameNumber;
+
+	/** Counters at the start of measurement */
+	FAfterCurfewCounters StartCounters;
+
+	double MeasureStartTime;
+	double LastFrameTime;
+	double TotalFrameSeconds;
+	double MaxFrameSeconds;
+	int64 ProjectilesAliveSum;
+	int64 ProjectilesAlivePeak;
+
+	TWeakObjectPtr<AAfterCurfewLagCompensation> LagCompensation;
+
+	TWeakObjectPtr<AAfterCurfewSnapshotManager> SnapshotManager;
+
+	/** Shots rewound this frame, RewindShooters holds who fired each at the same index */
+	TArray<FAfterCurfewRewindShot> RewindShots;
+	TArray<AAfterCurfewPawn*> RewindShooters;
+
+	double RewindSeconds;
+	int64 NumRewinds;
+	int64 NumRewindHits;
+};
@@ -0,0 +1,257 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewEffectPool.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewWorldManager.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/App.h"
+#include "Particles/ParticleSystem.h"
+#include "Particles/ParticleSystemComponent.h"
+
+DECLARE_CYCLE_STAT(TEXT("Effect Pool Update"), STAT_AfterCurfewEffectUpdate, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Effects Active"), STAT_AfterCurfewEffectsActive, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Effects Started"), STAT_AfterCurfewEffectsStarted, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Effects Dropped"), STAT_AfterCurfewEffectsDropped, STATGROUP_AfterCurfew);
+
+AAfterCurfewEffectPool::AAfterCurfewEffectPool()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+
+	MaxComponentsPerType = 16;
+	MaxStartsPerFrame = 8;
+	MaxEffectDistance = 6000.f;
+	MuzzleLifetime = 0.1f;
+	ImpactLifetime = 0.4f;
+
+	ViewLocation = FVector::ZeroVector;
+	NumActive = 0;
+}
+
+AAfterCurfewEffectPool* AAfterCurfewEffectPool::Get(UWorld* World)
+{
+	if (World == nullptr || World->GetNetMode() == NM_DedicatedServer || !FApp::CanEverRender())
+	{
+		return nullptr;
+	}
+	return FindOrSpawnWorldManager<AAfterCurfewEffectPool>(World);
+}
+
+void AAfterCurfewEffectPool::BeginPlay()
+{
+	Super::BeginPlay();
+
+	const int32 NumComponents = MaxComponentsPerType * (int32)EAfterCurfewEffectType::Num;
+	Components.Reserve(NumComponents);
+	Slots.Reserve(NumComponents);
+	for (int32 Index = 0; Index < NumComponents; ++Index)
+	{
+		UParticleSystemComponent* Component = NewObject<UParticleSystemComponent>(this);
+		Component->bAutoActivate = false;
+		Component->bAutoDestroy = false;
+		Component->RegisterComponent();
+		Components.Add(Component);
+
+		FEffectSlot& Slot = Slots[Slots.AddDefaulted()];
+		Slot.StopTime = 0.f;
+		Slot.DistanceSquared = 0.f;
+		Slot.bActive = false;
+	}
+
+	Requests.Reserve(MaxStartsPerFrame * 4);
+}
+
+void AAfterCurfewEffectPool::PlayEffect(EAfterCurfewEffectType Type, UParticleSystem* Effect, const FVector& Location, const FRotator& Rotation, float Scale)
+{
+	check(Type != EAfterCurfewEffectType::Trail);
+
+	FEffectRequest Request;
+	Request.Effect = Effect;
+	Request.Location = Location;
+	Request.Rotation = Rotation;
+	Request.Scale = Scale;
+	Request.DistanceSquared = 0.f;
+	Request.Type = Type;
+	QueueRequest(Request);
+}
+
+void AAfterCurfewEffectPool::PlayTrail(UParticleSystem* Effect, USceneComponent* AttachTo, float Scale)
+{
+	if (AttachTo == nullptr)
+	{
+		return;
+	}
+
+	FEffectRequest Request;
+	Request.Effect = Effect;
+	Request.AttachTo = AttachTo;
+	Request.Location = AttachTo->GetComponentLocation();
+	Request.Rotation = AttachTo->GetComponentRotation();
+	Request.Scale = Scale;
+	Request.DistanceSquared = 0.f;
+	Request.Type = EAfterCurfewEffectType::Trail;
+	QueueRequest(Request);
+}
+
+void AAfterCurfewEffectPool::QueueRequest(const FEffectRequest& Request)
+{
+	if (Request.Effect != nullptr)
+	{
+		Requests.Add(Request);
+	}
+}
+
+bool AAfterCurfewEffectPool::UpdateView()
+{
+	const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	if (PlayerController == nullptr)
+	{
+		return false;
+	}
+
+	FRotator ViewRotation;
+	PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+	return true;
+}
+
+void AAfterCurfewEffectPool::StopSlot(int32 SlotIndex)
+{
+	UParticleSystemComponent* Component = Components[SlotIndex];
+	Component->DeactivateSystem();
+	if (Component->GetAttachParent() != nullptr)
+	{
+		Component->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+	}
+
+	FEffectSlot& Slot = Slots[SlotIndex];
+	Slot.AttachedTo.Reset();
+	Slot.bActive = false;
+	--NumActive;
+}
+
+void AAfterCurfewEffectPool::RetireEffects(float Now)
+{
+	for (int32 Index = 0; Index < Slots.Num(); ++Index)
+	{
+		const FEffectSlot& Slot = Slots[Index];
+		if (!Slot.bActive)
+		{
+			continue;
+		}
+
+		// Trails follow their projectile until it is gone or back in its pool, which hides it
+		bool bDone;
+		if (Slot.AttachedTo.IsExplicitlyNull())
+		{
+			bDone = Now >= Slot.StopTime;
+		}
+		else
+		{
+			const USceneComponent* AttachedTo = Slot.AttachedTo.Get();
+			bDone = AttachedTo == nullptr || AttachedTo->GetOwner() == nullptr || AttachedTo->GetOwner()->bHidden;
+		}
+
+		if (bDone)
+		{
+			StopSlot(Index);
+		}
+	}
+}
+
+int32 AAfterCurfewEffectPool::FindSlot(const FEffectRequest& Request) const
+{
+	const int32 First = (int32)Request.Type * MaxComponentsPerType;
+	const int32 Last = First + MaxComponentsPerType;
+
+	int32 FarthestSlot = INDEX_NONE;
+	for (int32 Index = First; Index < Last; ++Index)
+	{
+		const FEffectSlot& Slot = Slots[Index];
+		if (!Slot.bActive)
+		{
+			return Index;
+		}
+		if (Slot.DistanceSquared > Request.DistanceSquared && (FarthestSlot == INDEX_NONE || Slot.DistanceSquared > Slots[FarthestSlot].DistanceSquared))
+		{
+			FarthestSlot = Index;
+		}
+	}
+	return FarthestSlot;
+}
+
+void AAfterCurfewEffectPool::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewEffectUpdate);
+
+	const float Now = GetWorld()->GetTimeSeconds();
+	if (NumActive > 0)
+	{
+		RetireEffects(Now);
+	}
+
+	if (Requests.Num() > 0 && UpdateView())
+	{
+		const float MaxDistanceSquared = FMath::Square(MaxEffectDistance);
+		for (FEffectRequest& Request : Requests)
+		{
+			Request.DistanceSquared = FVector::DistSquared(Request.Location, ViewLocation);
+		}
+
+		// Nearest first, so the budget goes to the effects the player sees best
+		if (Requests.Num() > MaxStartsPerFrame)
+		{
+			Requests.Sort([](const FEffectRequest& A, const FEffectRequest& B) { return A.DistanceSquared < B.DistanceSquared; });
+		}
+
+		int32 NumStarted = 0;
+		for (const FEffectRequest& Request : Requests)
+		{
+			USceneComponent* AttachTo = Request.AttachTo.Get();
+			const bool bLost = Request.Type == EAfterCurfewEffectType::Trail && AttachTo == nullptr;
+			const int32 SlotIndex = NumStarted < MaxStartsPerFrame && !bLost && Request.DistanceSquared <= MaxDistanceSquared ? FindSlot(Request) : INDEX_NONE;
+			if (SlotIndex == INDEX_NONE)
+			{
+				INC_DWORD_STAT(STAT_AfterCurfewEffectsDropped);
+				continue;
+			}
+
+			if (Slots[SlotIndex].bActive)
+			{
+				StopSlot(SlotIndex);
+			}
+
+			UParticleSystemComponent* Component = Components[SlotIndex];
+			if (Component->Template != Request.Effect)
+			{
+				Component->SetTemplate(Request.Effect);
+			}
+			if (AttachTo != nullptr)
+			{
+				Component->AttachToComponent(AttachTo, FAttachmentTransformRules::SnapToTargetNotIncludingScale);
+			}
+			else
+			{
+				Component->SetWorldLocationAndRotation(Request.Location, Request.Rotation);
+			}
+			Component->SetWorldScale3D(FVector(Request.Scale));
+			Component->ActivateSystem(true);
+
+			FEffectSlot& Slot = Slots[SlotIndex];
+			Slot.AttachedTo = AttachTo;
+			Slot.StopTime = Now + (Request.Type == EAfterCurfewEffectType::Muzzle ? MuzzleLifetime : ImpactLifetime);
+			Slot.DistanceSquared = Request.DistanceSquared;
+			Slot.bActive = true;
+			++NumActive;
+			++NumStarted;
+		}
+
+		INC_DWORD_STAT_BY(STAT_AfterCurfewEffectsStarted, NumStarted);
+	}
+	Requests.Reset();
+
+	SET_DWORD_STAT(STAT_AfterCurfewEffectsActive, NumActive);
+}
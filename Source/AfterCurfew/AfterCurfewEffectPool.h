@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "AfterCurfewEffectPool.generated.h"
+
+class UParticleSystem;
+class UParticleSystemComponent;
+class USceneComponent;
+
+UENUM()
+enum class EAfterCurfewEffectType : uint8
+{
+	/** Flash where a shot leaves the gun */
+	Muzzle,
+	/** Follows a projectile while it flies */
+	Trail,
+	/** Where a projectile hits something */
+	Impact,
+	Num UMETA(Hidden)
+};
+
+/**
+ * Plays every weapon effect in a world through a fixed set of reused particle system components per effect type.
+ * Effects are requested during the frame and started together at the end of it, nearest to the view first, no more
+ * than MaxStartsPerFrame of them, so heavy fire costs the same as a few shots. Requests beyond MaxEffectDistance are
+ * dropped, and when every component of a type is busy a new effect only plays by taking the one of a farther effect.
+ * Muzzle and impact effects are stopped after their lifetime, so looping systems can be used for them too. Trails
+ * stop once the component they follow is gone or hidden, e.g. when its projectile goes back to the pool.
+ */
+UCLASS(config=Game, notplaceable)
+class AFTERCURFEW_API AAfterCurfewEffectPool : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewEffectPool();
+
+	/** Returns the effect pool for this world, creating it on first use, or nullptr where nothing is rendered */
+	static AAfterCurfewEffectPool* Get(UWorld* World);
+
+	// Begin Actor Interface
+	virtual void BeginPlay() override;
+	virtual void Tick(float DeltaSeconds) override;
+	// End Actor Interface
+
+	/** Queues Effect at Location for the end of the frame, muzzle and impact effects only */
+	void PlayEffect(EAfterCurfewEffectType Type, UParticleSystem* Effect, const FVector& Location, const FRotator& Rotation, float Scale);
+
+	/** Queues a trail Effect following AttachTo for the end of the frame */
+	void PlayTrail(UParticleSystem* Effect, USceneComponent* AttachTo, float Scale);
+
+	/** Number of components playing an effect */
+	FORCEINLINE int32 GetNumActive() const { return NumActive; }
+
+	/** Particle system components kept for each effect type */
+	UPROPERTY(Category = Effects, EditAnywhere, config, meta = (ClampMin = "1"))
+	int32 MaxComponentsPerType;
+
+	/** Most effects started in one frame, the farthest requests are dropped */
+	UPROPERTY(Category = Effects, EditAnywhere, config, meta = (ClampMin = "1"))
+	int32 MaxStartsPerFrame;
+
+	/** Requests farther than this from the view are dropped, in cm */
+	UPROPERTY(Category = Effects, EditAnywhere, config)
+	float MaxEffectDistance;
+
+	/** Seconds a muzzle effect plays for */
+	UPROPERTY(Category = Effects, EditAnywhere, config)
+	float MuzzleLifetime;
+
+	/** Seconds an impact effect plays for */
+	UPROPERTY(Category = Effects, EditAnywhere, config)
+	float ImpactLifetime;
+
+private:
+	struct FEffectRequest
+	{
+		UParticleSystem* Effect;
+		TWeakObjectPtr<USceneComponent> AttachTo;
+		FVector Location;
+		FRotator Rotation;
+		float Scale;
+		float DistanceSquared;
+		EAfterCurfewEffectType Type;
+	};
+
+	/** What a pooled component is playing */
+	struct FEffectSlot
+	{
+		TWeakObjectPtr<USceneComponent> AttachedTo;
+		float StopTime;
+		float DistanceSquared;
+		bool bActive;
+	};
+
+	void QueueRequest(const FEffectRequest& Request);
+
+	/** Stops the effects that have run their course */
+	void RetireEffects(float Now);
+
+	/** Returns the slot Request should play on, or INDEX_NONE if it does not get one */
+	int32 FindSlot(const FEffectRequest& Request) const;
+
+	void StopSlot(int32 SlotIndex);
+
+	/** Updates the view location, returns false if there is no view */
+	bool UpdateView();
+
+	/** Components effects are played on, MaxComponentsPerType for each type in type order */
+	UPROPERTY(Transient)
+	TArray<UParticleSystemComponent*> Components;
+
+	/** State of each entry of Components */
+	TArray<FEffectSlot> Slots;
+
+	/** Effects asked for since the last tick, those past MaxEffectDistance or the frame's start budget are dropped */
+	TArray<FEffectRequest> Requests;
+
+	FVector ViewLocation;
+
+	int32 NumActive;
+};
@@ -0,0 +1,142 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewFireAudioComponent.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewAudioPool.h"
+#include "AfterCurfewWeaponDefinition.h"
+#include "Components/AudioComponent.h"
+#include "Engine/World.h"
+#include "Sound/SoundBase.h"
+
+UAfterCurfewFireAudioComponent::UAfterCurfewFireAudioComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+
+	BurstGap = 0.25f;
+	ShotsPerRetrigger = 1;
+
+	LastShotTime = 0.f;
+	LastShotSoundTime = -BIG_NUMBER;
+	bInBurst = false;
+}
+
+void UAfterCurfewFireAudioComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	AudioPool = AAfterCurfewAudioPool::Get(GetWorld());
+}
+
+void UAfterCurfewFireAudioComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (AudioPool.IsValid() && LoopVoice.IsValid())
+	{
+		AudioPool->StopVoice(LoopVoice.Get());
+	}
+	LoopVoice.Reset();
+	bInBurst = false;
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UAfterCurfewFireAudioComponent::NotifyShot(const UAfterCurfewWeaponDefinition* Weapon, const FVector& Location)
+{
+	AAfterCurfewAudioPool* Pool = AudioPool.Get();
+	if (Pool == nullptr || Weapon == nullptr)
+	{
+		return;
+	}
+
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	// Sustained fire is one loop, however many shots it holds
+	USoundBase* LoopSound = Weapon->FireLoopSound.Get();
+	if (LoopSound != nullptr)
+	{
+		if (bInBurst && BurstWeapon.Get() != Weapon)
+		{
+			EndBurst();
+		}
+		if (!bInBurst)
+		{
+			bInBurst = true;
+			BurstWeapon = Weapon;
+			Pool->PlayLoop(this, LoopSound);
+			SetComponentTickEnabled(true);
+		}
+		LastShotTime = Now;
+		return;
+	}
+
+	// Spaced by the weapon's fire interval, with half a shot to spare for shots fired early in their frame
+	const float RetriggerInterval = Weapon->FireRate * (ShotsPerRetrigger - 0.5f);
+
+	// Still loading, the shot goes out silent
+	USoundBase* FireSound = Weapon->FireSound.Get();
+	if (FireSound != nullptr && Now - LastShotSoundTime >= RetriggerInterval)
+	{
+		Pool->PlayOneShot(this, FireSound, Location);
+		LastShotSoundTime = Now;
+	}
+}
+
+void UAfterCurfewFireAudioComponent::OnLoopStarted(UAudioComponent* Voice)
+{
+	// The burst may have ended before the pool got round to the loop
+	if (!bInBurst)
+	{
+		if (AudioPool.IsValid())
+		{
+			AudioPool->StopVoice(Voice);
+		}
+		return;
+	}
+	LoopVoice = Voice;
+}
+
+void UAfterCurfewFireAudioComponent::OnLoopDropped()
+{
+	// Only a burst still waiting for its loop, a loop that already plays keeps going
+	if (bInBurst && !LoopVoice.IsValid())
+	{
+		BurstWeapon.Reset();
+		bInBurst = false;
+		SetComponentTickEnabled(false);
+	}
+}
+
+void UAfterCurfewFireAudioComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction *ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (bInBurst && GetWorld()->GetTimeSeconds() - LastShotTime > BurstGap)
+	{
+		EndBurst();
+	}
+}
+
+void UAfterCurfewFireAudioComponent::EndBurst()
+{
+	AAfterCurfewAudioPool* Pool = AudioPool.Get();
+	if (Pool != nullptr)
+	{
+		if (LoopVoice.IsValid())
+		{
+			Pool->StopVoice(LoopVoice.Get());
+		}
+
+		const UAfterCurfewWeaponDefinition* Weapon = BurstWeapon.Get();
+		USoundBase* TailSound = Weapon != nullptr ? Weapon->FireTailSound.Get() : nullptr;
+		if (TailSound != nullptr)
+		{
+			Pool->PlayOneShot(this, TailSound, GetOwner()->GetActorLocation());
+		}
+	}
+
+	LoopVoice.Reset();
+	BurstWeapon.Reset();
+	bInBurst = false;
+	SetComponentTickEnabled(false);
+}
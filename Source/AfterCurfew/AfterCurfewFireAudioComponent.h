@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "AfterCurfewFireAudioComponent.generated.h"
+
+class AAfterCurfewAudioPool;
+class UAfterCurfewWeaponDefinition;
+class UAudioComponent;
+
+/**
+ * Turns a pawn's shots into sound without starting a voice per shot.
+ * A weapon with a fire loop starts the loop on its first shot, keeps it going while shots follow within BurstGap
+ * and ends it with the tail sound. A weapon with only a shot sound retriggers it once every ShotsPerRetrigger shots,
+ * on every shot by default.
+ * Voices come from the world's AAfterCurfewAudioPool, which limits them per pawn and globally.
+ */
+UCLASS(ClassGroup = (AfterCurfew), meta = (BlueprintSpawnableComponent))
+class AFTERCURFEW_API UAfterCurfewFireAudioComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UAfterCurfewFireAudioComponent();
+
+	// Begin ActorComponent Interface
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction *ThisTickFunction) override;
+	// End ActorComponent Interface
+
+	/** Called by the weapon for each shot fired with Weapon from Location */
+	void NotifyShot(const UAfterCurfewWeaponDefinition* Weapon, const FVector& Location);
+
+	/** Called by the pool once the fire loop plays on Voice */
+	void OnLoopStarted(UAudioComponent* Voice);
+
+	/** Called by the pool when it had no voice for the fire loop, the burst's next shot asks again */
+	void OnLoopDropped();
+
+	/** Time without a shot after which a burst is over and the loop ends */
+	UPROPERTY(Category = Audio, EditAnywhere, meta = (ClampMin = "0"))
+	float BurstGap;
+
+	/** For weapons without a loop, one shot sound stands for this many shots fired back to back, raise it to thin out dense fire */
+	UPROPERTY(Category = Audio, EditAnywhere, meta = (ClampMin = "1"))
+	int32 ShotsPerRetrigger;
+
+private:
+	/** Ends the current burst, stopping the loop and playing the tail */
+	void EndBurst();
+
+	TWeakObjectPtr<AAfterCurfewAudioPool> AudioPool;
+
+	/** Voice playing the fire loop, null while it is not playing yet */
+	TWeakObjectPtr<UAudioComponent> LoopVoice;
+
+	/** Weapon of the current burst, its tail ends the burst */
+	TWeakObjectPtr<const UAfterCurfewWeaponDefinition> BurstWeapon;
+
+	float LastShotTime;
+
+	float LastShotSoundTime;
+
+	/** Flag set while shots keep coming on a weapon with a loop */
+	uint32 bInBurst : 1;
+};
@@ -1,8 +1,34 @@
 // Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
 
 #include "AfterCurfewGameMode.h"
+#include "AfterCurfew.h"
 #include "AfterCurfewPawn.h"
 #include "AfterCurfewPlayerController.h"
+#include "AfterCurfewBenchmark.h"
+#include "AfterCurfewTelemetry.h"
+#include "AfterCurfewWeaponDefinition.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/CommandLine.h"
+#include "Misc/CoreDelegates.h"
+#include "Engine/AssetManager.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_MEMORY_STAT(TEXT("Preloaded Assets"), STAT_AfterCurfewPreloadedMemory, STATGROUP_AfterCurfew);
+
+/** Returns the estimated memory of the loaded objects among Assets */
+static int64 GetLoadedAssetBytes(const TArray<FSoftObjectPath>& Assets)
+{
+	int64 Bytes = 0;
+	for (const FSoftObjectPath& Asset : Assets)
+	{
+		if (UObject* Object = Asset.ResolveObject())
+		{
+			Bytes += Object->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
+		}
+	}
+	return Bytes;
+}
 
 AAfterCurfewGameMode::AAfterCurfewGameMode()
 {
@@ -11,5 +37,188 @@ AAfterCurfewGameMode::AAfterCurfewGameMode()
 
 	// set default pawn class to our character class
 	DefaultPawnClass = AAfterCurfewPawn::StaticClass();
+
+	PreloadMemoryBudgetMB = 256.f;
+
+	LoadingState = EAfterCurfewLoadingState::Idle;
+	bStartPlayPending = false;
+	NextPreloadAsset = 0;
+	PreloadStartTime = 0.0;
+	PreloadSeconds = 0.0;
+	TimeToFirstFrame = 0.0;
+	PreloadedBytes = 0;
+
+	RandomSeed = 0;
+	NumPawnSeeds = 0;
+}
+
+void AAfterCurfewGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	// A fixed seed makes a run reproducible, otherwise pick a fresh one each match
+	if (UGameplayStatics::HasOption(Options, TEXT("Seed")))
+	{
+		RandomSeed = UGameplayStatics::GetIntOption(Options, TEXT("Seed"), 0);
+	}
+	else if (!FParse::Value(FCommandLine::Get(), TEXT("ACSeed="), RandomSeed))
+	{
+		RandomSeed = int32(FPlatformTime::Cycles());
+	}
+	RandomStream.Initialize(RandomSeed);
+	NumPawnSeeds = 0;
+
+	UE_LOG(LogAfterCurfew, Log, TEXT("Random seed %d"), RandomSeed);
+
+	TArray<FSoftObjectPath> MatchAssets;
+	GatherMatchAssets(MatchAssets);
+
+	LoadingState = EAfterCurfewLoadingState::Loading;
+	PreloadStartTime = FPlatformTime::Seconds();
+	TSharedPtr<FStreamableHandle> Handle = UAssetManager::GetStreamableManager().RequestAsyncLoad(MatchAssets, FStreamableDelegate::CreateUObject(this, &AAfterCurfewGameMode::OnMatchAssetsLoaded), FStreamableManager::AsyncLoadHighPriority);
+
+	// Without a single asset to load there is no handle and the delegate is never called
+	if (Handle.IsValid())
+	{
+		PreloadHandles.Add(Handle);
+	}
+	else
+	{
+		OnMatchAssetsLoaded();
+	}
+}
+
+void AAfterCurfewGameMode::GatherMatchAssets(TArray<FSoftObjectPath>& OutAssets) const
+{
+	const AAfterCurfewPawn* PawnDefaults = DefaultPawnClass != nullptr ? Cast<AAfterCurfewPawn>(DefaultPawnClass->GetDefaultObject()) : nullptr;
+	if (PawnDefaults != nullptr && !PawnDefaults->GetShipMeshAsset().IsNull())
+	{
+		OutAssets.Add(PawnDefaults->GetShipMeshAsset().ToSoftObjectPath());
+	}
+
+	// Pawns without a weapon asset fire with the defaults, equipped weapons are loaded by the asset manager
+	GetDefault<UAfterCurfewWeaponDefinition>()->GatherGameAssets(OutAssets);
+}
+
+void AAfterCurfewGameMode::OnMatchAssetsLoaded()
+{
+	TArray<FSoftObjectPath> MatchAssets;
+	GatherMatchAssets(MatchAssets);
+
+	LoadingState = EAfterCurfewLoadingState::Ready;
+	PreloadSeconds = FPlatformTime::Seconds() - PreloadStartTime;
+	PreloadedBytes += GetLoadedAssetBytes(MatchAssets);
+	SET_MEMORY_STAT(STAT_AfterCurfewPreloadedMemory, PreloadedBytes);
+
+	UE_LOG(LogAfterCurfew, Log, TEXT("Loaded %d match assets (%.2f MB) in %.3fs"), MatchAssets.Num(), PreloadedBytes / (1024.0 * 1024.0), PreloadSeconds);
+
+	// Players who logged in while we were loading get the pawns they were held back from
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+		if (PlayerController != nullptr && PlayerController->GetPawn() == nullptr && PlayerCanRestart(PlayerController))
+		{
+			RestartPlayer(PlayerController);
+		}
+	}
+
+	if (bStartPlayPending)
+	{
+		bStartPlayPending = false;
+		StartPlay();
+	}
+}
+
+bool AAfterCurfewGameMode::PlayerCanRestart_Implementation(APlayerController* Player)
+{
+	// A pawn spawned before its mesh is in would build its collision twice, once without and once with the mesh
+	return LoadingState != EAfterCurfewLoadingState::Loading && Super::PlayerCanRestart_Implementation(Player);
 }
 
+void AAfterCurfewGameMode::PreloadNextAsset()
+{
+	const int64 BudgetBytes = int64(PreloadMemoryBudgetMB * 1024.f * 1024.f);
+	if (NextPreloadAsset >= PreloadAssets.Num() || PreloadedBytes >= BudgetBytes)
+	{
+		if (NextPreloadAsset > 0 || PreloadAssets.Num() > 0)
+		{
+			UE_LOG(LogAfterCurfew, Log, TEXT("Preloaded %d of %d optional assets, %.2f MB in total"), NextPreloadAsset, PreloadAssets.Num(), PreloadedBytes / (1024.0 * 1024.0));
+		}
+		return;
+	}
+
+	// One at a time, so we stop as soon as the budget is used up
+	TArray<FSoftObjectPath> Assets;
+	Assets.Add(PreloadAssets[NextPreloadAsset++]);
+	PreloadHandles.Add(UAssetManager::GetStreamableManager().RequestAsyncLoad(Assets, FStreamableDelegate::CreateUObject(this, &AAfterCurfewGameMode::OnPreloadAssetLoaded)));
+}
+
+void AAfterCurfewGameMode::OnPreloadAssetLoaded()
+{
+	TArray<FSoftObjectPath> Assets;
+	Assets.Add(PreloadAssets[NextPreloadAsset - 1]);
+
+	PreloadedBytes += GetLoadedAssetBytes(Assets);
+	SET_MEMORY_STAT(STAT_AfterCurfewPreloadedMemory, PreloadedBytes);
+
+	PreloadNextAsset();
+}
+
+void AAfterCurfewGameMode::OnFirstFrameEnd()
+{
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+	EndFrameHandle.Reset();
+
+	TimeToFirstFrame = FPlatformTime::Seconds() - GStartTime;
+	UE_LOG(LogAfterCurfew, Log, TEXT("First frame of the match %.3fs after launch"), TimeToFirstFrame);
+}
+
+void AAfterCurfewGameMode::StartPlay()
+{
+	// Nothing in the level begins play before the match assets are in
+	if (LoadingState == EAfterCurfewLoadingState::Loading)
+	{
+		UE_LOG(LogAfterCurfew, Log, TEXT("Waiting for match assets"));
+		bStartPlayPending = true;
+		return;
+	}
+
+	Super::StartPlay();
+
+	AAfterCurfewTelemetry::Get(GetWorld());
+
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &AAfterCurfewGameMode::OnFirstFrameEnd);
+	PreloadNextAsset();
+
+	if (AAfterCurfewBenchmark::IsRequested())
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.ObjectFlags |= RF_Transient;
+		GetWorld()->SpawnActor<AAfterCurfewBenchmark>(SpawnParams);
+	}
+}
+
+void AAfterCurfewGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+	EndFrameHandle.Reset();
+
+	for (const TSharedPtr<FStreamableHandle>& Handle : PreloadHandles)
+	{
+		if (Handle.IsValid())
+		{
+			Handle->CancelHandle();
+		}
+	}
+	PreloadHandles.Empty();
+
+	PreloadedBytes = 0;
+	SET_MEMORY_STAT(STAT_AfterCurfewPreloadedMemory, 0);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+int32 AAfterCurfewGameMode::MakePawnSeed()
+{
+	return int32(HashCombine(uint32(RandomSeed), ++NumPawnSeeds));
+}
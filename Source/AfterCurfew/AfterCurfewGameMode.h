@@ -4,15 +4,114 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/GameModeBase.h"
+#include "Engine/StreamableManager.h"
 #include "AfterCurfewGameMode.generated.h"
 
-UCLASS(MinimalAPI)
+UENUM()
+enum class EAfterCurfewLoadingState : uint8
+{
+	/** Nothing requested yet */
+	Idle,
+	/** Waiting for the assets the match needs, the match starts once they are in */
+	Loading,
+	/** The match assets are in memory, optional ones may still be streaming in */
+	Ready,
+};
+
+/**
+ * Game mode of every AfterCurfew match.
+ * Nothing of the pawns, projectiles and weapons is referenced by their classes, so starting the game loads none of it.
+ * Instead InitGame asynchronously preloads the assets of the default pawn and weapon, and StartPlay and the players'
+ * first pawns are held until they are in. Once the match has started the assets listed in PreloadAssets follow, in order, until the
+ * assets preloaded so far take up PreloadMemoryBudgetMB, anything after that is loaded when it is first needed.
+ */
+UCLASS(MinimalAPI, config=Game)
 class AAfterCurfewGameMode : public AGameModeBase
 {
 	GENERATED_BODY()
 
 public:
 	AAfterCurfewGameMode();
+
+	// Begin GameModeBase Interface
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void StartPlay() override;
+	virtual bool PlayerCanRestart_Implementation(APlayerController* Player) override;
+	// End GameModeBase Interface
+
+	// Begin Actor Interface
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	// End Actor Interface
+
+	FORCEINLINE EAfterCurfewLoadingState GetLoadingState() const { return LoadingState; }
+
+	/** Seconds from InitGame until the match assets were in memory */
+	FORCEINLINE double GetPreloadSeconds() const { return PreloadSeconds; }
+
+	/** Seconds from launch until the end of the first frame of the match, zero until then */
+	FORCEINLINE double GetTimeToFirstFrame() const { return TimeToFirstFrame; }
+
+	/** Estimated memory of every asset we preloaded and still hold */
+	FORCEINLINE int64 GetPreloadedBytes() const { return PreloadedBytes; }
+
+	/** Assets preloaded after the match assets, in order, while they fit the budget */
+	UPROPERTY(Category = Loading, EditAnywhere, config)
+	TArray<FSoftObjectPath> PreloadAssets;
+
+	/** Memory the preloaded assets may take up, in MB */
+	UPROPERTY(Category = Loading, EditAnywhere, config, meta = (ClampMin = "0"))
+	float PreloadMemoryBudgetMB;
+
+	/** Seed every random decision of the match is derived from, set with ?Seed= or -ACSeed= */
+	FORCEINLINE int32 GetRandomSeed() const { return RandomSeed; }
+
+	/** Stream seeded with RandomSeed, use this instead of FMath::Rand so runs can be reproduced */
+	FORCEINLINE const FRandomStream& GetRandomStream() const { return RandomStream; }
+
+	/**
+	 * Returns the seed for the next pawn's weapon stream.
+	 * Derived from RandomSeed and the number of seeds handed out, so pawns spawned in the same order get the same seeds.
+	 */
+	int32 MakePawnSeed();
+
+private:
+	/** Adds the assets of the default pawn and weapon to OutAssets */
+	void GatherMatchAssets(TArray<FSoftObjectPath>& OutAssets) const;
+
+	void OnMatchAssetsLoaded();
+
+	/** Requests the next of PreloadAssets, if the budget allows */
+	void PreloadNextAsset();
+
+	void OnPreloadAssetLoaded();
+
+	/** Measures the time to first frame at the end of the first frame of the match */
+	void OnFirstFrameEnd();
+
+	EAfterCurfewLoadingState LoadingState;
+
+	/** StartPlay was called while the match assets were loading */
+	bool bStartPlayPending;
+
+	/** Handles keeping every preloaded asset in memory, the match assets first */
+	TArray<TSharedPtr<FStreamableHandle>> PreloadHandles;
+
+	/** Index in PreloadAssets of the next asset to request */
+	int32 NextPreloadAsset;
+
+	double PreloadStartTime;
+	double PreloadSeconds;
+	double TimeToFirstFrame;
+	int64 PreloadedBytes;
+
+	FDelegateHandle EndFrameHandle;
+
+	int32 RandomSeed;
+
+	/** Pawn seeds handed out so far */
+	uint32 NumPawnSeeds;
+
+	FRandomStream RandomStream;
 };
 
 
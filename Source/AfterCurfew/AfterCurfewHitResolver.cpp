@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewHitResolver.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewProjectile.h"
+#include "AfterCurfewWorldManager.h"
+#include "Components/PrimitiveComponent.h"
+
+DECLARE_CYCLE_STAT(TEXT("Resolve Projectile Hits"), STAT_AfterCurfewResolveHits, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectile Hits"), STAT_AfterCurfewHits, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Bodies Pushed"), STAT_AfterCurfewBodiesPushed, STATGROUP_AfterCurfew);
+
+AAfterCurfewHitResolver::AAfterCurfewHitResolver()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	NumPendingHits = 0;
+}
+
+AAfterCurfewHitResolver* AAfterCurfewHitResolver::Get(UWorld* World)
+{
+	return FindOrSpawnWorldManager<AAfterCurfewHitResolver>(World);
+}
+
+void AAfterCurfewHitResolver::QueueHit(AAfterCurfewProjectile* Projectile, UPrimitiveComponent* OtherComp, const FVector& Impulse, const FVector& Location)
+{
+	++NumPendingHits;
+	++GAfterCurfewCounters.ProjectileHits;
+
+	if (OtherComp != nullptr && OtherComp->IsSimulatingPhysics())
+	{
+		int32& ImpulseIndex = ImpulseIndices.FindOrAdd(OtherComp, INDEX_NONE);
+		if (ImpulseIndex == INDEX_NONE)
+		{
+			ImpulseIndex = PendingImpulses.AddUninitialized();
+			FPendingImpulse& NewImpulse = PendingImpulses[ImpulseIndex];
+			NewImpulse.Component = OtherComp;
+			NewImpulse.Impulse = FVector::ZeroVector;
+			NewImpulse.WeightedLocation = FVector::ZeroVector;
+			NewImpulse.TotalWeight = 0.f;
+		}
+
+		FPendingImpulse& PendingImpulse = PendingImpulses[ImpulseIndex];
+		const float Weight = Impulse.Size();
+		PendingImpulse.Impulse += Impulse;
+		PendingImpulse.WeightedLocation += Location * Weight;
+		PendingImpulse.TotalWeight += Weight;
+	}
+
+	if (Projectile != nullptr)
+	{
+		FPendingRelease& PendingRelease = PendingReleases[PendingReleases.AddUninitialized()];
+		PendingRelease.Projectile = Projectile;
+		PendingRelease.PoolSerial = Projectile->GetPoolSerial();
+	}
+}
+
+void AAfterCurfewHitResolver::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (NumPendingHits > 0)
+	{
+		ResolveHits();
+	}
+}
+
+void AAfterCurfewHitResolver::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	PendingImpulses.Empty();
+	ImpulseIndices.Empty();
+	PendingReleases.Empty();
+	NumPendingHits = 0;
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AAfterCurfewHitResolver::ResolveHits()
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewResolveHits);
+
+	INC_DWORD_STAT_BY(STAT_AfterCurfewHits, NumPendingHits);
+	INC_DWORD_STAT_BY(STAT_AfterCurfewBodiesPushed, PendingImpulses.Num());
+
+	// Several hits on one body become one impulse through their impulse-weighted centre
+	for (const FPendingImpulse& PendingImpulse : PendingImpulses)
+	{
+		UPrimitiveComponent* Component = PendingImpulse.Component.Get();
+		if (Component != nullptr && Component->IsSimulatingPhysics() && PendingImpulse.TotalWeight > KINDA_SMALL_NUMBER)
+		{
+			Component->AddImpulseAtLocation(PendingImpulse.Impulse, PendingImpulse.WeightedLocation / PendingImpulse.TotalWeight);
+		}
+	}
+
+	// A projectile that expired and was fired again since its hit is in flight for another shot, so leave it be
+	for (const FPendingRelease& PendingRelease : PendingReleases)
+	{
+		AAfterCurfewProjectile* Projectile = PendingRelease.Projectile.Get();
+		if (Projectile != nullptr && Projectile->IsPooledActive() && Projectile->GetPoolSerial() == PendingRelease.PoolSerial)
+		{
+			Projectile->ReturnToPool();
+		}
+	}
+
+	PendingImpulses.Reset();
+	ImpulseIndices.Reset();
+	PendingReleases.Reset();
+	NumPendingHits = 0;
+}
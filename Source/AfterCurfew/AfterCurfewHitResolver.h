@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "AfterCurfewHitResolver.generated.h"
+
+class AAfterCurfewProjectile;
+class UPrimitiveComponent;
+
+/**
+ * Collects the projectile hits of a frame and resolves them together after physics.
+ * Hit callbacks only queue what happened, so no impulse or pool release runs inside a collision callback.
+ * Impulses on the same body are summed and applied once, and hit projectiles go back to the pool in one pass.
+ */
+UCLASS(notplaceable)
+class AFTERCURFEW_API AAfterCurfewHitResolver : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewHitResolver();
+
+	/** Returns the hit resolver for this world, creating it on first use */
+	static AAfterCurfewHitResolver* Get(UWorld* World);
+
+	// Begin Actor Interface
+	virtual void Tick(float DeltaSeconds) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	// End Actor Interface
+
+	/** Queues Impulse on OtherComp if it simulates physics, and Projectile's return to its pool if one is given */
+	void QueueHit(AAfterCurfewProjectile* Projectile, UPrimitiveComponent* OtherComp, const FVector& Impulse, const FVector& Location);
+
+	/** Number of hits queued this frame */
+	FORCEINLINE int32 GetNumPendingHits() const { return NumPendingHits; }
+
+private:
+	/** Every impulse queued on one body this frame */
+	struct FPendingImpulse
+	{
+		TWeakObjectPtr<UPrimitiveComponent> Component;
+
+		FVector Impulse;
+
+		/** Sum of the hit locations weighted by impulse size, divided out when applied */
+		FVector WeightedLocation;
+
+		float TotalWeight;
+	};
+
+	/** A projectile to return, the serial tells whether it was recycled for another shot in the meantime */
+	struct FPendingRelease
+	{
+		TWeakObjectPtr<AAfterCurfewProjectile> Projectile;
+		uint32 PoolSerial;
+	};
+
+	/** Applies the summed impulses and returns the hit projectiles */
+	void ResolveHits();
+
+	/** Summed impulse of each body pushed this frame, found through ImpulseIndices and applied once in ResolveHits */
+	TArray<FPendingImpulse> PendingImpulses;
+
+	/** Index in PendingImpulses of each body */
+	TMap<const UPrimitiveComponent*, int32> ImpulseIndices;
+
+	TArray<FPendingRelease> PendingReleases;
+
+	int32 NumPendingHits;
+};
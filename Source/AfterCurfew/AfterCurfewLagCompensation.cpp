@@ -0,0 +1,432 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewLagCompensation.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewLog.h"
+#include "AfterCurfewPawn.h"
+#include "AfterCurfewWorldManager.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+
+DECLARE_CYCLE_STAT(TEXT("Lag Compensation Sample"), STAT_AfterCurfewLagCompSample, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Lag Compensation Rewind"), STAT_AfterCurfewLagCompRewind, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rewinds"), STAT_AfterCurfewRewinds, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hits Confirmed"), STAT_AfterCurfewHitsConfirmed, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hits Rejected"), STAT_AfterCurfewHitsRejected, STATGROUP_AfterCurfew);
+DECLARE_MEMORY_STAT(TEXT("Lag Compensation History"), STAT_AfterCurfewLagCompMemory, STATGROUP_AfterCurfew);
+
+/** Returns true if the segment from Start to Start + Dir passes through the box, and how far along it enters */
+static FORCEINLINE bool IntersectSegmentBox(const FVector& Start, const FVector& Dir, const FVector& InvDir, const FVector& BoxMin, const FVector& BoxMax, float& OutFraction)
+{
+	float EnterFraction = 0.f;
+	float ExitFraction = 1.f;
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		if (FMath::IsNearlyZero(Dir[Axis]))
+		{
+			if (Start[Axis] < BoxMin[Axis] || Start[Axis] > BoxMax[Axis])
+			{
+				return false;
+			}
+			continue;
+		}
+
+		float Near = (BoxMin[Axis] - Start[Axis]) * InvDir[Axis];
+		float Far = (BoxMax[Axis] - Start[Axis]) * InvDir[Axis];
+		if (Near > Far)
+		{
+			Swap(Near, Far);
+		}
+		EnterFraction = FMath::Max(EnterFraction, Near);
+		ExitFraction = FMath::Min(ExitFraction, Far);
+		if (EnterFraction > ExitFraction)
+		{
+			return false;
+		}
+	}
+
+	OutFraction = EnterFraction;
+	return true;
+}
+
+AAfterCurfewLagCompensation::AAfterCurfewLagCompensation()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	MaxHistoryFrames = 64;
+	MaxRewindTime = 0.5f;
+	ClientViewDelay = 0.05f;
+	HitTolerance = 20.f;
+
+	HistoryCapacity = 0;
+	SlotCapacity = 0;
+	NewestFrame = 0;
+	NumFrames = 0;
+	bRecording = false;
+	ProjectileChannel = ECC_WorldDynamic;
+}
+
+AAfterCurfewLagCompensation* AAfterCurfewLagCompensation::Get(UWorld* World)
+{
+	return FindOrSpawnWorldManager<AAfterCurfewLagCompensation>(World);
+}
+
+void AAfterCurfewLagCompensation::BeginPlay()
+{
+	Super::BeginPlay();
+
+	HistoryCapacity = FMath::RoundUpToPowerOfTwo(FMath::Max(MaxHistoryFrames, 2));
+	FrameTimes.SetNumZeroed(HistoryCapacity);
+	GrowSlots(FMath::Max(SlotPawns.Num(), 1));
+
+	// In a standalone game every shot is fired where it lands, there is nothing to compensate
+	bRecording = GetNetMode() != NM_Standalone;
+
+	TraceService = AAfterCurfewTraceService::Get(GetWorld());
+
+	FCollisionResponseTemplate ProjectileProfile;
+	if (UCollisionProfile::Get()->GetProfileTemplate(TEXT("Projectile"), ProjectileProfile))
+	{
+		ProjectileChannel = ProjectileProfile.ObjectType;
+	}
+}
+
+void AAfterCurfewLagCompensation::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (TraceService.IsValid())
+	{
+		for (const FPendingHit& Hit : PendingHits)
+		{
+			TraceService->Cancel(Hit.WorldTrace);
+		}
+	}
+	PendingHits.Empty();
+
+	SlotPawns.Empty();
+	FreeSlots.Empty();
+	PawnSlots.Empty();
+	FrameTimes.Empty();
+	CenterX.Empty();
+	CenterY.Empty();
+	CenterZ.Empty();
+	ExtentX.Empty();
+	ExtentY.Empty();
+	ExtentZ.Empty();
+	HistoryCapacity = 0;
+	SlotCapacity = 0;
+	NumFrames = 0;
+
+	SET_MEMORY_STAT(STAT_AfterCurfewLagCompMemory, 0);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AAfterCurfewLagCompensation::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (bRecording && HistoryCapacity > 0 && SlotPawns.Num() > 0)
+	{
+		SampleFrame(GetWorld()->GetTimeSeconds());
+	}
+
+	if (PendingHits.Num() > 0)
+	{
+		ResolvePendingHits();
+	}
+}
+
+void AAfterCurfewLagCompensation::SetRecording(bool bRecord)
+{
+	if (bRecording != bRecord)
+	{
+		bRecording = bRecord;
+		NumFrames = 0;
+	}
+}
+
+void AAfterCurfewLagCompensation::RegisterPawn(AAfterCurfewPawn* Pawn)
+{
+	if (Pawn == nullptr || PawnSlots.Contains(Pawn))
+	{
+		return;
+	}
+
+	const int32 Slot = FreeSlots.Num() > 0 ? FreeSlots.Pop(false) : SlotPawns.AddDefaulted();
+	if (Slot >= SlotCapacity && HistoryCapacity > 0)
+	{
+		GrowSlots(Slot + 1);
+	}
+	SlotPawns[Slot] = Pawn;
+	PawnSlots.Add(Pawn, Slot);
+
+	// Whoever had the slot before must not be hit in our place
+	for (int32 Frame = 0; Frame < HistoryCapacity; ++Frame)
+	{
+		ExtentX[Frame * SlotCapacity + Slot] = -1.f;
+	}
+}
+
+void AAfterCurfewLagCompensation::UnregisterPawn(AAfterCurfewPawn* Pawn)
+{
+	int32 Slot;
+	if (PawnSlots.RemoveAndCopyValue(Pawn, Slot))
+	{
+		SlotPawns[Slot].Reset();
+		FreeSlots.Add(Slot);
+	}
+}
+
+void AAfterCurfewLagCompensation::GrowSlots(int32 Count)
+{
+	const int32 NewCapacity = FMath::RoundUpToPowerOfTwo(FMath::Max(Count, 8));
+	if (NewCapacity <= SlotCapacity)
+	{
+		return;
+	}
+
+	// Frames keep their slots side by side, so every frame moves to its new stride
+	auto Relayout = [this, NewCapacity](TArray<float>& Values, float EmptyValue)
+	{
+		TArray<float> NewValues;
+		NewValues.Init(EmptyValue, HistoryCapacity * NewCapacity);
+		for (int32 Frame = 0; Frame < HistoryCapacity && SlotCapacity > 0; ++Frame)
+		{
+			FMemory::Memcpy(&NewValues[Frame * NewCapacity], &Values[Frame * SlotCapacity], SlotCapacity * sizeof(float));
+		}
+		Values = MoveTemp(NewValues);
+	};
+	Relayout(CenterX, 0.f);
+	Relayout(CenterY, 0.f);
+	Relayout(CenterZ, 0.f);
+	Relayout(ExtentX, -1.f);
+	Relayout(ExtentY, -1.f);
+	Relayout(ExtentZ, -1.f);
+	SlotCapacity = NewCapacity;
+
+	SET_MEMORY_STAT(STAT_AfterCurfewLagCompMemory, GetHistoryBytes());
+}
+
+void AAfterCurfewLagCompensation::SampleFrame(float Time)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewLagCompSample);
+
+	NewestFrame = (NewestFrame + 1) & (HistoryCapacity - 1);
+	NumFrames = FMath::Min(NumFrames + 1, HistoryCapacity);
+	FrameTimes[NewestFrame] = Time;
+
+	const int32 Base = NewestFrame * SlotCapacity;
+	for (int32 Slot = 0; Slot < SlotPawns.Num(); ++Slot)
+	{
+		const AAfterCurfewPawn* Pawn = SlotPawns[Slot].Get();
+		const USceneComponent* Root = Pawn != nullptr ? Pawn->GetRootComponent() : nullptr;
+		if (Root == nullptr)
+		{
+			ExtentX[Base + Slot] = -1.f;
+			continue;
+		}
+
+		const FBoxSphereBounds& Bounds = Root->Bounds;
+		CenterX[Base + Slot] = Bounds.Origin.X;
+		CenterY[Base + Slot] = Bounds.Origin.Y;
+		CenterZ[Base + Slot] = Bounds.Origin.Z;
+		ExtentX[Base + Slot] = Bounds.BoxExtent.X;
+		ExtentY[Base + Slot] = Bounds.BoxExtent.Y;
+		ExtentZ[Base + Slot] = Bounds.BoxExtent.Z;
+	}
+}
+
+float AAfterCurfewLagCompensation::GetClientViewTime(const AController* Controller) const
+{
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	// The shot left when the shooter saw the world one round trip ago, plus however far behind it displays pawns
+	const APlayerController* PlayerController = Cast<APlayerController>(Controller);
+	if (PlayerController == nullptr || PlayerController->IsLocalController() || PlayerController->PlayerState == nullptr)
+	{
+		return Now;
+	}
+	const float Latency = PlayerController->PlayerState->ExactPing * 0.001f + ClientViewDelay;
+	return Now - FMath::Clamp(Latency, 0.f, MaxRewindTime);
+}
+
+int32 AAfterCurfewLagCompensation::Rewind(const FAfterCurfewRewindShot& Shot, int32 FirstSlot, int32 LastSlot, int32 IgnoreSlot, float& OutHitTime) const
+{
+	if (NumFrames == 0 || FirstSlot > LastSlot)
+	{
+		return INDEX_NONE;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewLagCompRewind);
+	INC_DWORD_STAT(STAT_AfterCurfewRewinds);
+
+	// A shot cannot have flown past the latest frame
+	const float NewestTime = FrameTimes[GetFrame(NumFrames - 1)];
+	const float ShotEnd = FMath::Max(Shot.FireTime, FMath::Min(Shot.FireTime + Shot.MaxFlightTime, NewestTime));
+
+	// Last frame at or before the shot, the oldest one if the shot is older than the history
+	int32 StartAge = 0;
+	int32 Low = 0;
+	int32 High = NumFrames - 1;
+	while (Low <= High)
+	{
+		const int32 Mid = (Low + High) / 2;
+		if (FrameTimes[GetFrame(Mid)] <= Shot.FireTime)
+		{
+			StartAge = Mid;
+			Low = Mid + 1;
+		}
+		else
+		{
+			High = Mid - 1;
+		}
+	}
+
+	const float Inflate = Shot.Radius + HitTolerance;
+	for (int32 Age = StartAge; Age < NumFrames; ++Age)
+	{
+		const bool bLastFrame = Age + 1 >= NumFrames;
+		const int32 Frame = GetFrame(Age);
+		const int32 NextFrame = bLastFrame ? Frame : GetFrame(Age + 1);
+
+		// The step from this frame to the next, or from the shot if it left in between
+		const float StepStart = Age == StartAge ? Shot.FireTime : FrameTimes[Frame];
+		const float StepEnd = bLastFrame ? ShotEnd : FMath::Min(FrameTimes[NextFrame], ShotEnd);
+		if (StepStart > ShotEnd)
+		{
+			break;
+		}
+
+		const FVector Start = Shot.Origin + Shot.Velocity * (StepStart - Shot.FireTime);
+		const FVector Dir = Shot.Velocity * FMath::Max(StepEnd - StepStart, 0.f);
+		const FVector InvDir(Dir.X != 0.f ? 1.f / Dir.X : 0.f, Dir.Y != 0.f ? 1.f / Dir.Y : 0.f, Dir.Z != 0.f ? 1.f / Dir.Z : 0.f);
+
+		// The pawn may be anywhere between its bounds at both ends of the step
+		const int32 Base = Frame * SlotCapacity;
+		const int32 NextBase = NextFrame * SlotCapacity;
+		int32 HitSlot = INDEX_NONE;
+		float HitFraction = 2.f;
+		for (int32 Slot = FirstSlot; Slot <= LastSlot; ++Slot)
+		{
+			if (Slot == IgnoreSlot || ExtentX[Base + Slot] < 0.f)
+			{
+				continue;
+			}
+
+			const int32 Next = ExtentX[NextBase + Slot] < 0.f ? Base + Slot : NextBase + Slot;
+			const FVector BoxMin(
+				FMath::Min(CenterX[Base + Slot] - ExtentX[Base + Slot], CenterX[Next] - ExtentX[Next]) - Inflate,
+				FMath::Min(CenterY[Base + Slot] - ExtentY[Base + Slot], CenterY[Next] - ExtentY[Next]) - Inflate,
+				FMath::Min(CenterZ[Base + Slot] - ExtentZ[Base + Slot], CenterZ[Next] - ExtentZ[Next]) - Inflate);
+			const FVector BoxMax(
+				FMath::Max(CenterX[Base + Slot] + ExtentX[Base + Slot], CenterX[Next] + ExtentX[Next]) + Inflate,
+				FMath::Max(CenterY[Base + Slot] + ExtentY[Base + Slot], CenterY[Next] + ExtentY[Next]) + Inflate,
+				FMath::Max(CenterZ[Base + Slot] + ExtentZ[Base + Slot], CenterZ[Next] + ExtentZ[Next]) + Inflate);
+
+			float Fraction;
+			if (IntersectSegmentBox(Start, Dir, InvDir, BoxMin, BoxMax, Fraction) && Fraction < HitFraction)
+			{
+				HitSlot = Slot;
+				HitFraction = Fraction;
+			}
+		}
+
+		if (HitSlot != INDEX_NONE)
+		{
+			OutHitTime = StepStart + (StepEnd - StepStart) * HitFraction;
+			return HitSlot;
+		}
+		if (StepEnd >= ShotEnd)
+		{
+			break;
+		}
+	}
+
+	return INDEX_NONE;
+}
+
+bool AAfterCurfewLagCompensation::RewindShot(const FAfterCurfewRewindShot& Shot, const AAfterCurfewPawn* IgnorePawn, AAfterCurfewPawn*& OutPawn, float& OutHitTime) const
+{
+	const int32* IgnoreSlot = PawnSlots.Find(IgnorePawn);
+	const int32 HitSlot = Rewind(Shot, 0, SlotPawns.Num() - 1, IgnoreSlot != nullptr ? *IgnoreSlot : INDEX_NONE, OutHitTime);
+	OutPawn = HitSlot != INDEX_NONE ? SlotPawns[HitSlot].Get() : nullptr;
+	return OutPawn != nullptr;
+}
+
+bool AAfterCurfewLagCompensation::ValidateHit(const FAfterCurfewRewindShot& Shot, const AAfterCurfewPawn* Target, float& OutHitTime) const
+{
+	const int32* Slot = PawnSlots.Find(Target);
+	if (Slot == nullptr)
+	{
+		return false;
+	}
+
+	return Rewind(Shot, *Slot, *Slot, INDEX_NONE, OutHitTime) != INDEX_NONE;
+}
+
+void AAfterCurfewLagCompensation::ConfirmHit(AAfterCurfewPawn* Instigator, AAfterCurfewPawn* Target, const FVector& Location)
+{
+	INC_DWORD_STAT(STAT_AfterCurfewHitsConfirmed);
+
+	AC_LOG(Weapon, Verbose, TEXT("%s hit %s"), *GetNameSafe(Instigator), *GetNameSafe(Target));
+	OnHitConfirmed.Broadcast(Instigator, Target, Location);
+}
+
+void AAfterCurfewLagCompensation::ConfirmHitIfUnobstructed(AAfterCurfewPawn* Instigator, AAfterCurfewPawn* Target, const FVector& Location, const FVector& ShotOrigin, const FVector& HitPoint)
+{
+	AAfterCurfewTraceService* const Traces = TraceService.Get();
+	if (Traces == nullptr)
+	{
+		ConfirmHit(Instigator, Target, Location);
+		return;
+	}
+
+	// Only what stays put, a pawn in the way back then is not where it is now
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(AfterCurfewHitWorldTrace), false, Instigator);
+	QueryParams.AddIgnoredActor(Target);
+	QueryParams.MobilityType = EQueryMobilityType::Static;
+
+	FPendingHit& Hit = PendingHits.AddDefaulted_GetRef();
+	Hit.Instigator = Instigator;
+	Hit.Target = Target;
+	Hit.Location = Location;
+	Hit.WorldTrace = Traces->RequestLineTrace(ShotOrigin, HitPoint, ProjectileChannel, QueryParams, EAfterCurfewTracePriority::High);
+}
+
+void AAfterCurfewLagCompensation::ResolvePendingHits()
+{
+	AAfterCurfewTraceService* const Traces = TraceService.Get();
+	for (int32 Index = 0; Index < PendingHits.Num(); ++Index)
+	{
+		FPendingHit& Hit = PendingHits[Index];
+
+		FHitResult TraceHit;
+		const EAfterCurfewTraceStatus Status = Traces != nullptr ? Traces->FetchResult(Hit.WorldTrace, TraceHit) : EAfterCurfewTraceStatus::Invalid;
+		if (Status == EAfterCurfewTraceStatus::Pending)
+		{
+			continue;
+		}
+
+		AAfterCurfewPawn* const Target = Hit.Target.Get();
+		if (Status == EAfterCurfewTraceStatus::Done && !TraceHit.bBlockingHit && Target != nullptr)
+		{
+			ConfirmHit(Hit.Instigator.Get(), Target, Hit.Location);
+		}
+		else
+		{
+			AC_LOG(Weapon, Verbose, TEXT("%s: rejected hit on %s, blocked by %s"), *GetNameSafe(Hit.Instigator.Get()), *GetNameSafe(Target), *GetNameSafe(TraceHit.GetActor()));
+			RejectHit();
+		}
+
+		PendingHits.RemoveAt(Index--, 1, false);
+	}
+}
+
+void AAfterCurfewLagCompensation::RejectHit()
+{
+	INC_DWORD_STAT(STAT_AfterCurfewHitsRejected);
+}
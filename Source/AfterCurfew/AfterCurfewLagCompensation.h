@@ -0,0 +1,201 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "AfterCurfewTraceService.h"
+#include "AfterCurfewLagCompensation.generated.h"
+
+class AAfterCurfewPawn;
+class AController;
+
+/** A shot as the server reconstructs it, flying in a straight line from Origin at FireTime */
+struct FAfterCurfewRewindShot
+{
+	FVector Origin;
+
+	/** Velocity of the shot, in cm/s */
+	FVector Velocity;
+
+	/** Collision radius of the projectile */
+	float Radius;
+
+	/** Server time the shooter saw the world at when firing */
+	float FireTime;
+
+	/** Seconds the shot flies for at most */
+	float MaxFlightTime;
+
+	FAfterCurfewRewindShot()
+		: Origin(FVector::ZeroVector)
+		, Velocity(FVector::ZeroVector)
+		, Radius(0.f)
+		, FireTime(0.f)
+		, MaxFlightTime(0.f)
+	{
+	}
+};
+
+/** Called on the server for every hit of a shot on a pawn it accepts, with the shooter, the pawn hit and where */
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FAfterCurfewHitConfirmed, AAfterCurfewPawn* /*Instigator*/, AAfterCurfewPawn* /*Target*/, const FVector& /*Location*/);
+
+/**
+ * Server side record of where every AfterCurfew pawn has been, to validate hits against what the shooter saw.
+ * Each server tick after physics the bounds of every registered pawn are appended to a history of MaxHistoryFrames
+ * frames. A frame stores the bounds of all pawns next to each other, one array per component, so rewinding a shot
+ * reads a few contiguous runs of floats and memory is bounded at MaxHistoryFrames samples per pawn.
+ * A rewind steps the shot through the frames it was in flight for and tests each step against the union of every
+ * pawn's bounds at both ends of the step. Projectiles themselves are never replicated for this: the owning client
+ * reports its predicted hits, and the server checks them against the shot it accepted and this history.
+ * The history only holds pawns, so a hit that holds up is confirmed once a trace of the static world along the shot
+ * comes back clear.
+ * Only records outside standalone games, unless told to.
+ */
+UCLASS(config=Game, notplaceable)
+class AFTERCURFEW_API AAfterCurfewLagCompensation : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewLagCompensation();
+
+	/** Returns the lag compensation of this world, creating it on first use */
+	static AAfterCurfewLagCompensation* Get(UWorld* World);
+
+	// Begin Actor Interface
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+	// End Actor Interface
+
+	/** Starts recording Pawn's bounds */
+	void RegisterPawn(AAfterCurfewPawn* Pawn);
+
+	/** Stops recording Pawn, its slot is reused by the next pawn */
+	void UnregisterPawn(AAfterCurfewPawn* Pawn);
+
+	/** Turns recording on or off, on by default in networked games */
+	void SetRecording(bool bRecord);
+
+	FORCEINLINE bool IsRecording() const { return bRecording; }
+
+	/** Returns the server time the player of Controller saw the world at, now for anyone without a connection */
+	float GetClientViewTime(const AController* Controller) const;
+
+	/**
+	 * Rewinds Shot against every recorded pawn but IgnorePawn.
+	 * Returns true and the first pawn hit and when if it hits one.
+	 */
+	bool RewindShot(const FAfterCurfewRewindShot& Shot, const AAfterCurfewPawn* IgnorePawn, AAfterCurfewPawn*& OutPawn, float& OutHitTime) const;
+
+	/** Returns true and when if Shot could have hit Target while in flight */
+	bool ValidateHit(const FAfterCurfewRewindShot& Shot, const AAfterCurfewPawn* Target, float& OutHitTime) const;
+
+	/** Reports an accepted hit to everyone listening to OnHitConfirmed */
+	void ConfirmHit(AAfterCurfewPawn* Instigator, AAfterCurfewPawn* Target, const FVector& Location);
+
+	/** Confirms a hit that held up against the history once the static world between ShotOrigin and HitPoint is clear, rejects it otherwise */
+	void ConfirmHitIfUnobstructed(AAfterCurfewPawn* Instigator, AAfterCurfewPawn* Target, const FVector& Location, const FVector& ShotOrigin, const FVector& HitPoint);
+
+	/** Counts a hit a client reported that did not hold up */
+	void RejectHit();
+
+	/** Memory held by the history, in bytes */
+	FORCEINLINE int64 GetHistoryBytes() const { return int64(FrameTimes.Num() + CenterX.Num() * 6) * sizeof(float); }
+
+	/** Number of frames in the history */
+	FORCEINLINE int32 GetNumFrames() const { return NumFrames; }
+
+	/** Broadcast on the server for every hit on a pawn that was accepted */
+	FAfterCurfewHitConfirmed OnHitConfirmed;
+
+	/** Frames of history kept, rounded up to a power of two */
+	UPROPERTY(Category = LagCompensation, EditAnywhere, config, meta = (ClampMin = "2"))
+	int32 MaxHistoryFrames;
+
+	/** Farthest back a client's shot is rewound, in seconds */
+	UPROPERTY(Category = LagCompensation, EditAnywhere, config)
+	float MaxRewindTime;
+
+	/** How far behind the latest update clients display other pawns, in seconds */
+	UPROPERTY(Category = LagCompensation, EditAnywhere, config)
+	float ClientViewDelay;
+
+	/** Slack added around the recorded bounds, for quantized shot origins and client smoothing, in cm */
+	UPROPERTY(Category = LagCompensation, EditAnywhere, config)
+	float HitTolerance;
+
+private:
+	/** Hit waiting for the world trace along its shot */
+	struct FPendingHit
+	{
+		TWeakObjectPtr<AAfterCurfewPawn> Instigator;
+		TWeakObjectPtr<AAfterCurfewPawn> Target;
+		FVector Location;
+		FAfterCurfewTraceHandle WorldTrace;
+
+		FPendingHit()
+			: Location(FVector::ZeroVector)
+		{
+		}
+	};
+
+	/** Confirms the pending hits whose world trace came back clear and rejects the rest that are back */
+	void ResolvePendingHits();
+
+	/** Appends a frame with the bounds of every slot */
+	void SampleFrame(float Time);
+
+	/** Makes room for at least Count slots, moving the history to the new layout */
+	void GrowSlots(int32 Count);
+
+	/** Returns the ring index of the frame Age frames after the oldest */
+	FORCEINLINE int32 GetFrame(int32 Age) const { return (NewestFrame - NumFrames + 1 + Age) & (HistoryCapacity - 1); }
+
+	/**
+	 * Steps Shot through the history and tests it against the slots from FirstSlot to LastSlot.
+	 * Returns the slot hit first, or INDEX_NONE, and when it was hit.
+	 */
+	int32 Rewind(const FAfterCurfewRewindShot& Shot, int32 FirstSlot, int32 LastSlot, int32 IgnoreSlot, float& OutHitTime) const;
+
+	/** Recorded pawns by slot, stale entries are free slots */
+	TArray<TWeakObjectPtr<AAfterCurfewPawn>> SlotPawns;
+
+	TArray<int32> FreeSlots;
+
+	TMap<const AAfterCurfewPawn*, int32> PawnSlots;
+
+	/** Hits whose world trace is not back yet, oldest first */
+	TArray<FPendingHit> PendingHits;
+
+	/** Runs the world traces of pending hits */
+	TWeakObjectPtr<AAfterCurfewTraceService> TraceService;
+
+	/** Object type projectiles collide as, world traces only stop at what blocks it */
+	TEnumAsByte<ECollisionChannel> ProjectileChannel;
+
+	/** Server time of each frame */
+	TArray<float> FrameTimes;
+
+	/** Bounds of slot S in frame F at F * SlotCapacity + S, a negative extent marks an empty slot */
+	TArray<float> CenterX;
+	TArray<float> CenterY;
+	TArray<float> CenterZ;
+	TArray<float> ExtentX;
+	TArray<float> ExtentY;
+	TArray<float> ExtentZ;
+
+	/** Frames the ring has room for, a power of two */
+	int32 HistoryCapacity;
+
+	/** Slots each frame has room for */
+	int32 SlotCapacity;
+
+	/** Ring index of the latest frame */
+	int32 NewestFrame;
+
+	int32 NumFrames;
+
+	bool bRecording;
+};
@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewLog.h"
+#include "Misc/Crc.h"
+
+DEFINE_AFTERCURFEW_DEBUG_CATEGORY(Movement, false)
+DEFINE_AFTERCURFEW_DEBUG_CATEGORY(Aim, false)
+DEFINE_AFTERCURFEW_DEBUG_CATEGORY(Weapon, false)
+DEFINE_AFTERCURFEW_DEBUG_CATEGORY(Projectile, false)
+
+const float FAfterCurfewDebugCategory::ScreenMessageTime = 0.5f;
+
+FAfterCurfewDebugCategory::FAfterCurfewDebugCategory(const TCHAR* InName, bool bEnabledByDefault)
+	: Name(InName)
+	, bEnabled(bEnabledByDefault ? 1 : 0)
+	, EnabledCVar(*FString::Printf(TEXT("ac.Debug.%s"), InName), bEnabled, *FString::Printf(TEXT("Enables %s debug output from the AfterCurfew module."), InName), ECVF_Cheat)
+{
+}
+
+uint64 FAfterCurfewDebugCategory::MakeScreenKey(const ANSICHAR* File, int32 Line)
+{
+	// INDEX_NONE means "no key" to AddOnScreenDebugMessage, keep the high half non-zero so we never produce it
+	return (uint64(FCrc::StrCrc32(File) | 1u) << 32) | uint32(Line);
+}
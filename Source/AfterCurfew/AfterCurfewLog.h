@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+#include "Engine/Engine.h"
+#include "AfterCurfew.h"
+
+/**
+ * Debug output for the AfterCurfew module.
+ *
+ * AC_LOG(Category, Verbosity, TEXT("Format"), ...) logs to LogAfterCurfew.
+ * AC_SCREEN(Category, Color, TEXT("Format"), ...) shows an on-screen message keyed on its call site, so a message issued every frame updates in place.
+ * AC_SCREEN_KEYED(Category, Key, Color, TEXT("Format"), ...) does the same with an explicit key, e.g. one line per pawn.
+ *
+ * Each category can be switched at runtime with ac.Debug.<Category>, warnings and errors are always logged.
+ * AFTERCURFEW_DEBUG_VERBOSITY strips calls above it at compile time, Shipping and Test builds strip every call.
+ */
+
+#ifndef AFTERCURFEW_DEBUG
+	#define AFTERCURFEW_DEBUG !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+#endif
+
+#ifndef AFTERCURFEW_DEBUG_VERBOSITY
+	#define AFTERCURFEW_DEBUG_VERBOSITY VeryVerbose
+#endif
+
+/** A runtime switch for one kind of debug output */
+class AFTERCURFEW_API FAfterCurfewDebugCategory
+{
+public:
+	FAfterCurfewDebugCategory(const TCHAR* InName, bool bEnabledByDefault);
+
+	FORCEINLINE bool IsEnabled() const { return bEnabled != 0; }
+
+	FORCEINLINE const TCHAR* GetName() const { return Name; }
+
+	/** Builds an on-screen message key unique to a call site */
+	static uint64 MakeScreenKey(const ANSICHAR* File, int32 Line);
+
+	/** How long on-screen messages stay up after their last update */
+	static const float ScreenMessageTime;
+
+private:
+	const TCHAR* Name;
+
+	int32 bEnabled;
+
+	FAutoConsoleVariableRef EnabledCVar;
+};
+
+#define DECLARE_AFTERCURFEW_DEBUG_CATEGORY(CategoryName) extern AFTERCURFEW_API FAfterCurfewDebugCategory AfterCurfewDebug##CategoryName;
+#define DEFINE_AFTERCURFEW_DEBUG_CATEGORY(CategoryName, bEnabledByDefault) FAfterCurfewDebugCategory AfterCurfewDebug##CategoryName(TEXT(#CategoryName), bEnabledByDefault);
+
+DECLARE_AFTERCURFEW_DEBUG_CATEGORY(Movement)
+DECLARE_AFTERCURFEW_DEBUG_CATEGORY(Aim)
+DECLARE_AFTERCURFEW_DEBUG_CATEGORY(Weapon)
+DECLARE_AFTERCURFEW_DEBUG_CATEGORY(Projectile)
+
+#if AFTERCURFEW_DEBUG
+
+#define AFTERCURFEW_DEBUG_COMPILED(Verbosity) (ELogVerbosity::Verbosity <= ELogVerbosity::AFTERCURFEW_DEBUG_VERBOSITY)
+
+#define AC_LOG(CategoryName, Verbosity, Format, ...) \
+	do \
+	{ \
+		if (AFTERCURFEW_DEBUG_COMPILED(Verbosity) && (ELogVerbosity::Verbosity <= ELogVerbosity::Warning || AfterCurfewDebug##CategoryName.IsEnabled())) \
+		{ \
+			UE_LOG(LogAfterCurfew, Verbosity, TEXT("[%s] ") Format, AfterCurfewDebug##CategoryName.GetName(), ##__VA_ARGS__); \
+		} \
+	} while (0)
+
+#define AC_SCREEN_KEYED(CategoryName, Key, Color, Format, ...) \
+	do \
+	{ \
+		if (AFTERCURFEW_DEBUG_COMPILED(Display) && AfterCurfewDebug##CategoryName.IsEnabled() && GEngine != nullptr) \
+		{ \
+			GEngine->AddOnScreenDebugMessage((uint64)(Key), FAfterCurfewDebugCategory::ScreenMessageTime, Color, FString::Printf(Format, ##__VA_ARGS__)); \
+		} \
+	} while (0)
+
+#define AC_SCREEN(CategoryName, Color, Format, ...) \
+	do \
+	{ \
+		static const uint64 AC_ScreenKey = FAfterCurfewDebugCategory::MakeScreenKey(__FILE__, __LINE__); \
+		AC_SCREEN_KEYED(CategoryName, AC_ScreenKey, Color, Format, ##__VA_ARGS__); \
+	} while (0)
+
+#else
+
+#define AC_LOG(CategoryName, Verbosity, Format, ...) do { } while (0)
+#define AC_SCREEN_KEYED(CategoryName, Key, Color, Format, ...) do { } while (0)
+#define AC_SCREEN(CategoryName, Color, Format, ...) do { } while (0)
+
+#endif
@@ -0,0 +1,414 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewMovementComponent.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewLog.h"
+#include "GameFramework/Pawn.h"
+#include "Net/UnrealNetwork.h"
+
+DECLARE_CYCLE_STAT(TEXT("Pawn Movement"), STAT_AfterCurfewMovement, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Pawn Movement Integrate"), STAT_AfterCurfewMoveIntegrate, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Pawn Movement Sweep"), STAT_AfterCurfewMoveSweep, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Pawn Movement Proxy"), STAT_AfterCurfewMoveProxy, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pawn Move Sweeps"), STAT_AfterCurfewMoveSweeps, STATGROUP_AfterCurfew);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Pawn Move Time Dropped (ms)"), STAT_AfterCurfewMoveTimeDropped, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Server Moves Replayed"), STAT_AfterCurfewServerMoves, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Client Corrections"), STAT_AfterCurfewCorrections, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Server Moves Over Time Budget"), STAT_AfterCurfewMovesOverBudget, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Client Moves Replayed"), STAT_AfterCurfewClientReplays, STATGROUP_AfterCurfew);
+
+FAfterCurfewMoveParams::FAfterCurfewMoveParams()
+{
+	InterpSpeed = 2.f;
+	MaxSpeed = 1000.f;
+	MinSpeed = -1000.f;
+
+	YawInterpSpeed = 2.f;
+	MaxYawSpeed = 600.f;
+	MinYawSpeed = 0.f;
+
+	LiftInterpSpeed = 2.f;
+	MaxLiftSpeed = 1000.f;
+	MinLiftSpeed = -1000.f;
+}
+
+UAfterCurfewMovementComponent::UAfterCurfewMovementComponent()
+{
+	FixedTimeStep = 1.f / 120.f;
+	MaxStepsPerFrame = 8;
+	MaxClientError = 10.f;
+	MaxMoveTimeBudget = 0.5f;
+
+	TimeAccumulator = 0.f;
+	DesiredYaw = 0.f;
+	HeldMoveInput = FVector::ZeroVector;
+	LastSentMoveId = 0;
+	LastAckedMoveId = 0;
+	LastServerMoveId = 0;
+	ServerMoveTimeBudget = 0.f;
+	LastServerMoveTime = -1.f;
+	TickDelta = FVector::ZeroVector;
+	TickDeltaTime = 0.f;
+	bUpdatedByManager = false;
+
+	bReplicates = true;
+}
+
+void UAfterCurfewMovementComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME_CONDITION(UAfterCurfewMovementComponent, ProxyState, COND_SimulatedOnly);
+}
+
+bool UAfterCurfewMovementComponent::IsDrivenLocally() const
+{
+	if (PawnOwner == nullptr)
+	{
+		return false;
+	}
+
+	// The server drives the pawns no remote player controls, e.g. AI and benchmark pawns
+	return PawnOwner->IsLocallyControlled() || (PawnOwner->Role == ROLE_Authority && !PawnOwner->IsPlayerControlled());
+}
+
+FVector UAfterCurfewMovementComponent::Integrate(const FAfterCurfewMoveParams& Params, const FAfterCurfewMoveInput& Input, FAfterCurfewMoveState& State, float DeltaSeconds)
+{
+	// Planar input is at most unit length, so holding two axes no longer accelerates faster than one
+	const FVector TargetPlanarVelocity = FVector(Input.Direction.X, Input.Direction.Y, 0.f) * Params.MaxSpeed;
+	const FVector NewPlanarVelocity = FMath::VInterpTo(FVector(State.Velocity.X, State.Velocity.Y, 0.f), TargetPlanarVelocity, DeltaSeconds, Params.InterpSpeed);
+
+	State.Velocity.X = FMath::Clamp(NewPlanarVelocity.X, Params.MinSpeed, Params.MaxSpeed);
+	State.Velocity.Y = FMath::Clamp(NewPlanarVelocity.Y, Params.MinSpeed, Params.MaxSpeed);
+
+	const float TargetLiftSpeed = Input.Direction.Z * Params.MaxLiftSpeed;
+	const float NewLiftSpeed = FMath::FInterpTo(State.Velocity.Z, TargetLiftSpeed, DeltaSeconds, Params.LiftInterpSpeed);
+	State.Velocity.Z = FMath::Clamp(NewLiftSpeed, Params.MinLiftSpeed, Params.MaxLiftSpeed);
+
+	// Spin up while we are not facing the target, spin down once we are
+	const bool bHasYawInput = !FMath::IsNearlyEqual(State.Yaw, Input.DesiredYaw, 0.0001f);
+	const float YawTargetSpeed = bHasYawInput ? Params.MaxYawSpeed : 0.f;
+	const float YawNewSpeed = FMath::FInterpTo(State.YawSpeed, YawTargetSpeed, DeltaSeconds, Params.YawInterpSpeed);
+	State.YawSpeed = FMath::Clamp(YawNewSpeed, Params.MinYawSpeed, Params.MaxYawSpeed);
+	State.Yaw = FMath::FixedTurn(State.Yaw, Input.DesiredYaw, State.YawSpeed * DeltaSeconds);
+
+	return State.Velocity * DeltaSeconds;
+}
+
+FAfterCurfewMoveInput UAfterCurfewMovementComponent::ConsumeMoveInput()
+{
+	const FVector RawInput = HeldMoveInput + ConsumeInputVector();
+
+	FAfterCurfewMoveInput Input;
+	Input.Direction = FVector(RawInput.X, RawInput.Y, 0.f).GetClampedToMaxSize(1.f);
+	Input.Direction.Z = FMath::Clamp(RawInput.Z, -1.f, 1.f);
+	Input.DesiredYaw = DesiredYaw;
+
+	// Quantized to what ServerMove carries so the server replays exactly the move we predicted
+	Input.Direction = FVector(FMath::RoundToFloat(Input.Direction.X * 100.f), FMath::RoundToFloat(Input.Direction.Y * 100.f), FMath::RoundToFloat(Input.Direction.Z * 100.f)) / 100.f;
+	Input.DesiredYaw = FRotator::NormalizeAxis(FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(Input.DesiredYaw)));
+	return Input;
+}
+
+void UAfterCurfewMovementComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction *ThisTickFunction)
+{
+	if (ShouldSkipUpdate(DeltaTime))
+	{
+		return;
+	}
+
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewMovement);
+
+	if (BeginTickMove(DeltaTime))
+	{
+		IntegrateTickMove();
+		EndTickMove();
+	}
+}
+
+void UAfterCurfewMovementComponent::SetUpdatedByManager(bool bManaged)
+{
+	// Stop the tick from being re-registered behind the manager's back when the updated component changes
+	bUpdatedByManager = bManaged;
+	bAutoUpdateTickRegistration = !bManaged;
+	SetComponentTickEnabled(!bManaged);
+}
+
+bool UAfterCurfewMovementComponent::BeginTickMove(float DeltaTime)
+{
+	if (PawnOwner == nullptr || UpdatedComponent == nullptr)
+	{
+		return false;
+	}
+
+	if (PawnOwner->Role == ROLE_SimulatedProxy)
+	{
+		SimulateProxy(DeltaTime);
+		return false;
+	}
+
+	// A remote player's pawn only moves when its ServerMove arrives
+	if (!IsDrivenLocally())
+	{
+		ConsumeInputVector();
+		return false;
+	}
+
+	TickInput = ConsumeMoveInput();
+	TickDeltaTime = DeltaTime;
+	PrepareMove(DeltaTime);
+	return true;
+}
+
+void UAfterCurfewMovementComponent::IntegrateTickMove()
+{
+	TickDelta = IntegrateSteps(TickInput);
+}
+
+void UAfterCurfewMovementComponent::EndTickMove()
+{
+	FinishMove(TickDelta);
+
+	if (PawnOwner->Role == ROLE_AutonomousProxy)
+	{
+		SendMove(TickInput, TickDeltaTime);
+	}
+}
+
+void UAfterCurfewMovementComponent::PerformMove(const FAfterCurfewMoveInput& Input, float DeltaTime)
+{
+	PrepareMove(DeltaTime);
+	FinishMove(IntegrateSteps(Input));
+}
+
+void UAfterCurfewMovementComponent::PrepareMove(float DeltaTime)
+{
+	MoveState.Yaw = UpdatedComponent->GetComponentRotation().Yaw;
+
+	TimeAccumulator += DeltaTime;
+
+	// The pawn falls behind by whatever a long frame has past the step limit, so make that visible
+	const float MaxAccumulated = FixedTimeStep * MaxStepsPerFrame;
+	if (TimeAccumulator > MaxAccumulated)
+	{
+		const float DroppedTime = TimeAccumulator - MaxAccumulated;
+		TimeAccumulator = MaxAccumulated;
+
+		INC_FLOAT_STAT_BY(STAT_AfterCurfewMoveTimeDropped, DroppedTime * 1000.f);
+		GAfterCurfewCounters.MoveTimeDroppedUs += uint64(DroppedTime * 1000000.f);
+		AC_LOG(Movement, Log, TEXT("%s dropped %.1fms of movement past %d steps"), *GetNameSafe(PawnOwner), DroppedTime * 1000.f, MaxStepsPerFrame);
+	}
+}
+
+FVector UAfterCurfewMovementComponent::IntegrateSteps(const FAfterCurfewMoveInput& Input)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewMoveIntegrate);
+
+	FVector Delta = FVector::ZeroVector;
+	while (TimeAccumulator >= FixedTimeStep)
+	{
+		Delta += Integrate(MoveParams, Input, MoveState, FixedTimeStep);
+		TimeAccumulator -= FixedTimeStep;
+	}
+	return Delta;
+}
+
+void UAfterCurfewMovementComponent::FinishMove(const FVector& Delta)
+{
+	ApplyMove(Delta);
+
+	Velocity = MoveState.Velocity;
+	UpdateComponentVelocity();
+
+	if (PawnOwner->Role == ROLE_Authority)
+	{
+		ProxyState.Location = UpdatedComponent->GetComponentLocation();
+		ProxyState.Velocity = Velocity;
+		ProxyState.Yaw = FRotator::CompressAxisToShort(MoveState.Yaw);
+	}
+}
+
+void UAfterCurfewMovementComponent::SendMove(const FAfterCurfewMoveInput& Input, float DeltaTime)
+{
+	// A full buffer drops the oldest move, a correction for it can then only be applied without replaying it
+	FAfterCurfewSavedMove Move;
+	Move.MoveId = ++LastSentMoveId;
+	Move.Input = Input;
+	Move.DeltaTime = DeltaTime;
+	SavedMoves.Push(Move);
+
+	ServerMove(Move.MoveId, Input.Direction, FRotator::CompressAxisToShort(Input.DesiredYaw), DeltaTime, UpdatedComponent->GetComponentLocation());
+}
+
+bool UAfterCurfewMovementComponent::ServerMove_Validate(int32 MoveId, FVector_NetQuantize100 Direction, uint16 CompressedYaw, float DeltaTime, FVector_NetQuantize100 ClientLocation)
+{
+	// A hitch makes for a long move, the implementation clamps it rather than dropping the player
+	return FMath::IsFinite(DeltaTime) && FMath::Abs(Direction.X) <= 1.f && FMath::Abs(Direction.Y) <= 1.f && FMath::Abs(Direction.Z) <= 1.f;
+}
+
+void UAfterCurfewMovementComponent::ServerMove_Implementation(int32 MoveId, FVector_NetQuantize100 Direction, uint16 CompressedYaw, float DeltaTime, FVector_NetQuantize100 ClientLocation)
+{
+	// Moves are unreliable, one that arrives after a newer one is dropped
+	if (MoveId <= LastServerMoveId || PawnOwner == nullptr || UpdatedComponent == nullptr)
+	{
+		return;
+	}
+	LastServerMoveId = MoveId;
+
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewMovement);
+	INC_DWORD_STAT(STAT_AfterCurfewServerMoves);
+
+	// The client may only move for as long as it has been playing on the server, so a sped up clock gains nothing.
+	// Moves lost on the way leave budget behind, it is capped so it cannot be saved up for a burst later
+	const float Now = GetWorld()->GetTimeSeconds();
+	ServerMoveTimeBudget = LastServerMoveTime < 0.f ? MaxMoveTimeBudget : FMath::Min(ServerMoveTimeBudget + (Now - LastServerMoveTime), MaxMoveTimeBudget);
+	LastServerMoveTime = Now;
+
+	// Past the step limit the client dropped the time itself
+	const float ClaimedTime = FMath::Clamp(DeltaTime, 0.f, FixedTimeStep * MaxStepsPerFrame);
+	const float MoveTime = FMath::Min(ClaimedTime, ServerMoveTimeBudget);
+	if (MoveTime < ClaimedTime)
+	{
+		INC_DWORD_STAT(STAT_AfterCurfewMovesOverBudget);
+		AC_LOG(Movement, Verbose, TEXT("%s: move %d claimed %.3fs with %.3fs left"), *GetNameSafe(PawnOwner), MoveId, ClaimedTime, ServerMoveTimeBudget);
+	}
+	ServerMoveTimeBudget -= MoveTime;
+
+	FAfterCurfewMoveInput Input;
+	Input.Direction = Direction;
+	Input.DesiredYaw = FRotator::NormalizeAxis(FRotator::DecompressAxisFromShort(CompressedYaw));
+	PerformMove(Input, MoveTime);
+
+	const FVector ServerLocation = UpdatedComponent->GetComponentLocation();
+	if (FVector::DistSquared(ServerLocation, ClientLocation) > FMath::Square(MaxClientError))
+	{
+		INC_DWORD_STAT(STAT_AfterCurfewCorrections);
+		ClientAdjustPosition(MoveId, ServerLocation, MoveState.Velocity, MoveState.Yaw, MoveState.YawSpeed, TimeAccumulator);
+	}
+	else
+	{
+		ClientAckGoodMove(MoveId);
+	}
+}
+
+void UAfterCurfewMovementComponent::ClientAckGoodMove_Implementation(int32 MoveId)
+{
+	AcknowledgeMoves(MoveId);
+}
+
+void UAfterCurfewMovementComponent::ClientAdjustPosition_Implementation(int32 MoveId, FVector Location, FVector NewVelocity, float Yaw, float YawSpeed, float Accumulator)
+{
+	// A correction for a move older than one we already heard about is stale
+	if (MoveId <= LastAckedMoveId || UpdatedComponent == nullptr)
+	{
+		return;
+	}
+	AcknowledgeMoves(MoveId);
+
+	const FRotator CurrentRotation = UpdatedComponent->GetComponentRotation();
+	UpdatedComponent->SetWorldLocationAndRotation(Location, FRotator(CurrentRotation.Pitch, Yaw, CurrentRotation.Roll), false, nullptr, ETeleportType::TeleportPhysics);
+	MoveState.Velocity = NewVelocity;
+	MoveState.Yaw = Yaw;
+	MoveState.YawSpeed = YawSpeed;
+	TimeAccumulator = Accumulator;
+
+	// Reapply the moves the server has not processed yet on top of its state
+	for (int32 Index = 0; Index < SavedMoves.Num(); ++Index)
+	{
+		INC_DWORD_STAT(STAT_AfterCurfewClientReplays);
+		PerformMove(SavedMoves[Index].Input, SavedMoves[Index].DeltaTime);
+	}
+
+	AC_LOG(Movement, Verbose, TEXT("Corrected after move %d, replayed %d moves"), MoveId, SavedMoves.Num());
+}
+
+void UAfterCurfewMovementComponent::AcknowledgeMoves(int32 MoveId)
+{
+	LastAckedMoveId = FMath::Max(LastAckedMoveId, MoveId);
+
+	int32 NumAcked = 0;
+	while (NumAcked < SavedMoves.Num() && SavedMoves[NumAcked].MoveId <= MoveId)
+	{
+		++NumAcked;
+	}
+	SavedMoves.PopOldest(NumAcked);
+}
+
+void UAfterCurfewMovementComponent::OnRep_ProxyState()
+{
+	if (UpdatedComponent == nullptr)
+	{
+		return;
+	}
+
+	const FRotator CurrentRotation = UpdatedComponent->GetComponentRotation();
+	const FRotator NewRotation(CurrentRotation.Pitch, FRotator::DecompressAxisFromShort(ProxyState.Yaw), CurrentRotation.Roll);
+	UpdatedComponent->SetWorldLocationAndRotation(ProxyState.Location, NewRotation, false, nullptr, ETeleportType::TeleportPhysics);
+
+	Velocity = ProxyState.Velocity;
+	UpdateComponentVelocity();
+}
+
+void UAfterCurfewMovementComponent::SimulateProxy(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewMoveProxy);
+
+	// Carry on along the last replicated velocity until the next update, without sweeping
+	if (!Velocity.IsNearlyZero())
+	{
+		UpdatedComponent->MoveComponent(Velocity * DeltaTime, UpdatedComponent->GetComponentQuat(), false);
+	}
+}
+
+void UAfterCurfewMovementComponent::ApplyMove(const FVector& Delta)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewMoveSweep);
+
+	const FRotator CurrentRotation = UpdatedComponent->GetComponentRotation();
+	const FRotator NewRotation(CurrentRotation.Pitch, MoveState.Yaw, CurrentRotation.Roll);
+
+	// If no movement, still turn to face the aim direction
+	if (Delta.IsNearlyZero())
+	{
+		UpdatedComponent->SetWorldRotation(NewRotation);
+		return;
+	}
+
+	INC_DWORD_STAT(STAT_AfterCurfewMoveSweeps);
+	++GAfterCurfewCounters.MoveSweeps;
+
+	FHitResult Hit(1.f);
+	SafeMoveUpdatedComponent(Delta, NewRotation, true, Hit);
+
+	if (Hit.IsValidBlockingHit())
+	{
+		INC_DWORD_STAT(STAT_AfterCurfewMoveSweeps);
+		++GAfterCurfewCounters.MoveSweeps;
+		SlideAlongSurface(Delta, 1.f - Hit.Time, Hit.Normal, Hit, true);
+	}
+}
+
+void UAfterCurfewMovementComponent::RestoreMoveState(const FAfterCurfewMoveState& State, float NewDesiredYaw, float Accumulator)
+{
+	MoveState = State;
+	DesiredYaw = NewDesiredYaw;
+	TimeAccumulator = Accumulator;
+	SavedMoves.Reset();
+
+	Velocity = MoveState.Velocity;
+	UpdateComponentVelocity();
+}
+
+void UAfterCurfewMovementComponent::StopMovementImmediately()
+{
+	Super::StopMovementImmediately();
+
+	MoveState.Velocity = FVector::ZeroVector;
+	MoveState.YawSpeed = 0.f;
+	TimeAccumulator = 0.f;
+	HeldMoveInput = FVector::ZeroVector;
+	SavedMoves.Reset();
+}
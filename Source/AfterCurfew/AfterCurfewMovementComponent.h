@@ -0,0 +1,300 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/PawnMovementComponent.h"
+#include "Engine/NetSerialization.h"
+#include "AfterCurfewRingBuffer.h"
+#include "AfterCurfewMovementComponent.generated.h"
+
+/** Movement tuning, shared by every integration step */
+USTRUCT()
+struct FAfterCurfewMoveParams
+{
+	GENERATED_BODY()
+
+	/** How quickly speed changes */
+	UPROPERTY(Category = "Planar", EditAnywhere)
+	float InterpSpeed;
+
+	/** Max speed */
+	UPROPERTY(Category = "Planar", EditAnywhere)
+	float MaxSpeed;
+
+	/** Min speed */
+	UPROPERTY(Category = "Planar", EditAnywhere)
+	float MinSpeed;
+
+	/** How quickly speed changes */
+	UPROPERTY(Category = "Turning", EditAnywhere)
+	float YawInterpSpeed;
+
+	/** Max speed */
+	UPROPERTY(Category = "Turning", EditAnywhere)
+	float MaxYawSpeed;
+
+	/** Min speed */
+	UPROPERTY(Category = "Turning", EditAnywhere)
+	float MinYawSpeed;
+
+	/** How quickly lift speed changes */
+	UPROPERTY(Category = "Lift", EditAnywhere)
+	float LiftInterpSpeed;
+
+	/** Max lift speed */
+	UPROPERTY(Category = "Lift", EditAnywhere)
+	float MaxLiftSpeed;
+
+	/** Min lift speed */
+	UPROPERTY(Category = "Lift", EditAnywhere)
+	float MinLiftSpeed;
+
+	FAfterCurfewMoveParams();
+};
+
+/** Integrated movement state of one pawn */
+struct FAfterCurfewMoveState
+{
+	/** World velocity, X forward, Y right and Z lift */
+	FVector Velocity;
+
+	/** Current facing */
+	float Yaw;
+
+	/** Current turning speed */
+	float YawSpeed;
+
+	FAfterCurfewMoveState()
+		: Velocity(FVector::ZeroVector)
+		, Yaw(0.f)
+		, YawSpeed(0.f)
+	{
+	}
+};
+
+/** Input held for an integration step */
+struct FAfterCurfewMoveInput
+{
+	/** Planar input in XY, at most unit length, lift input in Z */
+	FVector Direction;
+
+	/** Yaw to turn towards */
+	float DesiredYaw;
+
+	FAfterCurfewMoveInput()
+		: Direction(FVector::ZeroVector)
+		, DesiredYaw(0.f)
+	{
+	}
+};
+
+/** Move the owning client made and the server has not acknowledged yet */
+struct FAfterCurfewSavedMove
+{
+	int32 MoveId;
+	FAfterCurfewMoveInput Input;
+	float DeltaTime;
+
+	FAfterCurfewSavedMove()
+		: MoveId(0)
+		, DeltaTime(0.f)
+	{
+	}
+};
+
+/** Authoritative movement replicated to simulated proxies */
+USTRUCT()
+struct FAfterCurfewProxyMoveState
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector_NetQuantize10 Location;
+
+	UPROPERTY()
+	FVector_NetQuantize10 Velocity;
+
+	/** Yaw compressed with FRotator::CompressAxisToShort */
+	UPROPERTY()
+	uint16 Yaw;
+
+	FAfterCurfewProxyMoveState()
+		: Location(FVector::ZeroVector)
+		, Velocity(FVector::ZeroVector)
+		, Yaw(0)
+	{
+	}
+};
+
+/**
+ * Moves an AfterCurfew pawn.
+ * Input is accumulated over the frame and integrated at a fixed time step so speeds, turning and the distance travelled
+ * do not depend on the frame rate. The whole frame's displacement is then applied with a single sweep that slides along what it hits.
+ *
+ * Movement is server authoritative. The owning client predicts its moves, keeps them until the server acknowledges them
+ * and sends each one to the server, which replays it and either acknowledges it or corrects the client. A corrected
+ * client snaps to the server's state and replays the moves the server has not seen yet. Other clients only receive
+ * the server's location and velocity and extrapolate between updates.
+ */
+UCLASS(ClassGroup = (AfterCurfew), meta = (BlueprintSpawnableComponent))
+class AFTERCURFEW_API UAfterCurfewMovementComponent : public UPawnMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	UAfterCurfewMovementComponent();
+
+	// Begin ActorComponent Interface
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction *ThisTickFunction) override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	// End ActorComponent Interface
+
+	// Begin MovementComponent Interface
+	virtual float GetMaxSpeed() const override { return MoveParams.MaxSpeed; }
+	virtual void StopMovementImmediately() override;
+	// End MovementComponent Interface
+
+	/** Returns true if this machine produces the pawn's input: the local player, or the server for pawns no remote player controls */
+	bool IsDrivenLocally() const;
+
+	/** Sets the yaw the pawn turns towards */
+	void SetDesiredYaw(float Yaw) { DesiredYaw = Yaw; }
+
+	/** Sets the move input applied every movement frame until the next call, so an owner ticking less often still moves smoothly */
+	void SetMoveInput(const FVector& Input) { HeldMoveInput = Input; }
+
+	/** Returns the integrated movement state */
+	FORCEINLINE const FAfterCurfewMoveState& GetMoveState() const { return MoveState; }
+
+	FORCEINLINE float GetDesiredYaw() const { return DesiredYaw; }
+
+	/** Returns the frame time not yet covered by an integration step */
+	FORCEINLINE float GetTimeAccumulator() const { return TimeAccumulator; }
+
+	/** Puts the movement back in a saved state, dropping the moves not acknowledged yet */
+	void RestoreMoveState(const FAfterCurfewMoveState& State, float NewDesiredYaw, float Accumulator);
+
+	/** Advances State by one step of DeltaSeconds and returns the distance travelled */
+	static FVector Integrate(const FAfterCurfewMoveParams& Params, const FAfterCurfewMoveInput& Input, FAfterCurfewMoveState& State, float DeltaSeconds);
+
+	/** Hands our update to the pawn update manager, which then runs the tick phases below instead of our own tick */
+	void SetUpdatedByManager(bool bManaged);
+
+	/** Returns true while the pawn update manager moves us */
+	FORCEINLINE bool IsUpdatedByManager() const { return bUpdatedByManager; }
+
+	/**
+	 * Starts this frame's move on the game thread: consumes the input and advances the time accumulator.
+	 * Proxies and remote players' pawns are fully handled here. Returns true if the move still needs integrating.
+	 */
+	bool BeginTickMove(float DeltaTime);
+
+	/** Integrates the move started by BeginTickMove, only touches our own movement state so it may run on any thread */
+	void IntegrateTickMove();
+
+	/** Applies the integrated move on the game thread, sweeping the pawn and sending the move to the server */
+	void EndTickMove();
+
+	/** Movement tuning */
+	UPROPERTY(Category = "Gameplay\|Movement", EditAnywhere)
+	FAfterCurfewMoveParams MoveParams;
+
+	/** Length of one integration step */
+	UPROPERTY(Category = "Gameplay\|Movement", EditAnywhere, meta = (ClampMin = "0.001"))
+	float FixedTimeStep;
+
+	/** Most integration steps run in a single frame, time past this is dropped so a long frame cannot spiral, and counted in GAfterCurfewCounters */
+	UPROPERTY(Category = "Gameplay\|Movement", EditAnywhere, meta = (ClampMin = "1"))
+	int32 MaxStepsPerFrame;
+
+	/** How far, in cm, a client's location may drift from the server's before it is corrected */
+	UPROPERTY(Category = "Gameplay\|Movement", EditAnywhere, meta = (ClampMin = "0"))
+	float MaxClientError;
+
+	/** Most server time, in seconds, a client's moves may fall behind and later catch up on, time claimed past it is not moved */
+	UPROPERTY(Category = "Gameplay\|Movement", EditAnywhere, meta = (ClampMin = "0"))
+	float MaxMoveTimeBudget;
+
+private:
+	/** Integrates Input over DeltaTime and sweeps the updated component */
+	void PerformMove(const FAfterCurfewMoveInput& Input, float DeltaTime);
+
+	/** Reads the current facing and adds DeltaTime to the time accumulator */
+	void PrepareMove(float DeltaTime);
+
+	/** Runs every whole integration step in the time accumulator and returns the distance travelled */
+	FVector IntegrateSteps(const FAfterCurfewMoveInput& Input);
+
+	/** Sweeps the updated component by Delta and publishes the new velocity and proxy state */
+	void FinishMove(const FVector& Delta);
+
+	/** Saves a predicted move and sends it to the server */
+	void SendMove(const FAfterCurfewMoveInput& Input, float DeltaTime);
+
+	/** Extrapolates a simulated proxy from the last replicated state */
+	void SimulateProxy(float DeltaTime);
+
+	/** Replays a client's move on the server */
+	UFUNCTION(Unreliable, Server, WithValidation)
+	void ServerMove(int32 MoveId, FVector_NetQuantize100 Direction, uint16 CompressedYaw, float DeltaTime, FVector_NetQuantize100 ClientLocation);
+
+	/** Tells the client its moves up to MoveId matched the server */
+	UFUNCTION(Unreliable, Client)
+	void ClientAckGoodMove(int32 MoveId);
+
+	/** Tells the client where the server ended up after MoveId */
+	UFUNCTION(Unreliable, Client)
+	void ClientAdjustPosition(int32 MoveId, FVector Location, FVector NewVelocity, float Yaw, float YawSpeed, float Accumulator);
+
+	UFUNCTION()
+	void OnRep_ProxyState();
+
+	/** Drops saved moves the server has processed */
+	void AcknowledgeMoves(int32 MoveId);
+
+	UPROPERTY(ReplicatedUsing = OnRep_ProxyState)
+	FAfterCurfewProxyMoveState ProxyState;
+
+	/** Turns the input accumulated this frame into an integration input */
+	FAfterCurfewMoveInput ConsumeMoveInput();
+
+	/** Sweeps the updated component by Delta and slides along whatever blocks it */
+	void ApplyMove(const FVector& Delta);
+
+	FAfterCurfewMoveState MoveState;
+
+	/** Frame time not yet covered by an integration step */
+	float TimeAccumulator;
+
+	float DesiredYaw;
+
+	/** Move input of the owner's last tick, added to whatever input was added this frame */
+	FVector HeldMoveInput;
+
+	/** Input, frame time and result of the move between BeginTickMove and EndTickMove */
+	FAfterCurfewMoveInput TickInput;
+	float TickDeltaTime;
+	FVector TickDelta;
+
+	/** Flag set while the pawn update manager runs our tick phases */
+	uint32 bUpdatedByManager : 1;
+
+	/** Moves predicted by the owning client and not acknowledged yet, oldest first */
+	TAfterCurfewRingBuffer<FAfterCurfewSavedMove, 128> SavedMoves;
+
+	/** Id of the last move the client sent */
+	int32 LastSentMoveId;
+
+	/** Id of the last move the client heard back about */
+	int32 LastAckedMoveId;
+
+	/** Id of the last move the server replayed, older moves arriving late are dropped */
+	int32 LastServerMoveId;
+
+	/** Server time passed that the client's moves have not claimed yet, on the server */
+	float ServerMoveTimeBudget;
+
+	/** World time the server replayed the client's last move at, below zero before the first */
+	float LastServerMoveTime;
+};
@@ -1,21 +1,31 @@
 // Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
 
 #include "AfterCurfewPawn.h"
-#include "AfterCurfewProjectile.h"
-#include "TimerManager.h"
-#include "UObject/ConstructorHelpers.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewAIController.h"
+#include "AfterCurfewAimComponent.h"
+#include "AfterCurfewFireAudioComponent.h"
+#include "AfterCurfewLagCompensation.h"
+#include "AfterCurfewMovementComponent.h"
+#include "AfterCurfewPawnUpdateManager.h"
+#include "AfterCurfewReplayComponent.h"
+#include "AfterCurfewWeaponComponent.h"
+#include "AfterCurfewGameMode.h"
+#include "AfterCurfewSignificanceManager.h"
 #include "Camera/CameraComponent.h"
 #include "Components/StaticMeshComponent.h"
 #include "Components/InputComponent.h"
 #include "GameFramework/SpringArmComponent.h"
 #include "GameFramework/PlayerController.h"
+#include "Engine/AssetManager.h"
 #include "Engine/CollisionProfile.h"
 #include "Engine/StaticMesh.h"
 #include "Kismet/GameplayStatics.h"
-#include "Sound/SoundBase.h"
 #include "Engine/GameEngine.h"
-#include "Engine/Public/DrawDebugHelpers.h"
-#include "Macros.h"
+#include "AfterCurfewLog.h"
+
+DECLARE_CYCLE_STAT(TEXT("Pawn Tick"), STAT_AfterCurfewPawnTick, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Pawn Input Command"), STAT_AfterCurfewPawnInput, STATGROUP_AfterCurfew);
 
 const FName AAfterCurfewPawn::MoveForwardBinding("MoveForward");
 const FName AAfterCurfewPawn::MoveRightBinding("MoveRight");
@@ -27,16 +37,11 @@ const FName AAfterCurfewPawn::FireBinding("Fire");
 
 AAfterCurfewPawn::AAfterCurfewPawn()
 {
-	static ConstructorHelpers::FObjectFinder<UStaticMesh> ShipMesh(TEXT("/Game/TwinStick/Meshes/TwinStickUFO.TwinStickUFO"));
-	// Create the mesh component
+	// Create the mesh component, the mesh itself is set once it is loaded
 	ShipMeshComponent = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("ShipMesh"));
 	RootComponent = ShipMeshComponent;
 	ShipMeshComponent->SetCollisionProfileName(UCollisionProfile::Pawn_ProfileName);
-	ShipMeshComponent->SetStaticMesh(ShipMesh.Object);
-
-	// Cache our sound effect
-	static ConstructorHelpers::FObjectFinder<USoundBase> FireAudio(TEXT("/Game/TwinStick/Audio/TwinStickFire.TwinStickFire"));
-	FireSound = FireAudio.Object;
+	ShipMesh = TSoftObjectPtr<UStaticMesh>(FSoftObjectPath(TEXT("/Game/TwinStick/Meshes/TwinStickUFO.TwinStickUFO")));
 
 	// Create a camera boom...
 	CameraBoom = CreateDefaultSubobject<USpringArmComponent>(TEXT("CameraBoom"));
@@ -51,39 +56,31 @@ AAfterCurfewPawn::AAfterCurfewPawn()
 	CameraComponent->SetupAttachment(CameraBoom, USpringArmComponent::SocketName);
 	CameraComponent->bUsePawnControlRotation = false;	// Camera does not rotate relative to arm
 
-	// Movement
-	//MoveSpeed = 1000.0f;
-
-	/*ThrustInterpSpeed = 2.f;
-	ThrustMaxSpeed = 1000.f;
-	ThrustMinSpeed = 0.f;
-	CurrentThrustSpeed = 0.f;*/
-
-	InterpSpeed = 2.f;
-	MaxSpeed = 1000.f;
-	MinSpeed = -1000.f;
-	CurrForwardSpeed = 0.f;
-	CurrRightSpeed = 0.f;
-
-	YawInterpSpeed = 2.f;
-	MaxYawSpeed = 600.f;
-	MinYawSpeed = 0.f;
-	CurrYawSpeed = 0.f;
-
-	LiftInterpSpeed = 2.f;
-	MaxLiftSpeed = 1000.f;
-	MinLiftSpeed = -1000.f;
-	CurrentLiftSpeed = 0.f;
-
-	// Weapons
-	GunOffset = FVector(90.f, 0.f, 0.f);
-	FireRate = 0.1f;
-	FireSpread = 2.5f;
-	ProjectileScale = 1.f;
-	ProjectileInitialSpeed = 3000.f;
-	ProjectileMaxSpeed = 3000.f;
-	bCanFire = true;
+	// Create the aim resolver...
+	AimComponent = CreateDefaultSubobject<UAfterCurfewAimComponent>(TEXT("Aim"));
+
+	// Create the weapon...
+	WeaponComponent = CreateDefaultSubobject<UAfterCurfewWeaponComponent>(TEXT("Weapon"));
+
+	// Create the fire sound voicing...
+	FireAudioComponent = CreateDefaultSubobject<UAfterCurfewFireAudioComponent>(TEXT("FireAudio"));
+
+	// Create the input recorder...
+	ReplayComponent = CreateDefaultSubobject<UAfterCurfewReplayComponent>(TEXT("Replay"));
+
+	// Create the movement component...
+	MovementComponent = CreateDefaultSubobject<UAfterCurfewMovementComponent>(TEXT("Movement"));
+	MovementComponent->UpdatedComponent = ShipMeshComponent;
+
 	bFire = false;
+	PendingMoveInput = FVector::ZeroVector;
+
+	// Without a player we are driven by the steering manager through an AI controller
+	AIControllerClass = AAfterCurfewAIController::StaticClass();
+
+	// The movement component replicates our movement and the weapon sends shots, nothing else needs replicating
+	bReplicates = true;
+	bReplicateMovement = false;
 }
 
 void AAfterCurfewPawn::SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent)
@@ -118,244 +115,214 @@ void AAfterCurfewPawn::SetupPlayerInputComponent(class UInputComponent* PlayerIn
 	// Clamp between MinSpeed and MaxSpeed
 	CurrentThrustSpeed = FMath::Clamp(NewThrustSpeed, ThrustMinSpeed, ThrustMaxSpeed);
 
-	//DEBUGMESSAGE("Thrust: Val: %f, Target: %f, Current: %f", FColor::Red, Val, TargetThrustSpeed, CurrentThrustSpeed);
+	//AC_SCREEN(Movement, FColor::Red, TEXT("Thrust: Val: %f, Target: %f, Current: %f"), Val, TargetThrustSpeed, CurrentThrustSpeed);
 }*/
 
 void AAfterCurfewPawn::MoveForwardInput(float Val)
 {
-	// Is there any input?
-	bool bHasInput = !FMath::IsNearlyEqual(Val, 0.f);
-
-	// Determing target speed based on input
-	float TargetForwardSpeed = bHasInput ? Val * MaxSpeed : 0.f;
-
-	// Calculate new speed
-	float NewForwardSpeed = FMath::FInterpTo(CurrForwardSpeed, TargetForwardSpeed, GetWorld()->GetDeltaSeconds(), InterpSpeed);
-
-	// Clamp between MinSpeed and MaxSpeed
-	CurrForwardSpeed = FMath::Clamp(NewForwardSpeed, MinSpeed, MaxSpeed);
+	PendingMoveInput.X = Val;
 }
 
 void AAfterCurfewPawn::MoveRightInput(float Val)
 {
-	// Is there any input?
-	bool bHasInput = !FMath::IsNearlyEqual(Val, 0.f);
-
-	// Determing target speed based on input
-	float TargetRightSpeed = bHasInput ? Val * MaxSpeed : 0.f;
-
-	// Calculate new speed
-	float NewRightSpeed = FMath::FInterpTo(CurrRightSpeed, TargetRightSpeed, GetWorld()->GetDeltaSeconds(), InterpSpeed);
-
-	// Clamp between MinSpeed and MaxSpeed
-	CurrRightSpeed = FMath::Clamp(NewRightSpeed, MinSpeed, MaxSpeed);
+	PendingMoveInput.Y = Val;
 }
 
 void AAfterCurfewPawn::LiftUpInput(float Val)
-{	
-	// Is there any input?
-	bool bHasInput = !FMath::IsNearlyEqual(Val, 0.f);
-
-	// Determing target speed based on input
-	float TargetLiftSpeed = bHasInput ? Val * MaxLiftSpeed : 0.f;
-	
-	// Calculate new speed
-	float NewLiftSpeed = FMath::FInterpTo(CurrentLiftSpeed, TargetLiftSpeed, GetWorld()->GetDeltaSeconds(), LiftInterpSpeed);
-
-	// Clamp between MinSpeed and MaxSpeed
-	CurrentLiftSpeed = FMath::Clamp(NewLiftSpeed, MinLiftSpeed, MaxLiftSpeed);
-}
-
-void AAfterCurfewPawn::StartFiring()
 {
-	bFire = 1;
+	PendingMoveInput.Z = Val;
 }
 
-void AAfterCurfewPawn::StopFiring()
+UPawnMovementComponent* AAfterCurfewPawn::GetMovementComponent() const
 {
-	bFire = 0;
+	return MovementComponent;
 }
 
-void AAfterCurfewPawn::Tick(float DeltaSeconds)
+void AAfterCurfewPawn::PreRegisterAllComponents()
 {
-	//TODO: bounds objects created and placed via code?
+	Super::PreRegisterAllComponents();
 
-	//TODO: add some recoil on firing shots?
-	//TODO: support better controller version of aiming in addition to the mouse.
-	//TODO: add a custom cursor sprite instead of the default crosshair.
-	//TODO: Add minor ship rotations to Pitch / Roll on heavy turns to improve the feeling of weight.
-
-	APlayerController * Controller = UGameplayStatics::GetPlayerController(GetWorld(), 0);
-
-	FVector CurrentLocation = this->GetActorLocation();
-
-	FHitResult TraceHitResult;
-	Controller->GetHitResultUnderCursor(ECC_Camera, true, TraceHitResult);
-	DrawDebugLine(GetWorld(), CurrentLocation, TraceHitResult.Location, FColor::Red, false);
-
-	// Get the aiming direction for the player
-	FVector AimLocation = TraceHitResult.Location;
-	FVector AimDirection = AimLocation - CurrentLocation;
-	AimDirection.Normalize();
+	// Set before the mesh component registers so its physics state is only created once. The game mode holds the first
+	// pawns until the mesh is in, clients may still spawn us before it loads, then LoadShipMesh sets it on begin play
+	UStaticMesh* Mesh = ShipMesh.Get();
+	if (Mesh == nullptr && GetWorld() != nullptr && !GetWorld()->IsGameWorld())
+	{
+		// Nothing preloads for the editor's viewports
+		Mesh = ShipMesh.LoadSynchronous();
+	}
+	if (Mesh != nullptr && ShipMeshComponent->GetStaticMesh() == nullptr)
+	{
+		ShipMeshComponent->SetStaticMesh(Mesh);
+	}
+}
 
-	// Get the player's current rotation
-	FRotator CurrentRotation = this->GetActorRotation();
+void AAfterCurfewPawn::LoadShipMesh()
+{
+	if (ShipMeshComponent->GetStaticMesh() != nullptr || ShipMesh.IsNull())
+	{
+		return;
+	}
 
-	// Determine target rotation based on input
-	FRotator TargetRotation = AimDirection.Rotation();
+	if (UStaticMesh* Mesh = ShipMesh.Get())
+	{
+		ShipMeshComponent->SetStaticMesh(Mesh);
+		return;
+	}
 
-	// Turn to face the target rotation by a turn speed amount
+	// Clients have no game mode preloading for them
+	ShipMeshHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(ShipMesh.ToSoftObjectPath(), FStreamableDelegate::CreateUObject(this, &AAfterCurfewPawn::OnShipMeshLoaded), FStreamableManager::AsyncLoadHighPriority);
+}
 
-	//DEBUGMESSAGE("Current: %f, Target: %f", FColor::White, CurrentRotation.Yaw, TargetRotation.Yaw);
+void AAfterCurfewPawn::OnShipMeshLoaded()
+{
+	ShipMeshHandle.Reset();
 
-	/*bool bHasInput = !FMath::IsNearlyEqual(Val, 0.f);
+	if (UStaticMesh* Mesh = ShipMesh.Get())
+	{
+		ShipMeshComponent->SetStaticMesh(Mesh);
+	}
+}
 
-	// Determing target speed based on input
-	float TargetThrustSpeed = bHasInput ? Val * ThrustMaxSpeed : 0.f;
+void AAfterCurfewPawn::BeginPlay()
+{
+	Super::BeginPlay();
 
-	// Calculate new speed
-	float NewThrustSpeed = FMath::FInterpTo(CurrentThrustSpeed, TargetThrustSpeed, GetWorld()->GetDeltaSeconds(), ThrustInterpSpeed);
+	LoadShipMesh();
 
-	// Clamp between MinSpeed and MaxSpeed
-	CurrentThrustSpeed = FMath::Clamp(NewThrustSpeed, ThrustMinSpeed, ThrustMaxSpeed);*/
+	// Aim is resolved in our tick, make sure movement sees this frame's desired yaw
+	MovementComponent->AddTickPrerequisiteActor(this);
 
-	bool bHasYawInput = !FMath::IsNearlyEqual(CurrentRotation.Yaw, TargetRotation.Yaw, 0.0001f);
+	// Only the authority hands out seeds, the weapon replicates its seed to the owning client, which predicts our shots
+	AAfterCurfewGameMode* GameMode = GetWorld()->GetAuthGameMode<AAfterCurfewGameMode>();
+	if (GameMode != nullptr)
+	{
+		WeaponComponent->SetWeaponSeed(GameMode->MakePawnSeed());
+	}
 
-	float YawTargetSpeed = bHasYawInput ? MaxYawSpeed : 0.f;
+	SignificanceManager = AAfterCurfewSignificanceManager::Get(GetWorld());
+	if (SignificanceManager.IsValid())
+	{
+		SignificanceManager->RegisterPawn(this);
+	}
 
-	float YawNewSpeed = FMath::FInterpTo(CurrYawSpeed, YawTargetSpeed, GetWorld()->GetDeltaSeconds(), YawInterpSpeed);
+	// Our moves are integrated together with every other pawn's
+	PawnUpdateManager = AAfterCurfewPawnUpdateManager::Get(GetWorld());
+	if (PawnUpdateManager.IsValid())
+	{
+		PawnUpdateManager->RegisterPawn(this);
+	}
 
-	CurrYawSpeed = FMath::Clamp(YawNewSpeed, MinYawSpeed, MaxYawSpeed);
+	// Hits on us are checked against where we were when the shot was fired
+	if (HasAuthority())
+	{
+		LagCompensation = AAfterCurfewLagCompensation::Get(GetWorld());
+		if (LagCompensation.IsValid())
+		{
+			LagCompensation->RegisterPawn(this);
+		}
+	}
+}
 
-	//DEBUGMESSAGE("CurrYawSpeed: %f", FColor::White, CurrYawSpeed);
+void AAfterCurfewPawn::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (ShipMeshHandle.IsValid())
+	{
+		ShipMeshHandle->CancelHandle();
+		ShipMeshHandle.Reset();
+	}
+	if (SignificanceManager.IsValid())
+	{
+		SignificanceManager->UnregisterPawn(this);
+	}
+	if (PawnUpdateManager.IsValid())
+	{
+		PawnUpdateManager->UnregisterPawn(this);
+	}
+	if (LagCompensation.IsValid())
+	{
+		LagCompensation->UnregisterPawn(this);
+	}
 
-	float NewYaw = FMath::FixedTurn(CurrentRotation.Yaw, TargetRotation.Yaw, CurrYawSpeed * DeltaSeconds);
-	//float NewYaw = FMath::FInterpTo(CurrentRotation.Yaw, TargetRotation.Yaw, GetWorld()->GetDeltaSeconds(), 4.f);
+	Super::EndPlay(EndPlayReason);
+}
 
-	const FRotator NewRotation = FRotator(CurrentRotation.Pitch, NewYaw, CurrentRotation.Roll);
+void AAfterCurfewPawn::SetSignificance(float TickInterval, bool bCosmetics)
+{
+	// Movement keeps ticking every frame and holds the move input of our last tick until the next one
+	SetActorTickInterval(TickInterval);
+	WeaponComponent->SetComponentTickInterval(TickInterval);
+	WeaponComponent->SetCosmeticsEnabled(bCosmetics);
+	AimComponent->SetCosmeticsEnabled(bCosmetics);
+}
 
-	// Calculate change in rotation this frame
-	/*FRotator DeltaRotation(0, 0, 0);
-	DeltaRotation.Pitch = 0.f;//CurrentPitchSpeed * DeltaSeconds;
-	DeltaRotation.Yaw = CurrentYawSpeed * DeltaSeconds;
-	DeltaRotation.Roll = 0.f;//CurrentRollSpeed * DeltaSeconds;*/
+void AAfterCurfewPawn::StartFiring()
+{
+	bFire = 1;
+}
 
-	// Rotate plane
-	//AddActorLocalRotation(DeltaRotation);
+void AAfterCurfewPawn::StopFiring()
+{
+	bFire = 0;
+}
 
-	//TODO: This has a problem where holding input buttons on more than 1 axis produces faster acceleration, how to fix?
-	const FVector XYMovement = FVector(CurrForwardSpeed * DeltaSeconds, CurrRightSpeed * DeltaSeconds, 0.f).GetClampedToMaxSize(MaxSpeed * DeltaSeconds);
+void AAfterCurfewPawn::SetMoveIntent(const FVector& MoveInput)
+{
+	PendingMoveInput = MoveInput;
+}
 
-	// If non-zero size, move this actor
-	if (XYMovement.SizeSquared() > 0.0f)
-	{
-		FHitResult Hit(1.f);
+void AAfterCurfewPawn::Tick(float DeltaSeconds)
+{
+	//TODO: bounds objects created and placed via code?
 
-		RootComponent->MoveComponent(XYMovement, NewRotation, true, &Hit);
+	//TODO: add some recoil on firing shots?
+	//TODO: support better controller version of aiming in addition to the mouse.
+	//TODO: add a custom cursor sprite instead of the default crosshair.
+	//TODO: Add minor ship rotations to Pitch / Roll on heavy turns to improve the feeling of weight.
 
-		if (Hit.IsValidBlockingHit())
-		{
-			//DEBUGMESSAGE("WE HIT A WALL AT %f", FColor::White, UGameplayStatics::GetRealTimeSeconds(GetWorld()));
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewPawnTick);
+	FAfterCurfewScopeCycles TickCycles(GAfterCurfewCounters.PawnTickCycles);
 
-			const FVector Normal2D = Hit.Normal.GetSafeNormal2D();
-			const FVector Deflection = FVector::VectorPlaneProject(XYMovement, Normal2D) * (1.f - Hit.Time);
-			RootComponent->MoveComponent(Deflection, NewRotation, true);
-		}
-	}
-	// If no XY movement, still turn to face the aim direction
-	else
+	// Pawns driven from another machine get their moves and shots over the network
+	if (MovementComponent->IsDrivenLocally())
 	{
-		RootComponent->SetWorldRotation(NewRotation);
-	}
+		FVector CurrentLocation = this->GetActorLocation();
 
-	// Handle lift movement
-	/*const float UpValue = GetInputAxisValue(LiftUpBinding);
-	const FVector ZMoveDirection = FVector(0, 0, UpValue).GetClampedToMaxSize(1.0f);
-	const FVector ZMovement = ZMoveDirection * 1000.f * DeltaSeconds;*/
+		// Get the aiming direction for the player
+		FVector AimLocation = AimComponent->UpdateAim();
+		FVector AimDirection = AimLocation - CurrentLocation;
+		AimDirection.Normalize();
 
-	const FVector ZMoveDirection = FVector::UpVector;
-	const FVector ZMovement = ZMoveDirection * CurrentLiftSpeed * DeltaSeconds;
+		// Determine target rotation based on input
+		FRotator TargetRotation = AimDirection.Rotation();
 
-	//DEBUGMESSAGE("CurrentLiftSpeed: %f", FColor::Red, CurrentLiftSpeed);
+		SCOPE_CYCLE_COUNTER(STAT_AfterCurfewPawnInput);
 
-	DEBUGMESSAGE("Location Z: %f", FColor::White, CurrentLocation.Z);
+		// Quantize this frame's input into a command so live play and replays apply exactly the same values
+		FAfterCurfewInputCommand Command;
+		Command.SetDeltaTime(DeltaSeconds);
+		Command.SetAimYaw(TargetRotation.Yaw);
+		Command.MoveForward = FAfterCurfewInputCommand::QuantizeAxis(PendingMoveInput.X);
+		Command.MoveRight = FAfterCurfewInputCommand::QuantizeAxis(PendingMoveInput.Y);
+		Command.LiftUp = FAfterCurfewInputCommand::QuantizeAxis(PendingMoveInput.Z);
+		Command.Buttons = bFire ? FAfterCurfewInputCommand::FireButton : 0;
+		PendingMoveInput = FVector::ZeroVector;
 
-	if (!ZMovement.IsNearlyZero(0.1f))//.SizeSquared() > 0.0f)// && !(CurrentLocation.Z + ZMovement.Z <= 207.f))
-	{
-		FHitResult Hit(1.f);
+		// Recorded, or replaced by the recorded command during playback
+		ReplayComponent->ProcessCommand(Command);
 
-		FRotator CurrentRotation = this->GetActorRotation();
+		// Held by movement until our next tick, which comes less often for insignificant pawns
+		const FVector MoveInput(FAfterCurfewInputCommand::DequantizeAxis(Command.MoveForward), FAfterCurfewInputCommand::DequantizeAxis(Command.MoveRight), FAfterCurfewInputCommand::DequantizeAxis(Command.LiftUp));
+		MovementComponent->SetMoveInput(IsMoveInputIgnored() ? FVector::ZeroVector : MoveInput);
 
-		RootComponent->MoveComponent(ZMovement, CurrentRotation, true, &Hit);
+		// Turn to face the target rotation, the movement component spins up to turn speed and applies the turn
+		MovementComponent->SetDesiredYaw(Command.GetAimYaw());
 
-		if (Hit.IsValidBlockingHit())
-		{
-			//DEBUGMESSAGE("WE HIT A FLOOR/CEILING AT %f", FColor::White, UGameplayStatics::GetRealTimeSeconds(GetWorld()));
+		//AC_SCREEN(Aim, FColor::White, TEXT("Current: %f, Target: %f"), GetActorRotation().Yaw, TargetRotation.Yaw);
 
-			const FVector Normal2D = Hit.Normal.GetSafeNormal2D();
-			const FVector Deflection = FVector::VectorPlaneProject(ZMovement, Normal2D) * (1.f - Hit.Time);
-			RootComponent->MoveComponent(Deflection, CurrentRotation, true);
-		}
-	}
-
-	// Create fire direction vector
-	//const FVector FireDirection = FVector(AimDirection.X, AimDirection.Y, 0.f);
-
-	// Fire vector is the forward vector of the ship
-	AimDirection = this->GetActorForwardVector();
-	const FVector FireDirection = FVector(AimDirection.X, AimDirection.Y, 0.f);
+		AC_SCREEN(Movement, FColor::White, TEXT("Location Z: %f"), CurrentLocation.Z);
 
-	// Try and fire a shot if fire button is being held down
-	if (bFire == true)
-	{
-		FireShot(FireDirection);
+		// The weapon ticks after movement and fires along the facing it settles on
+		WeaponComponent->SetWantsToFire(Command.IsFiring());
 	}
 	Super::Tick(DeltaSeconds);
 }
-
-void AAfterCurfewPawn::FireShot(FVector FireDirection)
-{
-	// If it's ok to fire again
-	if (bCanFire == true)
-	{
-		// If we are pressing fire stick in a direction
-		if (FireDirection.SizeSquared() > 0.0f)
-		{
-			// Add slight variance for better looking bullet spread.
-			const FRotator FireRotation = FireDirection.Rotation().Add(0, FMath::FRandRange(-FireSpread, FireSpread), 0);
-
-			// Spawn projectile at an offset from this pawn
-			const FVector SpawnLocation = GetActorLocation() + FireRotation.RotateVector(GunOffset);
-
-			UWorld* const World = GetWorld();
-			if (World != NULL)
-			{
-				// spawn the projectile
-				//World->SpawnActor<AAfterCurfewProjectile>(SpawnLocation, FireRotation);
-
-				FVector Scale = FVector(1.0f);
-				const FTransform SpawnTransform = FTransform(FireRotation, SpawnLocation, Scale * ProjectileScale);
-				AAfterCurfewProjectile* NewProjectile = World->SpawnActorDeferred<AAfterCurfewProjectile>(AAfterCurfewProjectile::StaticClass(), SpawnTransform);
-				NewProjectile->Initialize(ProjectileInitialSpeed, ProjectileMaxSpeed);
-				NewProjectile->FinishSpawning(SpawnTransform);
-			}
-
-			bCanFire = false;
-			World->GetTimerManager().SetTimer(TimerHandle_ShotTimerExpired, this, &AAfterCurfewPawn::ShotTimerExpired, FireRate);
-
-			// try and play the sound if specified
-			if (FireSound != nullptr)
-			{
-				UGameplayStatics::PlaySoundAtLocation(this, FireSound, GetActorLocation());
-			}
-
-			bCanFire = false;
-		}
-	}
-}
-
-void AAfterCurfewPawn::ShotTimerExpired()
-{
-	bCanFire = true;
-}
-
@@ -4,8 +4,11 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "Engine/StreamableManager.h"
 #include "AfterCurfewPawn.generated.h"
 
+class UStaticMesh;
+
 UCLASS(Blueprintable)
 class AAfterCurfewPawn : public APawn
 {
@@ -23,56 +26,57 @@ class AAfterCurfewPawn : public APawn
 	UPROPERTY(Category = Camera, VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
 	class USpringArmComponent* CameraBoom;
 
-public:
-	AAfterCurfewPawn();
-
-	/** Offset from the ships location to spawn projectiles */
-	UPROPERTY(Category = "Gameplay\|Weapons", EditAnywhere, BlueprintReadWrite)
-	FVector GunOffset;
+	/** Moves the ship */
+	UPROPERTY(Category = Movement, VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
+	class UAfterCurfewMovementComponent* MovementComponent;
 
-	/* How fast the weapon will fire */
-	UPROPERTY(Category = "Gameplay\|Weapons", EditAnywhere, BlueprintReadWrite)
-	float FireRate;
+	/** Resolves where the ship is aiming */
+	UPROPERTY(Category = Gameplay, VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
+	class UAfterCurfewAimComponent* AimComponent;
 
-	/* The maximum spread of the bullets */
-	UPROPERTY(Category = "Gameplay\|Weapons", EditAnywhere, BlueprintReadWrite)
-	float FireSpread;
+	/** Fires the ship's weapon */
+	UPROPERTY(Category = Gameplay, VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
+	class UAfterCurfewWeaponComponent* WeaponComponent;
 
-	/* The scale of the bullets */
-	UPROPERTY(Category = "Gameplay\|Weapons", EditAnywhere, BlueprintReadWrite)
-	float ProjectileScale;
+	/** Voices the weapon's shots through the world's audio pool */
+	UPROPERTY(Category = Audio, VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
+	class UAfterCurfewFireAudioComponent* FireAudioComponent;
 
-	/* The initial speed of the bullets */
-	UPROPERTY(Category = "Gameplay\|Weapons", EditAnywhere, BlueprintReadWrite)
-	float ProjectileInitialSpeed;
+	/** Records or plays back our input commands */
+	UPROPERTY(Category = Gameplay, VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
+	class UAfterCurfewReplayComponent* ReplayComponent;
 
-	/* The max speed of the bullets */
-	UPROPERTY(Category = "Gameplay\|Weapons", EditAnywhere, BlueprintReadWrite)
-	float ProjectileMaxSpeed;
+public:
+	AAfterCurfewPawn();
 
 	/* The speed our ship moves around the level */
 	//UPROPERTY(Category = Gameplay, EditAnywhere, BlueprintReadWrite)
 	//float MoveSpeed;
 
-	/** Sound to play each time we fire */
-	UPROPERTY(Category = Audio, EditAnywhere, BlueprintReadWrite)
-	class USoundBase* FireSound;
-
 	// Begin Actor Interface
+	virtual void PreRegisterAllComponents() override;
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void Tick(float DeltaSeconds) override;
 	virtual void SetupPlayerInputComponent(class UInputComponent* InputComponent) override;
 	// End Actor Interface
 
-	/* Fire a shot in the specified direction */
-	void FireShot(FVector FireDirection);
-
-	/* Handler for the fire timer expiration */
-	void ShotTimerExpired();
+	// Begin Pawn Interface
+	virtual UPawnMovementComponent* GetMovementComponent() const override;
+	// End Pawn Interface
 
 	void StartFiring();
 
 	void StopFiring();
 
+	/** Sets this frame's movement input, X forward, Y right and Z lift, for controllers without input bindings */
+	void SetMoveIntent(const FVector& MoveInput);
+
+	/** Sets how often we tick and whether we play cosmetics, the significance manager lowers both for distant pawns */
+	void SetSignificance(float TickInterval, bool bCosmetics);
+
+	FORCEINLINE const TSoftObjectPtr<UStaticMesh>& GetShipMeshAsset() const { return ShipMesh; }
+
 	// Static names for axis bindings
 	static const FName MoveForwardBinding;
 	static const FName MoveRightBinding;
@@ -95,15 +99,31 @@ protected:
 	//void ThrustInput(float Val);
 
 private:
+	/** Puts ShipMesh on the mesh component, loading it first if the game mode has not preloaded it */
+	void LoadShipMesh();
 
-	/* Flag to control firing  */
-	uint32 bCanFire : 1;
+	void OnShipMeshLoaded();
+
+	/** Mesh of the ship, preloaded by the game mode instead of loaded with the class */
+	UPROPERTY(Category = Mesh, EditDefaultsOnly)
+	TSoftObjectPtr<UStaticMesh> ShipMesh;
+
+	TSharedPtr<FStreamableHandle> ShipMeshHandle;
 
 	/* Flag to control firing  */
 	uint32 bFire : 1;
 
-	/** Handle for efficient management of ShotTimerExpired timer */
-	FTimerHandle TimerHandle_ShotTimerExpired;
+	/** Axis input bound this frame, X forward, Y right and Z lift, turned into a command on Tick */
+	FVector PendingMoveInput;
+
+	/** Manager throttling us when we are far from the view, none on a dedicated server */
+	TWeakObjectPtr<class AAfterCurfewSignificanceManager> SignificanceManager;
+
+	/** Manager moving us together with the other pawns */
+	TWeakObjectPtr<class AAfterCurfewPawnUpdateManager> PawnUpdateManager;
+
+	/** History our hits are checked against, on the server */
+	TWeakObjectPtr<class AAfterCurfewLagCompensation> LagCompensation;
 
 	/*
 	UPROPERTY(Category = Gameplay, EditAnywhere)
@@ -118,56 +138,6 @@ private:
 	float CurrentThrustSpeed;
 	*/
 
-	/** How quickly speed changes */
-	UPROPERTY(Category = "Gameplay\|Movement\|Planar", EditAnywhere)
-	float InterpSpeed;
-
-	/** Max speed */
-	UPROPERTY(Category = "Gameplay\|Movement\|Planar", EditAnywhere)
-	float MaxSpeed;
-
-	/** Min speed */
-	UPROPERTY(Category = "Gameplay\|Movement\|Planar", EditAnywhere)
-	float MinSpeed;
-
-	/** Current forward speed */
-	float CurrForwardSpeed;
-
-	/** Current forward speed */
-	float CurrRightSpeed;
-
-
-	/** How quickly speed changes */
-	UPROPERTY(Category = "Gameplay\|Movement\|Turning", EditAnywhere)
-	float YawInterpSpeed;
-
-	/** Max speed */
-	UPROPERTY(Category = "Gameplay\|Movement\|Turning", EditAnywhere)
-	float MaxYawSpeed;
-
-	/** Min speed */
-	UPROPERTY(Category = "Gameplay\|Movement\|Turning", EditAnywhere)
-	float MinYawSpeed;
-
-	/** Current turning speed */
-	float CurrYawSpeed;
-
-
-	/** How quickly lift speed changes */
-	UPROPERTY(Category = "Gameplay\|Movement\|Lift", EditAnywhere)
-	float LiftInterpSpeed;
-
-	/** Max lift speed */
-	UPROPERTY(Category = "Gameplay\|Movement\|Lift", EditAnywhere)
-	float MaxLiftSpeed;
-
-	/** Min lift speed */
-	UPROPERTY(Category = "Gameplay\|Movement\|Lift", EditAnywhere)
-	float MinLiftSpeed;
-
-	/** Current lift speed */
-	float CurrentLiftSpeed;
-
 public:
 	/** Returns ShipMeshComponent subobject **/
 	FORCEINLINE class UStaticMeshComponent* GetShipMeshComponent() const { return ShipMeshComponent; }
@@ -175,4 +145,14 @@ public:
 	FORCEINLINE class UCameraComponent* GetCameraComponent() const { return CameraComponent; }
 	/** Returns CameraBoom subobject **/
 	FORCEINLINE class USpringArmComponent* GetCameraBoom() const { return CameraBoom; }
+	/** Returns MovementComponent subobject **/
+	FORCEINLINE class UAfterCurfewMovementComponent* GetShipMovementComponent() const { return MovementComponent; }
+	/** Returns AimComponent subobject **/
+	FORCEINLINE class UAfterCurfewAimComponent* GetAimComponent() const { return AimComponent; }
+	/** Returns WeaponComponent subobject **/
+	FORCEINLINE class UAfterCurfewWeaponComponent* GetWeaponComponent() const { return WeaponComponent; }
+	/** Returns FireAudioComponent subobject **/
+	FORCEINLINE class UAfterCurfewFireAudioComponent* GetFireAudioComponent() const { return FireAudioComponent; }
+	/** Returns ReplayComponent subobject **/
+	FORCEINLINE class UAfterCurfewReplayComponent* GetReplayComponent() const { return ReplayComponent; }
 };
\ No newline at end of file
@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewPawnUpdateManager.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewMovementComponent.h"
+#include "AfterCurfewPawn.h"
+#include "AfterCurfewWeaponComponent.h"
+#include "AfterCurfewWorldManager.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Pawn Update Begin"), STAT_AfterCurfewPawnUpdateBegin, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Pawn Update Integrate"), STAT_AfterCurfewPawnUpdateIntegrate, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Pawn Update Apply"), STAT_AfterCurfewPawnUpdateApply, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pawns Moved"), STAT_AfterCurfewPawnsMoved, STATGROUP_AfterCurfew);
+
+static TAutoConsoleVariable<int32> CVarPawnParallelUpdate(
+	TEXT("ac.Pawn.ParallelUpdate"),
+	1,
+	TEXT("Where the pawn update manager integrates pawn moves.\n")
+	TEXT("0: on the game thread\n")
+	TEXT("1: across worker threads (default)"),
+	ECVF_Default);
+
+AAfterCurfewPawnUpdateManager::AAfterCurfewPawnUpdateManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	MinParallelMoves = 16;
+}
+
+AAfterCurfewPawnUpdateManager* AAfterCurfewPawnUpdateManager::Get(UWorld* World)
+{
+	return FindOrSpawnWorldManager<AAfterCurfewPawnUpdateManager>(World);
+}
+
+void AAfterCurfewPawnUpdateManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	for (AAfterCurfewPawn* Pawn : Pawns)
+	{
+		if (IsValid(Pawn))
+		{
+			ReleasePawn(Pawn);
+		}
+	}
+	Pawns.Empty();
+	Moves.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AAfterCurfewPawnUpdateManager::RegisterPawn(AAfterCurfewPawn* Pawn)
+{
+	if (Pawn == nullptr || Pawns.Contains(Pawn))
+	{
+		return;
+	}
+	Pawns.Add(Pawn);
+
+	Pawn->GetShipMovementComponent()->SetUpdatedByManager(true);
+
+	// The pawn's tick feeds the move its input, and the weapon fires along the facing the move settles on
+	AddTickPrerequisiteActor(Pawn);
+	Pawn->GetWeaponComponent()->AddTickPrerequisiteActor(this);
+}
+
+void AAfterCurfewPawnUpdateManager::UnregisterPawn(AAfterCurfewPawn* Pawn)
+{
+	if (Pawns.RemoveSwap(Pawn) > 0)
+	{
+		ReleasePawn(Pawn);
+	}
+}
+
+void AAfterCurfewPawnUpdateManager::ReleasePawn(AAfterCurfewPawn* Pawn)
+{
+	RemoveTickPrerequisiteActor(Pawn);
+	Pawn->GetWeaponComponent()->RemoveTickPrerequisiteActor(this);
+	Pawn->GetShipMovementComponent()->SetUpdatedByManager(false);
+}
+
+void AAfterCurfewPawnUpdateManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	Pawns.RemoveAllSwap([](const AAfterCurfewPawn* Pawn) { return !IsValid(Pawn); });
+
+	// Everything touching the world or the network happens here, leaving only the integration to the workers
+	Moves.Reset();
+	{
+		SCOPE_CYCLE_COUNTER(STAT_AfterCurfewPawnUpdateBegin);
+		for (AAfterCurfewPawn* Pawn : Pawns)
+		{
+			UAfterCurfewMovementComponent* Movement = Pawn->GetShipMovementComponent();
+			const float PawnDeltaSeconds = DeltaSeconds * Pawn->CustomTimeDilation;
+			if (!Movement->ShouldSkipUpdate(PawnDeltaSeconds) && Movement->BeginTickMove(PawnDeltaSeconds))
+			{
+				Moves.Add(Movement);
+			}
+		}
+	}
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_AfterCurfewPawnUpdateIntegrate);
+		const bool bSingleThread = CVarPawnParallelUpdate.GetValueOnGameThread() == 0 || Moves.Num() < MinParallelMoves;
+		TArray<UAfterCurfewMovementComponent*>& MovesToIntegrate = Moves;
+		ParallelFor(MovesToIntegrate.Num(), [&MovesToIntegrate](int32 Index)
+		{
+			MovesToIntegrate[Index]->IntegrateTickMove();
+		}, bSingleThread);
+	}
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_AfterCurfewPawnUpdateApply);
+		for (UAfterCurfewMovementComponent* Movement : Moves)
+		{
+			Movement->EndTickMove();
+		}
+	}
+
+	SET_DWORD_STAT(STAT_AfterCurfewPawnsMoved, Moves.Num());
+}
@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "AfterCurfewPawnUpdateManager.generated.h"
+
+class AAfterCurfewPawn;
+class UAfterCurfewMovementComponent;
+
+/**
+ * Moves every AfterCurfew pawn in a world in one tick instead of one movement tick per pawn.
+ * The tick runs after the pawns have turned their input into movement input and in three phases: the moves are
+ * started on the game thread, integrated across worker threads with ParallelFor, and swept into the world one
+ * after the other on the game thread. Weapons tick after us, so shots still leave along the facing settled on this frame.
+ */
+UCLASS(config=Game, notplaceable)
+class AFTERCURFEW_API AAfterCurfewPawnUpdateManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewPawnUpdateManager();
+
+	/** Returns the pawn update manager for this world, creating it on first use */
+	static AAfterCurfewPawnUpdateManager* Get(UWorld* World);
+
+	// Begin Actor Interface
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+	// End Actor Interface
+
+	/** Takes over moving Pawn from its movement component's own tick */
+	void RegisterPawn(AAfterCurfewPawn* Pawn);
+
+	/** Gives moving Pawn back to its movement component */
+	void UnregisterPawn(AAfterCurfewPawn* Pawn);
+
+	/** Number of pawns we move */
+	FORCEINLINE int32 GetNumPawns() const { return Pawns.Num(); }
+
+	/** Fewer moves than this are integrated on the game thread, waking the workers would cost more than it saves */
+	UPROPERTY(Category = Movement, EditAnywhere, config, meta = (ClampMin = "1"))
+	int32 MinParallelMoves;
+
+private:
+	/** Hands Pawn's movement back to its own tick */
+	void ReleasePawn(AAfterCurfewPawn* Pawn);
+
+	UPROPERTY(Transient)
+	TArray<AAfterCurfewPawn*> Pawns;
+
+	/** Movement components with a move to integrate this frame, split across workers once there are MinParallelMoves of them */
+	TArray<UAfterCurfewMovementComponent*> Moves;
+};
@@ -2,6 +2,55 @@
 
 
 #include "AfterCurfewPlayerController.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewTelemetry.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<float> CVarNetLogBandwidth(
+	TEXT("ac.Net.LogBandwidth"),
+	0.f,
+	TEXT("Seconds between bandwidth log lines for every player connection, 0 to disable.\n")
+	TEXT("Handy on a dedicated server, e.g. -ExecCmds=\"ac.Net.LogBandwidth 5\""),
+	ECVF_Default);
+
+/** Logs the traffic of one connection */
+static void LogConnectionBandwidth(const UNetConnection* Connection)
+{
+	const APlayerController* PlayerController = Connection->PlayerController;
+	UE_LOG(LogAfterCurfew, Display, TEXT("%s: in %d B/s %d pkt/s, out %d B/s %d pkt/s, lost in %d out %d, ping %.0f ms"),
+		PlayerController != nullptr ? *PlayerController->GetName() : *Connection->LowLevelGetRemoteAddress(),
+		Connection->InBytesPerSecond, Connection->InPacketsPerSecond,
+		Connection->OutBytesPerSecond, Connection->OutPacketsPerSecond,
+		Connection->InPacketsLost, Connection->OutPacketsLost,
+		Connection->AvgLag * 1000.f);
+}
+
+static void LogBandwidth(UWorld* World)
+{
+	const UNetDriver* NetDriver = World != nullptr ? World->GetNetDriver() : nullptr;
+	if (NetDriver == nullptr)
+	{
+		UE_LOG(LogAfterCurfew, Display, TEXT("Not networked"));
+		return;
+	}
+
+	if (NetDriver->ServerConnection != nullptr)
+	{
+		LogConnectionBandwidth(NetDriver->ServerConnection);
+	}
+	for (const UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		LogConnectionBandwidth(Connection);
+	}
+}
+
+static FAutoConsoleCommandWithWorld NetBandwidthCommand(
+	TEXT("ac.Net.Bandwidth"),
+	TEXT("Logs bytes and packets per second sent and received on every connection."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&LogBandwidth));
 
 AAfterCurfewPlayerController::AAfterCurfewPlayerController()
 {
@@ -10,4 +59,35 @@ AAfterCurfewPlayerController::AAfterCurfewPlayerController()
 	bEnableMouseOverEvents = true;
 	bShowMouseCursor = true;
 	DefaultMouseCursor = EMouseCursor::Crosshairs;
+
+	LastBandwidthLogTime = 0.f;
+}
+
+void AAfterCurfewPlayerController::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Clients have no game mode to start the recorder
+	if (IsLocalController())
+	{
+		AAfterCurfewTelemetry::Get(GetWorld());
+	}
+}
+
+void AAfterCurfewPlayerController::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	// The server logs each remote player's connection
+	const float LogInterval = CVarNetLogBandwidth.GetValueOnGameThread();
+	UNetConnection* Connection = GetNetConnection();
+	if (LogInterval > 0.f && HasAuthority() && Connection != nullptr)
+	{
+		const float Now = GetWorld()->GetRealTimeSeconds();
+		if (Now - LastBandwidthLogTime >= LogInterval)
+		{
+			LastBandwidthLogTime = Now;
+			LogConnectionBandwidth(Connection);
+		}
+	}
 }
@@ -16,4 +16,13 @@ class AFTERCURFEW_API AAfterCurfewPlayerController : public APlayerController
 	
 public:
 	AAfterCurfewPlayerController();
+
+	// Begin Actor Interface
+	virtual void BeginPlay() override;
+	virtual void Tick(float DeltaSeconds) override;
+	// End Actor Interface
+
+private:
+	/** Real time of the last ac.Net.LogBandwidth line for our connection */
+	float LastBandwidthLogTime;
 };
@@ -1,20 +1,23 @@
 // Copyright 1998-2019 Epic Games, Inc. All Rights Reserve
 
 #include "AfterCurfewProjectile.h"
+#include "AfterCurfew.h"
 #include "GameFramework/ProjectileMovementComponent.h"
-#include "UObject/ConstructorHelpers.h"
 #include "Components/StaticMeshComponent.h"
-#include "GameFramework/ProjectileMovementComponent.h"
+#include "AfterCurfewProjectileMovementComponent.h"
 #include "Engine/StaticMesh.h"
+#include "AfterCurfewProjectilePool.h"
+#include "AfterCurfewHitResolver.h"
+#include "AfterCurfewPawn.h"
+#include "AfterCurfewWeaponComponent.h"
+#include "AfterCurfewWeaponDefinition.h"
+
+DECLARE_CYCLE_STAT(TEXT("Projectile Hit"), STAT_AfterCurfewProjectileHit, STATGROUP_AfterCurfew);
 
 AAfterCurfewProjectile::AAfterCurfewProjectile() 
 {
-	// Static reference to the mesh to use for the projectile
-	static ConstructorHelpers::FObjectFinder<UStaticMesh> ProjectileMeshAsset(TEXT("/Game/TwinStick/Meshes/TwinStickProjectile.TwinStickProjectile"));
-
-	// Create mesh component for the projectile sphere
+	// Create mesh component for the projectile sphere, the mesh is the default weapon's and set before registering
 	ProjectileMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("ProjectileMesh0"));
-	ProjectileMesh->SetStaticMesh(ProjectileMeshAsset.Object);
 	ProjectileMesh->SetupAttachment(RootComponent);
 	ProjectileMesh->BodyInstance.SetCollisionProfileName("Projectile");
 	ProjectileMesh->OnComponentHit.AddDynamic(this, &AAfterCurfewProjectile::OnHit);		// set up a notification for when this component hits something
@@ -22,7 +25,7 @@ AAfterCurfewProjectile::AAfterCurfewProjectile()
 	RootComponent = ProjectileMesh;
 
 	// Use a ProjectileMovementComponent to govern this projectile's movement
-	ProjectileMovement = CreateDefaultSubobject<UProjectileMovementComponent>(TEXT("ProjectileMovement0"));
+	ProjectileMovement = CreateDefaultSubobject<UAfterCurfewProjectileMovementComponent>(TEXT("ProjectileMovement0"));
 	ProjectileMovement->UpdatedComponent = ProjectileMesh;
 	ProjectileMovement->InitialSpeed = 3000.f;
 	ProjectileMovement->MaxSpeed = 3000.f;
@@ -32,21 +35,104 @@ AAfterCurfewProjectile::AAfterCurfewProjectile()
 
 	// Die after 3 seconds by default
 	InitialLifeSpan = 3.0f;
+
+	PooledLifeSpan = InitialLifeSpan;
+	PoolSerial = 0;
+	bPooledActive = true;
+}
+
+void AAfterCurfewProjectile::PreRegisterAllComponents()
+{
+	Super::PreRegisterAllComponents();
+
+	// The mesh is our collision, so it has to be there before we fly. The game mode preloads it, this only loads where
+	// nothing did, e.g. on a client
+	if (ProjectileMesh->GetStaticMesh() == nullptr)
+	{
+		ProjectileMesh->SetStaticMesh(GetDefault<UAfterCurfewWeaponDefinition>()->ProjectileMesh.LoadSynchronous());
+	}
 }
 
 void AAfterCurfewProjectile::Initialize(float NewInitialSpeed, float NewMaxSpeed)
 {
 	GetProjectileMovement()->InitialSpeed = NewInitialSpeed;
 	GetProjectileMovement()->MaxSpeed = NewMaxSpeed;
+
+	// A reused projectile has already run InitializeComponent, and its last hit stopped the movement and cleared the updated component
+	if (HasActorBegunPlay())
+	{
+		GetProjectileMovement()->SetUpdatedComponent(ProjectileMesh);
+		GetProjectileMovement()->Velocity = GetActorForwardVector() * NewInitialSpeed;
+		GetProjectileMovement()->UpdateComponentVelocity();
+	}
+}
+
+void AAfterCurfewProjectile::SetPooledActive(bool bActive)
+{
+	bPooledActive = bActive;
+
+	SetActorHiddenInGame(!bActive);
+	SetActorEnableCollision(bActive);
+	GetProjectileMovement()->SetComponentTickEnabled(bActive);
+
+	if (bActive)
+	{
+		SetFlightTimeLeft(PooledLifeSpan);
+	}
+	else
+	{
+		GetProjectileMovement()->StopMovementImmediately();
+		GetWorldTimerManager().ClearTimer(TimerHandle_LifeSpanExpired);
+	}
+}
+
+void AAfterCurfewProjectile::SetFlightTimeLeft(float Seconds)
+{
+	// The timer is armed directly, SetLifeSpan would overwrite InitialLifeSpan and the next flight would never expire
+	GetWorldTimerManager().SetTimer(TimerHandle_LifeSpanExpired, this, &AActor::LifeSpanExpired, Seconds);
+}
+
+void AAfterCurfewProjectile::ReturnToPool()
+{
+	if (AAfterCurfewProjectilePool* Pool = OwningPool.Get())
+	{
+		Pool->Release(this);
+	}
+	else
+	{
+		Destroy();
+	}
+}
+
+void AAfterCurfewProjectile::LifeSpanExpired()
+{
+	ReturnToPool();
 }
 
 void AAfterCurfewProjectile::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
 {
-	// Only add impulse and destroy projectile if we hit a physics
-	if ((OtherActor != NULL) && (OtherActor != this) && (OtherComp != NULL) && OtherComp->IsSimulatingPhysics())
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewProjectileHit);
+
+	// Hits on pawns are the shooter's weapon's to decide, it also shows the impact
+	const AAfterCurfewPawn* Shooter = Cast<AAfterCurfewPawn>(GetOwner());
+	if (Shooter != nullptr && OtherActor != Shooter)
+	{
+		Shooter->GetWeaponComponent()->NotifyProjectileHit(this, OtherActor, Hit.ImpactPoint, Hit.ImpactNormal);
+	}
+
+	if (!HitResolver.IsValid())
 	{
-		OtherComp->AddImpulseAtLocation(GetVelocity() * 20.0f, GetActorLocation());
+		HitResolver = AAfterCurfewHitResolver::Get(GetWorld());
 	}
 
-	Destroy();
-}
\ No newline at end of file
+	// The movement has already stopped, the impulse and the return to the pool happen after physics
+	if (AAfterCurfewHitResolver* Resolver = HitResolver.Get())
+	{
+		const bool bPush = (OtherActor != NULL) && (OtherActor != this);
+		Resolver->QueueHit(this, bPush ? OtherComp : nullptr, GetVelocity() * 20.0f, GetActorLocation());
+	}
+	else
+	{
+		ReturnToPool();
+	}
+}
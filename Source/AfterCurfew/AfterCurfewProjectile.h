@@ -8,6 +8,8 @@
 
 class UProjectileMovementComponent;
 class UStaticMeshComponent;
+class AAfterCurfewProjectilePool;
+class AAfterCurfewHitResolver;
 
 UCLASS(config=Game)
 class AAfterCurfewProjectile : public AActor
@@ -25,10 +27,30 @@ class AAfterCurfewProjectile : public AActor
 public:
 	AAfterCurfewProjectile();
 
-	/** Initialize different variables for the projectile when spwaning it in code */
+	/** Initialize different variables for the projectile when spwaning it in code, also resets the movement of a reused projectile */
 	void Initialize(float NewInitialSpeed, float NewMaxSpeed);
 
-	/** Function to handle the projectile hitting something */
+	/** Hands the projectile back to its pool, or destroys it if it was not spawned by one */
+	void ReturnToPool();
+
+	/** Shows and enables the projectile while it is in flight, hides and freezes it while it sits in the pool */
+	void SetPooledActive(bool bActive);
+
+	/** Makes the current flight end Seconds from now, later flights still last the pooled lifespan */
+	void SetFlightTimeLeft(float Seconds);
+
+	/** Returns true while the projectile is in flight */
+	FORCEINLINE bool IsPooledActive() const { return bPooledActive; }
+
+	/** Returns the pool's acquire order of this flight, a recycled projectile gets a new one */
+	FORCEINLINE uint32 GetPoolSerial() const { return PoolSerial; }
+
+	// Begin Actor Interface
+	virtual void PreRegisterAllComponents() override;
+	virtual void LifeSpanExpired() override;
+	// End Actor Interface
+
+	/** Function to handle the projectile hitting something, queues the hit with the world's hit resolver */
 	UFUNCTION()
 	void OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
 
@@ -36,5 +58,23 @@ public:
 	FORCEINLINE UStaticMeshComponent* GetProjectileMesh() const { return ProjectileMesh; }
 	/** Returns ProjectileMovement subobject **/
 	FORCEINLINE UProjectileMovementComponent* GetProjectileMovement() const { return ProjectileMovement; }
+
+private:
+	friend class AAfterCurfewProjectilePool;
+
+	/** Pool this projectile returns to, unset for projectiles spawned directly */
+	TWeakObjectPtr<AAfterCurfewProjectilePool> OwningPool;
+
+	/** Resolves our hits after physics, cached on the first hit */
+	TWeakObjectPtr<AAfterCurfewHitResolver> HitResolver;
+
+	/** Seconds each flight lasts, SetLifeSpan overwrites InitialLifeSpan so the pool keeps its own copy */
+	float PooledLifeSpan;
+
+	/** Acquire order within the pool, lets the pool recycle the oldest projectile first */
+	uint32 PoolSerial;
+
+	/** Flag set while the projectile is in flight */
+	uint32 bPooledActive : 1;
 };
 
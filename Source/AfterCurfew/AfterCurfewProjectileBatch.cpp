@@ -0,0 +1,324 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewProjectileBatch.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewHitResolver.h"
+#include "AfterCurfewPawn.h"
+#include "AfterCurfewSpatialHash.h"
+#include "AfterCurfewWeaponComponent.h"
+#include "AfterCurfewWeaponDefinition.h"
+#include "AfterCurfewWorldManager.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Batched Projectiles Integrate"), STAT_AfterCurfewBatchIntegrate, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Batched Projectiles Sweep"), STAT_AfterCurfewBatchSweep, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Batched Projectiles Instances"), STAT_AfterCurfewBatchInstances, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Batched Projectiles"), STAT_AfterCurfewBatchLive, STATGROUP_AfterCurfew);
+DECLARE_MEMORY_STAT(TEXT("Batched Projectile Memory"), STAT_AfterCurfewBatchMemory, STATGROUP_AfterCurfew);
+
+static TAutoConsoleVariable<int32> CVarProjectileBackend(
+	TEXT("ac.ProjectileBackend"),
+	-1,
+	TEXT("Overrides the projectile backend of every pawn.\n")
+	TEXT("-1: use the pawn setting (default)\n")
+	TEXT(" 0: one actor per bullet\n")
+	TEXT(" 1: batched simulation"),
+	ECVF_Cheat);
+
+static const FName ProjectileProfileName(TEXT("Projectile"));
+
+AAfterCurfewProjectileBatch::AAfterCurfewProjectileBatch()
+{
+	InstancedMesh = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("InstancedMesh0"));
+	InstancedMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	InstancedMesh->SetGenerateOverlapEvents(false);
+	InstancedMesh->SetMobility(EComponentMobility::Movable);
+	InstancedMesh->CastShadow = false;
+	RootComponent = InstancedMesh;
+
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	LifeSpan = 3.f;
+	ImpactImpulseScale = 20.f;
+
+	BaseRadius = 10.f;
+	NumLive = 0;
+}
+
+AAfterCurfewProjectileBatch* AAfterCurfewProjectileBatch::Get(UWorld* World)
+{
+	return FindOrSpawnWorldManager<AAfterCurfewProjectileBatch>(World);
+}
+
+void AAfterCurfewProjectileBatch::PreRegisterAllComponents()
+{
+	Super::PreRegisterAllComponents();
+
+	// Preloaded by the game mode, only loads here where nothing preloads, e.g. on a client
+	UStaticMesh* Mesh = GetDefault<UAfterCurfewWeaponDefinition>()->ProjectileMesh.LoadSynchronous();
+	if (Mesh != nullptr)
+	{
+		InstancedMesh->SetStaticMesh(Mesh);
+		BaseRadius = Mesh->GetBounds().SphereRadius;
+	}
+}
+
+EAfterCurfewProjectileBackend AAfterCurfewProjectileBatch::ResolveBackend(EAfterCurfewProjectileBackend PawnBackend)
+{
+	const int32 Override = CVarProjectileBackend.GetValueOnGameThread();
+	if (Override >= 0)
+	{
+		return Override == 0 ? EAfterCurfewProjectileBackend::Actor : EAfterCurfewProjectileBackend::Batched;
+	}
+	return PawnBackend;
+}
+
+void AAfterCurfewProjectileBatch::Fire(const FTransform& SpawnTransform, float InitialSpeed, float MaxSpeed, AActor* ProjectileOwner)
+{
+	const FVector Velocity = SpawnTransform.GetRotation().GetForwardVector() * FMath::Min(InitialSpeed, MaxSpeed);
+	AddBullet(SpawnTransform.GetLocation(), Velocity, LifeSpan, SpawnTransform.GetMaximumAxisScale(), ProjectileOwner);
+}
+
+void AAfterCurfewProjectileBatch::AddBullet(const FVector& Location, const FVector& Velocity, float Lifetime, float Scale, AActor* ProjectileOwner)
+{
+	Reserve(NumLive + 1);
+
+	const int32 Index = NumLive++;
+	PosX[Index] = Location.X;
+	PosY[Index] = Location.Y;
+	PosZ[Index] = Location.Z;
+	VelX[Index] = Velocity.X;
+	VelY[Index] = Velocity.Y;
+	VelZ[Index] = Velocity.Z;
+	Lifetimes[Index] = Lifetime;
+	Scales[Index] = Scale;
+	Rotations[Index] = Velocity.ToOrientationQuat();
+	Owners[Index] = ProjectileOwner;
+
+	++GAfterCurfewCounters.ProjectilesSpawned;
+	SET_DWORD_STAT(STAT_AfterCurfewBatchLive, NumLive);
+}
+
+void AAfterCurfewProjectileBatch::GetBullet(int32 Index, FVector& OutLocation, FVector& OutVelocity, float& OutLifetime, float& OutScale, AActor*& OutOwner) const
+{
+	check(Index >= 0 && Index < NumLive);
+
+	OutLocation = FVector(PosX[Index], PosY[Index], PosZ[Index]);
+	OutVelocity = FVector(VelX[Index], VelY[Index], VelZ[Index]);
+	OutLifetime = Lifetimes[Index];
+	OutScale = Scales[Index];
+	OutOwner = Owners[Index].Get();
+}
+
+void AAfterCurfewProjectileBatch::RemoveAllBullets()
+{
+	GAfterCurfewCounters.ProjectilesReleased += NumLive;
+	for (int32 Index = 0; Index < NumLive; ++Index)
+	{
+		Owners[Index].Reset();
+	}
+	NumLive = 0;
+
+	SET_DWORD_STAT(STAT_AfterCurfewBatchLive, NumLive);
+}
+
+void AAfterCurfewProjectileBatch::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (NumLive > 0)
+	{
+		Integrate(DeltaSeconds);
+		SweepAndResolve();
+	}
+
+	UpdateInstances();
+
+	SET_DWORD_STAT(STAT_AfterCurfewBatchLive, NumLive);
+	SET_DWORD_STAT(STAT_AfterCurfewProjectilesInFlight, GAfterCurfewCounters.GetProjectilesAlive());
+}
+
+void AAfterCurfewProjectileBatch::Reserve(int32 Count)
+{
+	if (Count <= PosX.Num())
+	{
+		return;
+	}
+
+	// Grow geometrically and keep a multiple of four so the vector loop never reads past the end
+	const int32 NewCapacity = Align(FMath::Max(Count, PosX.Num() * 2), 4);
+
+	PosX.SetNumZeroed(NewCapacity);
+	PosY.SetNumZeroed(NewCapacity);
+	PosZ.SetNumZeroed(NewCapacity);
+	NextX.SetNumZeroed(NewCapacity);
+	NextY.SetNumZeroed(NewCapacity);
+	NextZ.SetNumZeroed(NewCapacity);
+	VelX.SetNumZeroed(NewCapacity);
+	VelY.SetNumZeroed(NewCapacity);
+	VelZ.SetNumZeroed(NewCapacity);
+	Lifetimes.SetNumZeroed(NewCapacity);
+	Scales.SetNumZeroed(NewCapacity);
+	Rotations.SetNum(NewCapacity);
+	Owners.SetNum(NewCapacity);
+
+	SET_MEMORY_STAT(STAT_AfterCurfewBatchMemory, NewCapacity * (sizeof(float) * 11 + sizeof(FQuat) + sizeof(TWeakObjectPtr<AActor>)));
+}
+
+void AAfterCurfewProjectileBatch::Integrate(float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewBatchIntegrate);
+
+	const VectorRegister VDeltaSeconds = VectorSetFloat1(DeltaSeconds);
+	const int32 NumPadded = Align(NumLive, 4);
+
+	for (int32 Index = 0; Index < NumPadded; Index += 4)
+	{
+		VectorStore(VectorMultiplyAdd(VectorLoad(&VelX[Index]), VDeltaSeconds, VectorLoad(&PosX[Index])), &NextX[Index]);
+		VectorStore(VectorMultiplyAdd(VectorLoad(&VelY[Index]), VDeltaSeconds, VectorLoad(&PosY[Index])), &NextY[Index]);
+		VectorStore(VectorMultiplyAdd(VectorLoad(&VelZ[Index]), VDeltaSeconds, VectorLoad(&PosZ[Index])), &NextZ[Index]);
+		VectorStore(VectorSubtract(VectorLoad(&Lifetimes[Index]), VDeltaSeconds), &Lifetimes[Index]);
+	}
+}
+
+void AAfterCurfewProjectileBatch::SweepAndResolve()
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewBatchSweep);
+
+	UWorld* const World = GetWorld();
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(AfterCurfewBatchSweep), false, this);
+
+	AAfterCurfewSpatialHash* Hash = nullptr;
+	if (AAfterCurfewSpatialHash::IsUsedByProjectiles())
+	{
+		if (!SpatialHash.IsValid())
+		{
+			SpatialHash = AAfterCurfewSpatialHash::Get(World);
+		}
+		Hash = SpatialHash.Get();
+	}
+
+	if (!HitResolver.IsValid())
+	{
+		HitResolver = AAfterCurfewHitResolver::Get(World);
+	}
+	AAfterCurfewHitResolver* const Resolver = HitResolver.Get();
+
+	for (int32 Index = 0; Index < NumLive; )
+	{
+		bool bAlive = Lifetimes[Index] > 0.f;
+
+		if (bAlive)
+		{
+			const FVector Start(PosX[Index], PosY[Index], PosZ[Index]);
+			const FVector End(NextX[Index], NextY[Index], NextZ[Index]);
+
+			const float Radius = BaseRadius * Scales[Index];
+			const AActor* ProjectileOwner = Owners[Index].Get();
+
+			++GAfterCurfewCounters.ProjectileSweeps;
+
+			FHitResult Hit;
+			bool bHit;
+			if (Hash != nullptr)
+			{
+				bHit = Hash->SweepSphere(Start, End, Radius, ProjectileOwner, Hit);
+			}
+			else
+			{
+				QueryParams.ClearIgnoredActors();
+				QueryParams.AddIgnoredActor(this);
+				QueryParams.AddIgnoredActor(ProjectileOwner);
+				bHit = World->SweepSingleByProfile(Hit, Start, End, FQuat::Identity, ProjectileProfileName, FCollisionShape::MakeSphere(Radius), QueryParams);
+			}
+
+			if (bHit)
+			{
+				// Same response as AAfterCurfewProjectile::OnHit, push simulating bodies after physics and stop on anything
+				if (Resolver != nullptr)
+				{
+					const FVector Velocity(VelX[Index], VelY[Index], VelZ[Index]);
+					Resolver->QueueHit(nullptr, Hit.GetComponent(), Velocity * ImpactImpulseScale, Hit.Location);
+				}
+				if (const AAfterCurfewPawn* Shooter = Cast<AAfterCurfewPawn>(ProjectileOwner))
+				{
+					Shooter->GetWeaponComponent()->NotifyProjectileHit(nullptr, Hit.GetActor(), Hit.ImpactPoint, Hit.ImpactNormal);
+				}
+				bAlive = false;
+			}
+		}
+
+		if (bAlive)
+		{
+			PosX[Index] = NextX[Index];
+			PosY[Index] = NextY[Index];
+			PosZ[Index] = NextZ[Index];
+			++Index;
+		}
+		else
+		{
+			// The swapped-in bullet has not been swept yet, so stay on this index
+			RemoveAtSwap(Index);
+		}
+	}
+}
+
+void AAfterCurfewProjectileBatch::RemoveAtSwap(int32 Index)
+{
+	++GAfterCurfewCounters.ProjectilesReleased;
+
+	const int32 Last = --NumLive;
+	if (Index != Last)
+	{
+		PosX[Index] = PosX[Last];
+		PosY[Index] = PosY[Last];
+		PosZ[Index] = PosZ[Last];
+		NextX[Index] = NextX[Last];
+		NextY[Index] = NextY[Last];
+		NextZ[Index] = NextZ[Last];
+		VelX[Index] = VelX[Last];
+		VelY[Index] = VelY[Last];
+		VelZ[Index] = VelZ[Last];
+		Lifetimes[Index] = Lifetimes[Last];
+		Scales[Index] = Scales[Last];
+		Rotations[Index] = Rotations[Last];
+		Owners[Index] = Owners[Last];
+	}
+	Owners[Last].Reset();
+}
+
+void AAfterCurfewProjectileBatch::UpdateInstances()
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewBatchInstances);
+
+	int32 NumInstances = InstancedMesh->GetInstanceCount();
+	if (NumInstances == 0 && NumLive == 0)
+	{
+		return;
+	}
+
+	while (NumInstances > NumLive)
+	{
+		InstancedMesh->RemoveInstance(--NumInstances);
+	}
+	while (NumInstances < NumLive)
+	{
+		InstancedMesh->AddInstanceWorldSpace(FTransform::Identity);
+		++NumInstances;
+	}
+
+	for (int32 Index = 0; Index < NumLive; ++Index)
+	{
+		const FTransform InstanceTransform(Rotations[Index], FVector(PosX[Index], PosY[Index], PosZ[Index]), FVector(Scales[Index]));
+		InstancedMesh->UpdateInstanceTransform(Index, InstanceTransform, true, false, true);
+	}
+
+	InstancedMesh->UpdateBounds();
+	InstancedMesh->MarkRenderStateDirty();
+}
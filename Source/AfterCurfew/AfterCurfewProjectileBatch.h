@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "AfterCurfewProjectileBatch.generated.h"
+
+class AAfterCurfewHitResolver;
+class AAfterCurfewSpatialHash;
+class UInstancedStaticMeshComponent;
+
+/** Which projectile implementation a pawn fires */
+UENUM()
+enum class EAfterCurfewProjectileBackend : uint8
+{
+	/** One pooled AAfterCurfewProjectile actor per bullet */
+	Actor,
+	/** Bullets simulated together by AAfterCurfewProjectileBatch */
+	Batched,
+};
+
+/**
+ * Simulates every batched bullet in a world from one tick.
+ * Bullet state is kept as a structure of arrays so integration can run four bullets at a time,
+ * all bullets are swept in one pass, against the arena's spatial hash unless ac.Projectile.SpatialHash is 0,
+ * and they are drawn through a single instanced static mesh.
+ */
+UCLASS(notplaceable)
+class AFTERCURFEW_API AAfterCurfewProjectileBatch : public AActor
+{
+	GENERATED_BODY()
+
+	/** Draws every live bullet */
+	UPROPERTY(Category = Projectile, VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
+	UInstancedStaticMeshComponent* InstancedMesh;
+
+public:
+	AAfterCurfewProjectileBatch();
+
+	/** Returns the batch for this world, creating it on first use */
+	static AAfterCurfewProjectileBatch* Get(UWorld* World);
+
+	/** Returns the backend pawns should fire with, taking the ac.ProjectileBackend override into account */
+	static EAfterCurfewProjectileBackend ResolveBackend(EAfterCurfewProjectileBackend PawnBackend);
+
+	/** Adds a bullet travelling along the transform's forward vector */
+	void Fire(const FTransform& SpawnTransform, float InitialSpeed, float MaxSpeed, AActor* ProjectileOwner);
+
+	/** Adds a bullet in flight, with Lifetime seconds left */
+	void AddBullet(const FVector& Location, const FVector& Velocity, float Lifetime, float Scale, AActor* ProjectileOwner);
+
+	/** Reads back bullet Index, below GetNumLive */
+	void GetBullet(int32 Index, FVector& OutLocation, FVector& OutVelocity, float& OutLifetime, float& OutScale, AActor*& OutOwner) const;
+
+	/** Removes every bullet in flight */
+	void RemoveAllBullets();
+
+	/** Number of bullets in flight */
+	int32 GetNumLive() const { return NumLive; }
+
+	/** How long a bullet flies before it is removed, matches the projectile actor */
+	UPROPERTY(Category = Projectile, EditAnywhere)
+	float LifeSpan;
+
+	/** Impulse applied to simulating bodies per unit of bullet velocity, matches the projectile actor */
+	UPROPERTY(Category = Projectile, EditAnywhere)
+	float ImpactImpulseScale;
+
+	// Begin Actor Interface
+	virtual void PreRegisterAllComponents() override;
+	virtual void Tick(float DeltaSeconds) override;
+	// End Actor Interface
+
+	/** Returns InstancedMesh subobject **/
+	FORCEINLINE UInstancedStaticMeshComponent* GetInstancedMesh() const { return InstancedMesh; }
+
+private:
+	/** Makes room for at least Count bullets, keeping every array padded to a multiple of four */
+	void Reserve(int32 Count);
+
+	/** Advances positions and lifetimes of every bullet, four at a time */
+	void Integrate(float DeltaSeconds);
+
+	/** Sweeps every bullet from its current to its next position, killing the ones that hit or expired */
+	void SweepAndResolve();
+
+	/** Moves the last bullet into Index and shrinks the live count */
+	void RemoveAtSwap(int32 Index);
+
+	/** Pushes bullet transforms to the instanced mesh */
+	void UpdateInstances();
+
+	/** Spatial hash bullets are swept against, cached on first use */
+	TWeakObjectPtr<AAfterCurfewSpatialHash> SpatialHash;
+
+	/** Applies the impulses of our hits after physics, cached on first use */
+	TWeakObjectPtr<AAfterCurfewHitResolver> HitResolver;
+
+	/** Collision radius of an unscaled bullet */
+	float BaseRadius;
+
+	/** Number of bullets in flight, the arrays below are larger and padded */
+	int32 NumLive;
+
+	TArray<float> PosX;
+	TArray<float> PosY;
+	TArray<float> PosZ;
+
+	TArray<float> NextX;
+	TArray<float> NextY;
+	TArray<float> NextZ;
+
+	TArray<float> VelX;
+	TArray<float> VelY;
+	TArray<float> VelZ;
+
+	TArray<float> Lifetimes;
+
+	TArray<float> Scales;
+
+	TArray<FQuat> Rotations;
+
+	TArray<TWeakObjectPtr<AActor>> Owners;
+};
@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewProjectileMovementComponent.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewSpatialHash.h"
+#include "Components/PrimitiveComponent.h"
+#include "GameFramework/Actor.h"
+
+bool UAfterCurfewProjectileMovementComponent::MoveUpdatedComponentImpl(const FVector& Delta, const FQuat& NewRotation, bool bSweep, FHitResult* OutHit, ETeleportType Teleport)
+{
+	// A move without distance only rotates, the scene component does not sweep for it
+	if (!bSweep || Delta.IsNearlyZero())
+	{
+		return Super::MoveUpdatedComponentImpl(Delta, NewRotation, bSweep, OutHit, Teleport);
+	}
+
+	++GAfterCurfewCounters.ProjectileSweeps;
+
+	if (!AAfterCurfewSpatialHash::IsUsedByProjectiles() || UpdatedPrimitive == nullptr)
+	{
+		return Super::MoveUpdatedComponentImpl(Delta, NewRotation, bSweep, OutHit, Teleport);
+	}
+
+	if (!SpatialHash.IsValid())
+	{
+		SpatialHash = AAfterCurfewSpatialHash::Get(GetWorld());
+	}
+	AAfterCurfewSpatialHash* const Hash = SpatialHash.Get();
+	if (Hash == nullptr)
+	{
+		return Super::MoveUpdatedComponentImpl(Delta, NewRotation, bSweep, OutHit, Teleport);
+	}
+
+	// Same query as the batched backend, the shooter is never in the way of its own shots
+	AActor* const Projectile = UpdatedPrimitive->GetOwner();
+	const FVector Start = UpdatedPrimitive->GetComponentLocation();
+	const FVector End = Start + Delta;
+	FHitResult Hit(Start, End);
+	const bool bHit = Hash->SweepSphere(Start, End, UpdatedPrimitive->Bounds.SphereRadius, Projectile != nullptr ? Projectile->GetOwner() : nullptr, Hit);
+	if (bHit)
+	{
+		Hit.bBlockingHit = true;
+		Hit.TraceStart = Start;
+		Hit.TraceEnd = End;
+	}
+
+	Super::MoveUpdatedComponentImpl(bHit ? Delta * Hit.Time : Delta, NewRotation, false, nullptr, Teleport);
+
+	// The scene component dispatches the hits of its own sweeps, this one never ran, so OnHit is called from here
+	if (bHit && Projectile != nullptr)
+	{
+		Projectile->DispatchBlockingHit(UpdatedPrimitive, Hit.GetComponent(), true, Hit);
+	}
+
+	if (OutHit != nullptr)
+	{
+		*OutHit = Hit;
+	}
+	return true;
+}
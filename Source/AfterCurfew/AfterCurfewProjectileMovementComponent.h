@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "AfterCurfewProjectileMovementComponent.generated.h"
+
+class AAfterCurfewSpatialHash;
+
+/**
+ * Projectile movement of the actor backend.
+ * Sweeps against the world's spatial hash rather than the physics scene while ac.Projectile.SpatialHash is on, then
+ * moves without a sweep and hands the hit to the projectile as the scene sweep would have.
+ * Counts the sweeps it issues into GAfterCurfewCounters, so both backends report their sweeps the same way.
+ */
+UCLASS(ClassGroup = (AfterCurfew))
+class AFTERCURFEW_API UAfterCurfewProjectileMovementComponent : public UProjectileMovementComponent
+{
+	GENERATED_BODY()
+
+protected:
+	// Begin MovementComponent Interface
+	virtual bool MoveUpdatedComponentImpl(const FVector& Delta, const FQuat& NewRotation, bool bSweep, FHitResult* OutHit = nullptr, ETeleportType Teleport = ETeleportType::None) override;
+	// End MovementComponent Interface
+
+private:
+	/** Hash our sweeps go through, cached on the first one */
+	TWeakObjectPtr<AAfterCurfewSpatialHash> SpatialHash;
+};
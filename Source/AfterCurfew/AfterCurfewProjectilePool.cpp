@@ -0,0 +1,194 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewProjectilePool.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewProjectile.h"
+#include "AfterCurfewWorldManager.h"
+#include "Engine/World.h"
+#include "Components/StaticMeshComponent.h"
+
+DECLARE_CYCLE_STAT(TEXT("Projectile Pool Acquire"), STAT_AfterCurfewPoolAcquire, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Projectile Pool Release"), STAT_AfterCurfewPoolRelease, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Projectile Pool Grow"), STAT_AfterCurfewPoolGrow, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Projectiles"), STAT_AfterCurfewPoolSize, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Active Projectiles"), STAT_AfterCurfewPoolActive, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Projectile Pool High-Water Mark"), STAT_AfterCurfewPoolHighWater, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Projectile Pool Recycles"), STAT_AfterCurfewPoolRecycled, STATGROUP_AfterCurfew);
+
+AAfterCurfewProjectilePool::AAfterCurfewProjectilePool()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	PrewarmSize = 64;
+	GrowthPolicy = EAfterCurfewPoolGrowth::Linear;
+	GrowthStep = 32;
+	MaxPoolSize = 1024;
+
+	AcquireSerial = 0;
+	HighWaterMark = 0;
+	NumGrowths = 0;
+	NumRecycled = 0;
+}
+
+AAfterCurfewProjectilePool* AAfterCurfewProjectilePool::Get(UWorld* World)
+{
+	return FindOrSpawnWorldManager<AAfterCurfewProjectilePool>(World);
+}
+
+void AAfterCurfewProjectilePool::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Grow(FMath::Min(PrewarmSize, MaxPoolSize));
+	NumGrowths = 0;
+}
+
+void AAfterCurfewProjectilePool::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UE_LOG(LogAfterCurfew, Log, TEXT("Projectile pool: %d pooled, high-water mark %d, grew %d times, recycled %d"), Projectiles.Num(), HighWaterMark, NumGrowths, NumRecycled);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+AAfterCurfewProjectile* AAfterCurfewProjectilePool::Acquire(const FTransform& SpawnTransform, float InitialSpeed, float MaxSpeed, AActor* ProjectileOwner, UStaticMesh* Mesh)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewPoolAcquire);
+
+	if (FreeProjectiles.Num() == 0)
+	{
+		int32 NumToAdd = 0;
+		switch (GrowthPolicy)
+		{
+		case EAfterCurfewPoolGrowth::Linear:
+			NumToAdd = GrowthStep;
+			break;
+		case EAfterCurfewPoolGrowth::Double:
+			NumToAdd = FMath::Max(Projectiles.Num(), 1);
+			break;
+		default:
+			break;
+		}
+
+		NumToAdd = FMath::Min(NumToAdd, MaxPoolSize - Projectiles.Num());
+		if (NumToAdd > 0 && Grow(NumToAdd) > 0)
+		{
+			++NumGrowths;
+		}
+		else
+		{
+			RecycleOldest();
+		}
+	}
+
+	AAfterCurfewProjectile* Projectile = FreeProjectiles.Num() > 0 ? FreeProjectiles.Pop(false) : nullptr;
+	if (Projectile == nullptr)
+	{
+		return nullptr;
+	}
+
+	// Projectiles are shared between weapons, only swap the mesh when it changes
+	if (Mesh != nullptr && Projectile->GetProjectileMesh()->GetStaticMesh() != Mesh)
+	{
+		Projectile->GetProjectileMesh()->SetStaticMesh(Mesh);
+	}
+
+	Projectile->SetOwner(ProjectileOwner);
+	Projectile->SetActorTransform(SpawnTransform, false, nullptr, ETeleportType::TeleportPhysics);
+	Projectile->PoolSerial = ++AcquireSerial;
+	Projectile->Initialize(InitialSpeed, MaxSpeed);
+	Projectile->SetPooledActive(true);
+	++GAfterCurfewCounters.ProjectilesSpawned;
+
+	HighWaterMark = FMath::Max(HighWaterMark, GetNumActive());
+	UpdateStats();
+
+	return Projectile;
+}
+
+void AAfterCurfewProjectilePool::Release(AAfterCurfewProjectile* Projectile)
+{
+	// Hit and lifespan expiry can both land in the same frame, only the first one counts
+	if (Projectile == nullptr || !Projectile->IsPooledActive())
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewPoolRelease);
+
+	Projectile->SetPooledActive(false);
+	Projectile->SetOwner(nullptr);
+	FreeProjectiles.Push(Projectile);
+	++GAfterCurfewCounters.ProjectilesReleased;
+
+	UpdateStats();
+}
+
+int32 AAfterCurfewProjectilePool::Grow(int32 Count)
+{
+	UWorld* const World = GetWorld();
+	if (World == nullptr || Count <= 0)
+	{
+		return 0;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewPoolGrow);
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Owner = this;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	const FTransform PoolTransform = GetActorTransform();
+
+	int32 NumAdded = 0;
+	Projectiles.Reserve(Projectiles.Num() + Count);
+	FreeProjectiles.Reserve(Projectiles.Num() + Count);
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		AAfterCurfewProjectile* Projectile = World->SpawnActor<AAfterCurfewProjectile>(AAfterCurfewProjectile::StaticClass(), PoolTransform, SpawnParams);
+		if (Projectile == nullptr)
+		{
+			break;
+		}
+
+		Projectile->OwningPool = this;
+		Projectile->SetPooledActive(false);
+		Projectile->SetOwner(nullptr);
+
+		Projectiles.Add(Projectile);
+		FreeProjectiles.Add(Projectile);
+		++NumAdded;
+	}
+
+	UpdateStats();
+	return NumAdded;
+}
+
+AAfterCurfewProjectile* AAfterCurfewProjectilePool::RecycleOldest()
+{
+	AAfterCurfewProjectile* Oldest = nullptr;
+	for (AAfterCurfewProjectile* Projectile : Projectiles)
+	{
+		if (Projectile != nullptr && Projectile->IsPooledActive() && (Oldest == nullptr || Projectile->PoolSerial < Oldest->PoolSerial))
+		{
+			Oldest = Projectile;
+		}
+	}
+
+	if (Oldest != nullptr)
+	{
+		Release(Oldest);
+		++NumRecycled;
+	}
+	return Oldest;
+}
+
+void AAfterCurfewProjectilePool::UpdateStats() const
+{
+	SET_DWORD_STAT(STAT_AfterCurfewPoolSize, Projectiles.Num());
+	SET_DWORD_STAT(STAT_AfterCurfewPoolActive, GetNumActive());
+	SET_DWORD_STAT(STAT_AfterCurfewPoolHighWater, HighWaterMark);
+	SET_DWORD_STAT(STAT_AfterCurfewPoolRecycled, NumRecycled);
+	SET_DWORD_STAT(STAT_AfterCurfewProjectilesInFlight, GAfterCurfewCounters.GetProjectilesAlive());
+}
@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "AfterCurfewProjectilePool.generated.h"
+
+class AAfterCurfewProjectile;
+class UStaticMesh;
+
+/** How the projectile pool reacts when every pooled projectile is in flight */
+UENUM()
+enum class EAfterCurfewPoolGrowth : uint8
+{
+	/** Never grow past the pre-warmed size, recycle the oldest live projectile instead */
+	None,
+	/** Grow by GrowthStep projectiles at a time */
+	Linear,
+	/** Double the size of the pool */
+	Double,
+};
+
+/**
+ * Owns a set of pre-warmed projectiles for one world so that firing does not spawn and destroy actors.
+ * Projectiles are handed out with Acquire and come back through Release when they hit something or expire.
+ */
+UCLASS(config=Game, notplaceable)
+class AFTERCURFEW_API AAfterCurfewProjectilePool : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewProjectilePool();
+
+	/** Returns the pool for this world, creating and pre-warming it on first use */
+	static AAfterCurfewProjectilePool* Get(UWorld* World);
+
+	/** Hands out a projectile placed at SpawnTransform and already moving, or nullptr if none could be provided */
+	AAfterCurfewProjectile* Acquire(const FTransform& SpawnTransform, float InitialSpeed, float MaxSpeed, AActor* ProjectileOwner, UStaticMesh* Mesh = nullptr);
+
+	/** Returns a projectile to the pool, hiding it and stopping its movement */
+	void Release(AAfterCurfewProjectile* Projectile);
+
+	/** Number of projectiles owned by the pool, in flight or not */
+	int32 GetPoolSize() const { return Projectiles.Num(); }
+
+	/** Number of projectiles currently in flight */
+	int32 GetNumActive() const { return Projectiles.Num() - FreeProjectiles.Num(); }
+
+	/** Every projectile owned by the pool, in flight or not */
+	const TArray<AAfterCurfewProjectile*>& GetProjectiles() const { return Projectiles; }
+
+	/** Highest number of projectiles that were in flight at the same time */
+	int32 GetHighWaterMark() const { return HighWaterMark; }
+
+	/** Number of projectiles spawned when the pool starts */
+	UPROPERTY(Category = Pool, EditAnywhere, config)
+	int32 PrewarmSize;
+
+	/** What to do when every projectile is in flight */
+	UPROPERTY(Category = Pool, EditAnywhere, config)
+	EAfterCurfewPoolGrowth GrowthPolicy;
+
+	/** How many projectiles to add at a time with the Linear growth policy */
+	UPROPERTY(Category = Pool, EditAnywhere, config)
+	int32 GrowthStep;
+
+	/** Hard limit on the pool size, past this the oldest live projectile is recycled */
+	UPROPERTY(Category = Pool, EditAnywhere, config)
+	int32 MaxPoolSize;
+
+protected:
+	// Begin Actor Interface
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	// End Actor Interface
+
+private:
+	/** Spawns Count new inactive projectiles, returns how many were added */
+	int32 Grow(int32 Count);
+
+	/** Pulls the longest-flying projectile out of the air so it can be reused */
+	AAfterCurfewProjectile* RecycleOldest();
+
+	void UpdateStats() const;
+
+	/** Every projectile owned by the pool, keeps them referenced */
+	UPROPERTY(Transient)
+	TArray<AAfterCurfewProjectile*> Projectiles;
+
+	/** Projectiles that are waiting to be fired */
+	UPROPERTY(Transient)
+	TArray<AAfterCurfewProjectile*> FreeProjectiles;
+
+	/** Incremented on every acquire, used to find the oldest live projectile */
+	uint32 AcquireSerial;
+
+	int32 HighWaterMark;
+
+	int32 NumGrowths;
+
+	int32 NumRecycled;
+};
@@ -0,0 +1,263 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewReplayComponent.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewPawn.h"
+#include "AfterCurfewWeaponComponent.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace AfterCurfewReplay
+{
+	/** "ACRP" */
+	static const uint32 Magic = 0x50524341;
+	static const uint32 Version = 1;
+}
+
+UAfterCurfewReplayComponent::UAfterCurfewReplayComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	Mode = EAfterCurfewReplayMode::None;
+	FlushInterval = 64;
+
+	NumUnflushed = 0;
+	FillBufferIndex = 0;
+	PlaybackOffset = 0;
+	PreviousFixedDeltaTime = 0.0;
+	bPreviousUseFixedTimeStep = false;
+	bStarted = false;
+}
+
+void UAfterCurfewReplayComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (Mode == EAfterCurfewReplayMode::Record)
+	{
+		StopRecording();
+	}
+	else if (Mode == EAfterCurfewReplayMode::Playback)
+	{
+		StopPlayback();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UAfterCurfewReplayComponent::Start()
+{
+	bStarted = true;
+
+	// Command line switches only apply to the local player's pawn
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	if (Mode == EAfterCurfewReplayMode::None && Pawn != nullptr && Pawn->IsLocallyControlled() && Pawn->IsPlayerControlled())
+	{
+		const TCHAR* CommandLine = FCommandLine::Get();
+		if (FParse::Value(CommandLine, TEXT("ACPlay="), ReplayFile))
+		{
+			Mode = EAfterCurfewReplayMode::Playback;
+		}
+		else if (FParse::Value(CommandLine, TEXT("ACRecord="), ReplayFile) || FParse::Param(CommandLine, TEXT("ACRecord")))
+		{
+			Mode = EAfterCurfewReplayMode::Record;
+		}
+	}
+
+	const bool bOpened = Mode == EAfterCurfewReplayMode::Record ? StartRecording() : Mode == EAfterCurfewReplayMode::Playback ? StartPlayback() : true;
+	if (!bOpened)
+	{
+		Mode = EAfterCurfewReplayMode::None;
+	}
+}
+
+bool UAfterCurfewReplayComponent::StartRecording()
+{
+	AAfterCurfewPawn* Pawn = Cast<AAfterCurfewPawn>(GetOwner());
+	if (Pawn == nullptr)
+	{
+		return false;
+	}
+
+	if (ReplayFile.IsEmpty())
+	{
+		ReplayFile = FPaths::ProjectSavedDir() / TEXT("Replays") / FString::Printf(TEXT("AfterCurfew-%s.acreplay"), *FDateTime::Now().ToString());
+	}
+
+	FileWriter.Reset(IFileManager::Get().CreateFileWriter(*ReplayFile));
+	if (!FileWriter.IsValid())
+	{
+		UE_LOG(LogAfterCurfew, Warning, TEXT("Replay: could not open %s for recording"), *ReplayFile);
+		return false;
+	}
+
+	uint32 Magic = AfterCurfewReplay::Magic;
+	uint32 Version = AfterCurfewReplay::Version;
+	int32 WeaponSeed = Pawn->GetWeaponComponent()->GetWeaponSeed();
+	FVector Location = Pawn->GetActorLocation();
+	float Yaw = Pawn->GetActorRotation().Yaw;
+	*FileWriter << Magic << Version << WeaponSeed << Location << Yaw;
+
+	// Reserved up front so recording does not allocate
+	for (TArray<uint8>& Buffer : WriteBuffers)
+	{
+		Buffer.Reserve(FlushInterval * sizeof(FAfterCurfewInputCommand));
+	}
+	NumUnflushed = 0;
+
+	UE_LOG(LogAfterCurfew, Log, TEXT("Replay: recording to %s"), *ReplayFile);
+	return true;
+}
+
+void UAfterCurfewReplayComponent::StopRecording()
+{
+	FlushCommands();
+	if (PendingWrite.IsValid())
+	{
+		PendingWrite.Wait();
+	}
+
+	if (FileWriter.IsValid())
+	{
+		UE_LOG(LogAfterCurfew, Log, TEXT("Replay: recorded %lld bytes to %s"), FileWriter->TotalSize(), *ReplayFile);
+		FileWriter->Close();
+		FileWriter.Reset();
+	}
+	Mode = EAfterCurfewReplayMode::None;
+}
+
+bool UAfterCurfewReplayComponent::StartPlayback()
+{
+	AAfterCurfewPawn* Pawn = Cast<AAfterCurfewPawn>(GetOwner());
+	if (Pawn == nullptr)
+	{
+		return false;
+	}
+
+	if (!FFileHelper::LoadFileToArray(PlaybackData, *ReplayFile))
+	{
+		UE_LOG(LogAfterCurfew, Warning, TEXT("Replay: could not read %s"), *ReplayFile);
+		return false;
+	}
+
+	FMemoryReader Reader(PlaybackData);
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	int32 WeaponSeed = 0;
+	FVector Location = FVector::ZeroVector;
+	float Yaw = 0.f;
+	Reader << Magic << Version << WeaponSeed << Location << Yaw;
+	if (Reader.IsError() || Magic != AfterCurfewReplay::Magic || Version != AfterCurfewReplay::Version)
+	{
+		UE_LOG(LogAfterCurfew, Warning, TEXT("Replay: %s is not a version %u replay"), *ReplayFile, AfterCurfewReplay::Version);
+		PlaybackData.Empty();
+		return false;
+	}
+	PlaybackOffset = Reader.Tell();
+
+	// Put the pawn back where the recording started, with the same weapon stream
+	Pawn->SetActorLocationAndRotation(Location, FRotator(0.f, Yaw, 0.f), false, nullptr, ETeleportType::TeleportPhysics);
+	Pawn->GetMovementComponent()->StopMovementImmediately();
+	Pawn->GetWeaponComponent()->SetWeaponSeed(WeaponSeed);
+
+	// Frame N + 1 is stepped with the delta time set while processing frame N
+	PreviousFixedDeltaTime = FApp::GetFixedDeltaTime();
+	bPreviousUseFixedTimeStep = FApp::UseFixedTimeStep();
+	FApp::SetUseFixedTimeStep(true);
+
+	UE_LOG(LogAfterCurfew, Log, TEXT("Replay: playing back %lld commands from %s"), (PlaybackData.Num() - PlaybackOffset) / int64(sizeof(FAfterCurfewInputCommand)), *ReplayFile);
+	return true;
+}
+
+void UAfterCurfewReplayComponent::StopPlayback()
+{
+	// Only a started playback took over the time step
+	if (PlaybackData.Num() > 0)
+	{
+		FApp::SetFixedDeltaTime(PreviousFixedDeltaTime);
+		FApp::SetUseFixedTimeStep(bPreviousUseFixedTimeStep);
+	}
+	PlaybackData.Empty();
+	PlaybackOffset = 0;
+	Mode = EAfterCurfewReplayMode::None;
+}
+
+void UAfterCurfewReplayComponent::ProcessCommand(FAfterCurfewInputCommand& Command)
+{
+	if (!bStarted)
+	{
+		Start();
+	}
+
+	if (Mode == EAfterCurfewReplayMode::Playback)
+	{
+		const int64 CommandSize = sizeof(FAfterCurfewInputCommand);
+		if (PlaybackOffset + CommandSize <= PlaybackData.Num())
+		{
+			FMemoryReader Reader(PlaybackData);
+			Reader.Seek(PlaybackOffset);
+			Reader << Command;
+			PlaybackOffset = Reader.Tell();
+
+			if (PlaybackOffset + CommandSize <= PlaybackData.Num())
+			{
+				FAfterCurfewInputCommand NextCommand;
+				Reader << NextCommand;
+				FApp::SetFixedDeltaTime(NextCommand.GetDeltaTime());
+			}
+		}
+		else
+		{
+			UE_LOG(LogAfterCurfew, Log, TEXT("Replay: finished %s"), *ReplayFile);
+			StopPlayback();
+			Command.MoveForward = Command.MoveRight = Command.LiftUp = 0;
+			Command.Buttons = 0;
+		}
+	}
+
+	RecentCommands.Push(Command);
+
+	if (Mode == EAfterCurfewReplayMode::Record && ++NumUnflushed >= FlushInterval)
+	{
+		FlushCommands();
+	}
+}
+
+void UAfterCurfewReplayComponent::FlushCommands()
+{
+	if (NumUnflushed == 0 || !FileWriter.IsValid())
+	{
+		return;
+	}
+
+	TArray<uint8>& Buffer = WriteBuffers[FillBufferIndex];
+	Buffer.Reset();
+
+	FMemoryWriter Writer(Buffer);
+	for (int32 Index = RecentCommands.Num() - NumUnflushed; Index < RecentCommands.Num(); ++Index)
+	{
+		FAfterCurfewInputCommand Command = RecentCommands[Index];
+		Writer << Command;
+	}
+	NumUnflushed = 0;
+
+	// Writes go out in order, one at a time, and the other buffer is only refilled once its write is done
+	if (PendingWrite.IsValid())
+	{
+		PendingWrite.Wait();
+	}
+
+	FArchive* const Archive = FileWriter.Get();
+	PendingWrite = Async<void>(EAsyncExecution::ThreadPool, [Archive, &Buffer]()
+	{
+		Archive->Serialize(Buffer.GetData(), Buffer.Num());
+	});
+
+	FillBufferIndex ^= 1;
+}
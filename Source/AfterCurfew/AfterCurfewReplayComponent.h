@@ -0,0 +1,155 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Async/Future.h"
+#include "AfterCurfewRingBuffer.h"
+#include "AfterCurfewReplayComponent.generated.h"
+
+/** One frame of pawn input, quantized to 8 bytes */
+struct FAfterCurfewInputCommand
+{
+	/** Button bits */
+	static const uint8 FireButton = 1 << 0;
+
+	/** Frame delta time in 100 microsecond units */
+	uint16 DeltaTime;
+
+	/** Aim yaw compressed with FRotator::CompressAxisToShort */
+	uint16 AimYaw;
+
+	/** Axis values scaled to -127..127 */
+	int8 MoveForward;
+	int8 MoveRight;
+	int8 LiftUp;
+
+	uint8 Buttons;
+
+	FAfterCurfewInputCommand()
+		: DeltaTime(0)
+		, AimYaw(0)
+		, MoveForward(0)
+		, MoveRight(0)
+		, LiftUp(0)
+		, Buttons(0)
+	{
+	}
+
+	FORCEINLINE static int8 QuantizeAxis(float Value) { return int8(FMath::RoundToInt(FMath::Clamp(Value, -1.f, 1.f) * 127.f)); }
+	FORCEINLINE static float DequantizeAxis(int8 Value) { return Value / 127.f; }
+
+	FORCEINLINE void SetDeltaTime(float Seconds) { DeltaTime = uint16(FMath::Clamp(FMath::RoundToInt(Seconds * 10000.f), 1, int32(MAX_uint16))); }
+	FORCEINLINE float GetDeltaTime() const { return DeltaTime / 10000.f; }
+
+	FORCEINLINE void SetAimYaw(float Yaw) { AimYaw = FRotator::CompressAxisToShort(Yaw); }
+	FORCEINLINE float GetAimYaw() const { return FRotator::NormalizeAxis(FRotator::DecompressAxisFromShort(AimYaw)); }
+
+	FORCEINLINE bool IsFiring() const { return (Buttons & FireButton) != 0; }
+
+	friend FArchive& operator<<(FArchive& Ar, FAfterCurfewInputCommand& Command)
+	{
+		Ar << Command.DeltaTime;
+		Ar << Command.AimYaw;
+		Ar << Command.MoveForward;
+		Ar << Command.MoveRight;
+		Ar << Command.LiftUp;
+		Ar << Command.Buttons;
+		return Ar;
+	}
+};
+
+/** What a replay component does with its pawn's input */
+UENUM()
+enum class EAfterCurfewReplayMode : uint8
+{
+	/** Keep the recent commands in memory only */
+	None,
+	/** Stream every command to ReplayFile */
+	Record,
+	/** Replace the pawn's input with the commands read from ReplayFile */
+	Playback,
+};
+
+/**
+ * Captures a pawn's per-frame input commands and records them to, or plays them back from, a replay file.
+ * The last few hundred commands are always kept in an allocation-free ring buffer. While recording they are encoded
+ * into one of two buffers every FlushInterval frames and written out on the thread pool while the other buffer fills.
+ *
+ * A player pawn records with -ACRecord (or -ACRecord=<file>) and plays back with -ACPlay=<file>. The mode is picked on
+ * the first command rather than on BeginPlay because player pawns are possessed after they begin play.
+ * A replay file holds a header with the pawn's start transform and weapon seed followed by one command per frame,
+ * playback also steps the world with the recorded frame times.
+ */
+UCLASS(ClassGroup = (AfterCurfew), meta = (BlueprintSpawnableComponent))
+class AFTERCURFEW_API UAfterCurfewReplayComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UAfterCurfewReplayComponent();
+
+	// Begin ActorComponent Interface
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	// End ActorComponent Interface
+
+	/** Records this frame's Command, or replaces it with the recorded one during playback */
+	void ProcessCommand(FAfterCurfewInputCommand& Command);
+
+	FORCEINLINE bool IsPlayingBack() const { return Mode == EAfterCurfewReplayMode::Playback; }
+
+	/** Commands kept in memory */
+	typedef TAfterCurfewRingBuffer<FAfterCurfewInputCommand, 512> FRecentCommands;
+
+	/** Returns the most recent commands, oldest first */
+	FORCEINLINE const FRecentCommands& GetRecentCommands() const { return RecentCommands; }
+
+	UPROPERTY(Category = Replay, EditAnywhere)
+	EAfterCurfewReplayMode Mode;
+
+	/** File recorded to or played back from, recordings default to Saved/Replays */
+	UPROPERTY(Category = Replay, EditAnywhere)
+	FString ReplayFile;
+
+	/** Frames between writes while recording */
+	UPROPERTY(Category = Replay, EditAnywhere, meta = (ClampMin = "1", ClampMax = "256"))
+	int32 FlushInterval;
+
+private:
+	/** Picks the mode from the command line for player pawns and opens the replay file, on the first command */
+	void Start();
+
+	bool StartRecording();
+	bool StartPlayback();
+	void StopRecording();
+	void StopPlayback();
+
+	/** Encodes the commands not yet written and hands them to the thread pool */
+	void FlushCommands();
+
+	FRecentCommands RecentCommands;
+
+	/** Commands at the end of RecentCommands that have not been written yet */
+	int32 NumUnflushed;
+
+	TUniquePtr<FArchive> FileWriter;
+
+	/** Encoded commands, one is written while the other fills */
+	TArray<uint8> WriteBuffers[2];
+	int32 FillBufferIndex;
+
+	/** Write of the other buffer, waited on before it is reused */
+	TFuture<void> PendingWrite;
+
+	/** Whole replay read on start, and how far playback got through it */
+	TArray<uint8> PlaybackData;
+	int64 PlaybackOffset;
+
+	/** Engine time step before playback took it over, put back when playback stops, e.g. the benchmark's fixed step */
+	double PreviousFixedDeltaTime;
+	uint32 bPreviousUseFixedTimeStep : 1;
+
+	/** Flag set once Start has run */
+	uint32 bStarted : 1;
+};
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Fixed capacity ring buffer with inline storage, it never allocates.
+ * Pushing into a full buffer overwrites the oldest element. Elements are indexed oldest first.
+ * Capacity must be a power of two so wrapping is a mask.
+ */
+template<typename ElementType, int32 Capacity>
+class TAfterCurfewRingBuffer
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Ring buffer capacity must be a power of two");
+
+public:
+	TAfterCurfewRingBuffer()
+		: Head(0)
+		, Count(0)
+	{
+	}
+
+	/** Appends Element, dropping the oldest one if the buffer is full */
+	FORCEINLINE void Push(const ElementType& Element)
+	{
+		Elements[Head] = Element;
+		Head = (Head + 1) & (Capacity - 1);
+		Count = FMath::Min(Count + 1, Capacity);
+	}
+
+	/** Drops the Num oldest elements */
+	FORCEINLINE void PopOldest(int32 Num)
+	{
+		Count -= FMath::Clamp(Num, 0, Count);
+	}
+
+	FORCEINLINE void Reset()
+	{
+		Head = 0;
+		Count = 0;
+	}
+
+	FORCEINLINE int32 Num() const { return Count; }
+	FORCEINLINE bool IsEmpty() const { return Count == 0; }
+	FORCEINLINE bool IsFull() const { return Count == Capacity; }
+	static constexpr int32 Max() { return Capacity; }
+
+	/** Returns the element Index places after the oldest one */
+	FORCEINLINE ElementType& operator[](int32 Index)
+	{
+		checkSlow(Index >= 0 && Index < Count);
+		return Elements[(Head - Count + Index) & (Capacity - 1)];
+	}
+
+	FORCEINLINE const ElementType& operator[](int32 Index) const
+	{
+		checkSlow(Index >= 0 && Index < Count);
+		return Elements[(Head - Count + Index) & (Capacity - 1)];
+	}
+
+	/** Returns the most recently pushed element */
+	FORCEINLINE ElementType& Last()
+	{
+		check(Count > 0);
+		return Elements[(Head - 1) & (Capacity - 1)];
+	}
+
+	FORCEINLINE const ElementType& Last() const
+	{
+		check(Count > 0);
+		return Elements[(Head - 1) & (Capacity - 1)];
+	}
+
+private:
+	ElementType Elements[Capacity];
+
+	/** Slot the next element is written to */
+	int32 Head;
+
+	int32 Count;
+};
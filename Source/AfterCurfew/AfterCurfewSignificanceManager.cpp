@@ -0,0 +1,220 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewSignificanceManager.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewPawn.h"
+#include "AfterCurfewProjectile.h"
+#include "AfterCurfewProjectilePool.h"
+#include "AfterCurfewWorldManager.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "Misc/App.h"
+
+DECLARE_CYCLE_STAT(TEXT("Significance Update"), STAT_AfterCurfewSignificance, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Full Rate Pawns"), STAT_AfterCurfewFullRatePawns, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Throttled Pawns"), STAT_AfterCurfewThrottledPawns, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Throttled Projectiles"), STAT_AfterCurfewThrottledProjectiles, STATGROUP_AfterCurfew);
+
+/** How long ago an actor may have been drawn and still count as on screen */
+static const float RecentlyRenderedTolerance = 0.2f;
+
+AAfterCurfewSignificanceManager::AAfterCurfewSignificanceManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	MaxFullRatePawns = 32;
+	UpdateInterval = 0.25f;
+
+	bCanCheckRendered = false;
+}
+
+AAfterCurfewSignificanceManager* AAfterCurfewSignificanceManager::Get(UWorld* World)
+{
+	if (World == nullptr || World->GetNetMode() == NM_DedicatedServer)
+	{
+		return nullptr;
+	}
+	return FindOrSpawnWorldManager<AAfterCurfewSignificanceManager>(World);
+}
+
+void AAfterCurfewSignificanceManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Tiers.Sort([](const FAfterCurfewSignificanceTier& A, const FAfterCurfewSignificanceTier& B) { return A.MaxDistance < B.MaxDistance; });
+
+	SetActorTickInterval(UpdateInterval);
+	bCanCheckRendered = FApp::CanEverRender();
+}
+
+void AAfterCurfewSignificanceManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	for (FPawnEntry& Entry : Pawns)
+	{
+		ApplyPawnTier(Entry, INDEX_NONE);
+	}
+	Pawns.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AAfterCurfewSignificanceManager::RegisterPawn(AAfterCurfewPawn* Pawn)
+{
+	if (Pawn != nullptr && !Pawns.ContainsByPredicate([Pawn](const FPawnEntry& Entry) { return Entry.Pawn == Pawn; }))
+	{
+		FPawnEntry& Entry = Pawns[Pawns.AddUninitialized()];
+		Entry.Pawn = Pawn;
+		Entry.Tier = INDEX_NONE;
+		Entry.DistanceSquared = 0.f;
+	}
+}
+
+void AAfterCurfewSignificanceManager::UnregisterPawn(AAfterCurfewPawn* Pawn)
+{
+	const int32 Index = Pawns.IndexOfByPredicate([Pawn](const FPawnEntry& Entry) { return Entry.Pawn == Pawn; });
+	if (Index != INDEX_NONE)
+	{
+		ApplyPawnTier(Pawns[Index], INDEX_NONE);
+		Pawns.RemoveAtSwap(Index, 1, false);
+	}
+}
+
+int32 AAfterCurfewSignificanceManager::FindTier(float DistanceSquared, bool bVisible) const
+{
+	int32 Tier = 0;
+	while (Tier < Tiers.Num() - 1 && DistanceSquared > FMath::Square(Tiers[Tier].MaxDistance))
+	{
+		++Tier;
+	}
+
+	// Off-screen actors are only heard and seen from far less than their distance suggests
+	if (!bVisible)
+	{
+		Tier = FMath::Min(Tier + 1, Tiers.Num() - 1);
+	}
+	return Tier;
+}
+
+void AAfterCurfewSignificanceManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewSignificance);
+
+	APlayerController* const PlayerController = GetWorld()->GetFirstPlayerController();
+	if (PlayerController == nullptr || Tiers.Num() == 0)
+	{
+		return;
+	}
+
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+	UpdatePawns(ViewLocation);
+	UpdateProjectiles(ViewLocation);
+}
+
+void AAfterCurfewSignificanceManager::UpdatePawns(const FVector& ViewLocation)
+{
+	Pawns.RemoveAllSwap([](const FPawnEntry& Entry) { return !Entry.Pawn.IsValid(); }, false);
+	FullRateCandidates.Reset();
+
+	int32 NumThrottled = 0;
+	for (int32 Index = 0; Index < Pawns.Num(); ++Index)
+	{
+		FPawnEntry& Entry = Pawns[Index];
+		AAfterCurfewPawn* Pawn = Entry.Pawn.Get();
+
+		// Player input and server moves arrive every frame, so player pawns are never throttled
+		if (Pawn->IsPlayerControlled())
+		{
+			ApplyPawnTier(Entry, INDEX_NONE);
+			continue;
+		}
+
+		Entry.DistanceSquared = FVector::DistSquared(Pawn->GetActorLocation(), ViewLocation);
+		const bool bVisible = !bCanCheckRendered || Pawn->WasRecentlyRendered(RecentlyRenderedTolerance);
+		const int32 Tier = FindTier(Entry.DistanceSquared, bVisible);
+		if (Tier == 0)
+		{
+			FullRateCandidates.Add(Index);
+		}
+		else
+		{
+			ApplyPawnTier(Entry, Tier);
+			++NumThrottled;
+		}
+	}
+
+	// Over budget, the farthest first tier pawns drop to the second tier
+	if (FullRateCandidates.Num() > MaxFullRatePawns)
+	{
+		FullRateCandidates.Sort([this](int32 A, int32 B) { return Pawns[A].DistanceSquared < Pawns[B].DistanceSquared; });
+	}
+	for (int32 Rank = 0; Rank < FullRateCandidates.Num(); ++Rank)
+	{
+		const bool bOverBudget = Rank >= MaxFullRatePawns && Tiers.Num() > 1;
+		ApplyPawnTier(Pawns[FullRateCandidates[Rank]], bOverBudget ? 1 : 0);
+		NumThrottled += bOverBudget ? 1 : 0;
+	}
+
+	SET_DWORD_STAT(STAT_AfterCurfewFullRatePawns, Pawns.Num() - NumThrottled);
+	SET_DWORD_STAT(STAT_AfterCurfewThrottledPawns, NumThrottled);
+}
+
+void AAfterCurfewSignificanceManager::UpdateProjectiles(const FVector& ViewLocation)
+{
+	if (!ProjectilePool.IsValid())
+	{
+		ProjectilePool = AAfterCurfewProjectilePool::Get(GetWorld());
+		if (!ProjectilePool.IsValid())
+		{
+			return;
+		}
+	}
+
+	int32 NumThrottled = 0;
+	for (AAfterCurfewProjectile* Projectile : ProjectilePool->GetProjectiles())
+	{
+		if (Projectile == nullptr || !Projectile->IsPooledActive())
+		{
+			continue;
+		}
+
+		// Projectiles are too small and quick to be worth a render check
+		const float DistanceSquared = FVector::DistSquared(Projectile->GetActorLocation(), ViewLocation);
+		const float TickInterval = Tiers[FindTier(DistanceSquared, true)].ProjectileTickInterval;
+
+		UProjectileMovementComponent* ProjectileMovement = Projectile->GetProjectileMovement();
+		if (ProjectileMovement->GetComponentTickInterval() != TickInterval)
+		{
+			ProjectileMovement->SetComponentTickInterval(TickInterval);
+		}
+		NumThrottled += TickInterval > 0.f ? 1 : 0;
+	}
+
+	SET_DWORD_STAT(STAT_AfterCurfewThrottledProjectiles, NumThrottled);
+}
+
+void AAfterCurfewSignificanceManager::ApplyPawnTier(FPawnEntry& Entry, int32 Tier) const
+{
+	AAfterCurfewPawn* Pawn = Entry.Pawn.Get();
+	if (Pawn == nullptr || Entry.Tier == Tier)
+	{
+		return;
+	}
+	Entry.Tier = Tier;
+
+	if (Tiers.IsValidIndex(Tier))
+	{
+		Pawn->SetSignificance(Tiers[Tier].PawnTickInterval, Tiers[Tier].bCosmetics);
+	}
+	else
+	{
+		Pawn->SetSignificance(0.f, true);
+	}
+}
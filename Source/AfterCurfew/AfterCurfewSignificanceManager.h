@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "AfterCurfewSignificanceManager.generated.h"
+
+class AAfterCurfewPawn;
+class AAfterCurfewProjectilePool;
+
+/** How much work an actor at a given distance from the view gets */
+USTRUCT()
+struct FAfterCurfewSignificanceTier
+{
+	GENERATED_BODY()
+
+	/** Actors closer to the view than this fall in this tier */
+	UPROPERTY(Category = Significance, EditAnywhere)
+	float MaxDistance;
+
+	/** Seconds between pawn ticks, 0 ticks every frame */
+	UPROPERTY(Category = Significance, EditAnywhere)
+	float PawnTickInterval;
+
+	/** Seconds between projectile movement updates, 0 updates every frame */
+	UPROPERTY(Category = Significance, EditAnywhere)
+	float ProjectileTickInterval;
+
+	/** Whether fire sounds and debug drawing run in this tier */
+	UPROPERTY(Category = Significance, EditAnywhere)
+	bool bCosmetics;
+
+	FAfterCurfewSignificanceTier()
+		: MaxDistance(0.f)
+		, PawnTickInterval(0.f)
+		, ProjectileTickInterval(0.f)
+		, bCosmetics(true)
+	{
+	}
+};
+
+/**
+ * Throttles pawns and projectiles far from the local view.
+ * A few times a second every registered pawn and pooled projectile is put in a tier by its distance to the local
+ * player's view, one tier further out when it was not rendered recently, and the tier sets its tick interval and
+ * whether it plays cosmetics. Only MaxFullRatePawns pawns may be in the first tier, the farthest ones are pushed out.
+ * Pawns driven by a local or remote player always run at full rate, and a dedicated server has no view so it
+ * never throttles anything.
+ */
+UCLASS(config=Game, notplaceable)
+class AFTERCURFEW_API AAfterCurfewSignificanceManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewSignificanceManager();
+
+	/** Returns the significance manager for this world, creating it on first use, or nullptr on a dedicated server */
+	static AAfterCurfewSignificanceManager* Get(UWorld* World);
+
+	// Begin Actor Interface
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+	// End Actor Interface
+
+	void RegisterPawn(AAfterCurfewPawn* Pawn);
+
+	/** Stops throttling Pawn and puts it back at full rate */
+	void UnregisterPawn(AAfterCurfewPawn* Pawn);
+
+	/** Tiers ordered by increasing MaxDistance, actors beyond the last one use the last one */
+	UPROPERTY(Category = Significance, EditAnywhere, config)
+	TArray<FAfterCurfewSignificanceTier> Tiers;
+
+	/** Most pawns allowed in the first tier */
+	UPROPERTY(Category = Significance, EditAnywhere, config, meta = (ClampMin = "0"))
+	int32 MaxFullRatePawns;
+
+	/** Seconds between significance updates */
+	UPROPERTY(Category = Significance, EditAnywhere, config, meta = (ClampMin = "0"))
+	float UpdateInterval;
+
+private:
+	struct FPawnEntry
+	{
+		TWeakObjectPtr<AAfterCurfewPawn> Pawn;
+
+		/** Tier applied to the pawn, INDEX_NONE while it runs at full rate */
+		int32 Tier;
+
+		/** Distance to the view from the last update, squared */
+		float DistanceSquared;
+	};
+
+	/** Returns the tier for an actor DistanceSquared from the view */
+	int32 FindTier(float DistanceSquared, bool bVisible) const;
+
+	void UpdatePawns(const FVector& ViewLocation);
+	void UpdateProjectiles(const FVector& ViewLocation);
+
+	/** Applies Tier to Pawn, INDEX_NONE restores full rate */
+	void ApplyPawnTier(FPawnEntry& Entry, int32 Tier) const;
+
+	TArray<FPawnEntry> Pawns;
+
+	/** Indices of the pawns in the first tier, sorted by distance when more than MaxFullRatePawns compete for it */
+	TArray<int32> FullRateCandidates;
+
+	/** Pool whose projectiles we throttle */
+	TWeakObjectPtr<AAfterCurfewProjectilePool> ProjectilePool;
+
+	/** True when rendering happens at all, otherwise every actor counts as visible */
+	bool bCanCheckRendered;
+};
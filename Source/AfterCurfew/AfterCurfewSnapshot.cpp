@@ -0,0 +1,657 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewSnapshot.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewMovementComponent.h"
+#include "AfterCurfewPawn.h"
+#include "AfterCurfewProjectile.h"
+#include "AfterCurfewProjectileBatch.h"
+#include "AfterCurfewProjectilePool.h"
+#include "AfterCurfewSteeringManager.h"
+#include "AfterCurfewWeaponComponent.h"
+#include "AfterCurfewWorldManager.h"
+#include "Async/Async.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+DECLARE_CYCLE_STAT(TEXT("Snapshot Capture"), STAT_AfterCurfewSnapshotCapture, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Snapshot Restore"), STAT_AfterCurfewSnapshotRestore, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Snapshot Checkpoint"), STAT_AfterCurfewSnapshotCheckpoint, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Snapshot Checkpoints"), STAT_AfterCurfewSnapshotCheckpoints, STATGROUP_AfterCurfew);
+DECLARE_MEMORY_STAT(TEXT("Snapshot Checkpoint Memory"), STAT_AfterCurfewSnapshotMemory, STATGROUP_AfterCurfew);
+
+namespace AfterCurfewSnapshot
+{
+	/** "ACSN" */
+	static const uint32 Magic = 0x4E534341;
+	static const uint32 Version = 2;
+
+	/** Unchanged bytes it takes to end a literal run, a shorter gap costs less to copy than a new run header */
+	static const int32 MinZeroRun = 4;
+
+	/** Size of each run header, a zero run and a literal run length */
+	static const int32 RunHeaderSize = 4;
+}
+
+static void SaveCheckpoint(const TArray<FString>& Args, UWorld* World)
+{
+	if (AAfterCurfewSnapshotManager* Manager = AAfterCurfewSnapshotManager::Get(World))
+	{
+		Manager->SaveCheckpoint();
+	}
+}
+
+static void RestoreCheckpoint(const TArray<FString>& Args, UWorld* World)
+{
+	if (AAfterCurfewSnapshotManager* Manager = AAfterCurfewSnapshotManager::Get(World))
+	{
+		Manager->RestoreCheckpoint(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 0);
+	}
+}
+
+static void SaveSnapshotFile(const TArray<FString>& Args, UWorld* World)
+{
+	if (AAfterCurfewSnapshotManager* Manager = AAfterCurfewSnapshotManager::Get(World))
+	{
+		Manager->SaveToFile(Args.Num() > 0 ? Args[0] : AAfterCurfewSnapshotManager::GetDefaultFile());
+	}
+}
+
+static void LoadSnapshotFile(const TArray<FString>& Args, UWorld* World)
+{
+	if (AAfterCurfewSnapshotManager* Manager = AAfterCurfewSnapshotManager::Get(World))
+	{
+		Manager->LoadFromFile(Args.Num() > 0 ? Args[0] : AAfterCurfewSnapshotManager::GetDefaultFile());
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs SaveCheckpointCommand(
+	TEXT("ac.Snapshot.Checkpoint"),
+	TEXT("Keeps the state of every pawn and projectile as a checkpoint in memory."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&SaveCheckpoint));
+
+static FAutoConsoleCommandWithWorldAndArgs RestoreCheckpointCommand(
+	TEXT("ac.Snapshot.Rollback"),
+	TEXT("Restores the newest checkpoint, or the one the given number of checkpoints before it."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RestoreCheckpoint));
+
+static FAutoConsoleCommandWithWorldAndArgs SaveSnapshotCommand(
+	TEXT("ac.Snapshot.Save"),
+	TEXT("Writes the state of every pawn and projectile to the given file, Saved/Snapshots/Checkpoint.acsnap without one."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&SaveSnapshotFile));
+
+static FAutoConsoleCommandWithWorldAndArgs LoadSnapshotCommand(
+	TEXT("ac.Snapshot.Load"),
+	TEXT("Restores the state saved to the given file, Saved/Snapshots/Checkpoint.acsnap without one."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&LoadSnapshotFile));
+
+FArchive& operator<<(FArchive& Ar, FAfterCurfewSnapshot& Snapshot)
+{
+	int32 NumPawns = Snapshot.Pawns.Num();
+	int32 NumProjectiles = Snapshot.Projectiles.Num();
+	int32 NumBatched = Snapshot.BatchedProjectiles.Num();
+	Ar << Snapshot.Time << Snapshot.SteeringSeed << NumPawns << NumProjectiles << NumBatched;
+
+	if (Ar.IsLoading())
+	{
+		// Every record is written whole, so the counts can be checked against what is left before allocating
+		const int64 PawnSize = 19 * sizeof(int32);
+		const int64 ProjectileSize = 10 * sizeof(int32);
+		const int64 Remaining = Ar.TotalSize() - Ar.Tell();
+		if (NumPawns < 0 || NumProjectiles < 0 || NumBatched < 0 || NumPawns * PawnSize + (int64(NumProjectiles) + NumBatched) * ProjectileSize > Remaining)
+		{
+			Ar.SetError();
+			return Ar;
+		}
+		Snapshot.Pawns.SetNum(NumPawns);
+		Snapshot.Projectiles.SetNum(NumProjectiles);
+		Snapshot.BatchedProjectiles.SetNum(NumBatched);
+	}
+
+	for (FAfterCurfewPawnSnapshot& Pawn : Snapshot.Pawns)
+	{
+		Ar << Pawn;
+	}
+	for (FAfterCurfewProjectileSnapshot& Projectile : Snapshot.Projectiles)
+	{
+		Ar << Projectile;
+	}
+	for (FAfterCurfewProjectileSnapshot& Projectile : Snapshot.BatchedProjectiles)
+	{
+		Ar << Projectile;
+	}
+	return Ar;
+}
+
+void FAfterCurfewSnapshot::Encode(const TArray<uint8>& Raw, const TArray<uint8>* Base, TArray<uint8>& OutEncoded)
+{
+	OutEncoded.Reset();
+
+	const int32 RawNum = Raw.Num();
+	const int32 BaseNum = Base != nullptr ? Base->Num() : 0;
+	const uint8* const BaseData = Base != nullptr ? Base->GetData() : nullptr;
+
+	// Bytes past the end of the base are compared to zero
+	auto DeltaAt = [&Raw, BaseData, BaseNum](int32 Index) -> uint8
+	{
+		return uint8(Raw[Index] ^ (Index < BaseNum ? BaseData[Index] : 0));
+	};
+	auto StartsZeroRun = [RawNum, &DeltaAt](int32 Index) -> bool
+	{
+		const int32 End = FMath::Min(Index + AfterCurfewSnapshot::MinZeroRun, RawNum);
+		for (int32 Scan = Index; Scan < End; ++Scan)
+		{
+			if (DeltaAt(Scan) != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	int32 Index = 0;
+	while (Index < RawNum)
+	{
+		int32 ZeroRun = 0;
+		while (Index < RawNum && ZeroRun < MAX_uint16 && DeltaAt(Index) == 0)
+		{
+			++ZeroRun;
+			++Index;
+		}
+
+		const int32 LiteralStart = Index;
+		while (Index < RawNum && Index - LiteralStart < MAX_uint16 && !StartsZeroRun(Index))
+		{
+			++Index;
+		}
+		const int32 LiteralRun = Index - LiteralStart;
+
+		const int32 HeaderOffset = OutEncoded.AddUninitialized(AfterCurfewSnapshot::RunHeaderSize + LiteralRun);
+		uint8* Out = OutEncoded.GetData() + HeaderOffset;
+		*Out++ = uint8(ZeroRun);
+		*Out++ = uint8(ZeroRun >> 8);
+		*Out++ = uint8(LiteralRun);
+		*Out++ = uint8(LiteralRun >> 8);
+		for (int32 Literal = LiteralStart; Literal < Index; ++Literal)
+		{
+			*Out++ = DeltaAt(Literal);
+		}
+	}
+}
+
+bool FAfterCurfewSnapshot::Decode(const TArray<uint8>& Encoded, int32 RawSize, const TArray<uint8>* Base, TArray<uint8>& OutRaw)
+{
+	if (RawSize < 0)
+	{
+		return false;
+	}
+	OutRaw.SetNumUninitialized(RawSize);
+
+	const int32 BaseNum = Base != nullptr ? Base->Num() : 0;
+	const uint8* const BaseData = Base != nullptr ? Base->GetData() : nullptr;
+
+	int32 In = 0;
+	int32 Out = 0;
+	while (In < Encoded.Num())
+	{
+		if (In + AfterCurfewSnapshot::RunHeaderSize > Encoded.Num())
+		{
+			return false;
+		}
+		const int32 ZeroRun = Encoded[In] | (Encoded[In + 1] << 8);
+		const int32 LiteralRun = Encoded[In + 2] | (Encoded[In + 3] << 8);
+		In += AfterCurfewSnapshot::RunHeaderSize;
+
+		if (Out + ZeroRun + LiteralRun > RawSize || In + LiteralRun > Encoded.Num())
+		{
+			return false;
+		}
+
+		for (const int32 End = Out + ZeroRun; Out < End; ++Out)
+		{
+			OutRaw[Out] = Out < BaseNum ? BaseData[Out] : 0;
+		}
+		for (const int32 End = Out + LiteralRun; Out < End; ++Out)
+		{
+			OutRaw[Out] = uint8(Encoded[In++] ^ (Out < BaseNum ? BaseData[Out] : 0));
+		}
+	}
+	return Out == RawSize;
+}
+
+AAfterCurfewSnapshotManager::AAfterCurfewSnapshotManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+
+	CheckpointInterval = 0.f;
+	MaxCheckpoints = 64;
+	KeyframeInterval = 16;
+
+	LastEncodedBytes = 0;
+	NumSinceKeyframe = 0;
+	LastCheckpointTime = 0.f;
+	CheckpointSeconds = 0.0;
+	NumCheckpointsSaved = 0;
+}
+
+AAfterCurfewSnapshotManager* AAfterCurfewSnapshotManager::Get(UWorld* World)
+{
+	return FindOrSpawnWorldManager<AAfterCurfewSnapshotManager>(World);
+}
+
+FString AAfterCurfewSnapshotManager::GetDefaultFile()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Snapshots") / TEXT("Checkpoint.acsnap");
+}
+
+void AAfterCurfewSnapshotManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	LastCheckpointTime = GetWorld()->GetTimeSeconds();
+}
+
+void AAfterCurfewSnapshotManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (PendingSave.IsValid())
+	{
+		PendingSave.Wait();
+	}
+
+	Checkpoints.Empty();
+	LastRaw.Empty();
+	UpdateStats();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AAfterCurfewSnapshotManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	const float Now = GetWorld()->GetTimeSeconds();
+	if (CheckpointInterval > 0.f && Now - LastCheckpointTime >= CheckpointInterval)
+	{
+		SaveCheckpoint();
+	}
+}
+
+void AAfterCurfewSnapshotManager::Capture(FAfterCurfewSnapshot& OutSnapshot) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewSnapshotCapture);
+
+	UWorld* const World = GetWorld();
+	OutSnapshot.Reset();
+	OutSnapshot.Time = World->GetTimeSeconds();
+
+	TMap<const AActor*, int32> PawnIndices;
+	for (TActorIterator<AAfterCurfewPawn> It(World); It; ++It)
+	{
+		const AAfterCurfewPawn* Pawn = *It;
+		const UAfterCurfewMovementComponent* Movement = Pawn->GetShipMovementComponent();
+		const UAfterCurfewWeaponComponent* Weapon = Pawn->GetWeaponComponent();
+		const FAfterCurfewMoveState& MoveState = Movement->GetMoveState();
+
+		PawnIndices.Add(Pawn, OutSnapshot.Pawns.Num());
+
+		FAfterCurfewPawnSnapshot& Snapshot = OutSnapshot.Pawns[OutSnapshot.Pawns.AddDefaulted()];
+		Snapshot.Location = Pawn->GetActorLocation();
+		Snapshot.Velocity = MoveState.Velocity;
+		Snapshot.Yaw = MoveState.Yaw;
+		Snapshot.YawSpeed = MoveState.YawSpeed;
+		Snapshot.DesiredYaw = Movement->GetDesiredYaw();
+		Snapshot.MoveAccumulator = Movement->GetTimeAccumulator();
+		Snapshot.ShotCooldown = Weapon->GetShotCooldown();
+		Snapshot.WeaponSeed = Weapon->GetCurrentWeaponSeed();
+		Snapshot.Flags = Weapon->WasFiring() ? FAfterCurfewPawnSnapshot::FiringFlag : 0;
+	}
+
+	// Agents refer to their targets by snapshot index, so every pawn has to have one first
+	if (const AAfterCurfewSteeringManager* SteeringManager = FindWorldManager<AAfterCurfewSteeringManager>(World))
+	{
+		SteeringManager->CaptureAgents(OutSnapshot, PawnIndices);
+	}
+
+	auto FindOwnerIndex = [&PawnIndices](const AActor* ProjectileOwner) -> int32
+	{
+		const int32* Index = ProjectileOwner != nullptr ? PawnIndices.Find(ProjectileOwner) : nullptr;
+		return Index != nullptr ? *Index : INDEX_NONE;
+	};
+
+	// Every pooled projectile keeps its place whether it flies or not, so the layout only changes when the pool grows
+	if (const AAfterCurfewProjectilePool* Pool = FindWorldManager<AAfterCurfewProjectilePool>(World))
+	{
+		OutSnapshot.Projectiles.SetNum(Pool->GetPoolSize());
+		for (int32 Index = 0; Index < Pool->GetPoolSize(); ++Index)
+		{
+			const AAfterCurfewProjectile* Projectile = Pool->GetProjectiles()[Index];
+			if (Projectile == nullptr || !Projectile->IsPooledActive())
+			{
+				continue;
+			}
+
+			const UProjectileMovementComponent* ProjectileMovement = Projectile->GetProjectileMovement();
+			FAfterCurfewProjectileSnapshot& Snapshot = OutSnapshot.Projectiles[Index];
+			Snapshot.Location = Projectile->GetActorLocation();
+			Snapshot.Velocity = ProjectileMovement->Velocity;
+			Snapshot.MaxSpeed = ProjectileMovement->MaxSpeed;
+			Snapshot.LifeSpan = FMath::Max(Projectile->GetLifeSpan(), KINDA_SMALL_NUMBER);
+			Snapshot.Scale = Projectile->GetActorScale3D().X;
+			Snapshot.OwnerIndex = FindOwnerIndex(Projectile->GetOwner());
+		}
+	}
+
+	if (const AAfterCurfewProjectileBatch* Batch = FindWorldManager<AAfterCurfewProjectileBatch>(World))
+	{
+		OutSnapshot.BatchedProjectiles.SetNum(Batch->GetNumLive());
+		for (int32 Index = 0; Index < Batch->GetNumLive(); ++Index)
+		{
+			FAfterCurfewProjectileSnapshot& Snapshot = OutSnapshot.BatchedProjectiles[Index];
+			AActor* ProjectileOwner = nullptr;
+			Batch->GetBullet(Index, Snapshot.Location, Snapshot.Velocity, Snapshot.LifeSpan, Snapshot.Scale, ProjectileOwner);
+			Snapshot.OwnerIndex = FindOwnerIndex(ProjectileOwner);
+		}
+	}
+}
+
+bool AAfterCurfewSnapshotManager::CanRestore() const
+{
+	if (GetNetMode() == NM_Client)
+	{
+		UE_LOG(LogAfterCurfew, Warning, TEXT("Snapshot: clients cannot restore, restore on the server"));
+		return false;
+	}
+	return true;
+}
+
+bool AAfterCurfewSnapshotManager::Restore(const FAfterCurfewSnapshot& Snapshot)
+{
+	if (!CanRestore())
+	{
+		return false;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewSnapshotRestore);
+
+	UWorld* const World = GetWorld();
+
+	TArray<AAfterCurfewPawn*> Pawns;
+	Pawns.Reserve(Snapshot.Pawns.Num());
+	for (TActorIterator<AAfterCurfewPawn> It(World); It; ++It)
+	{
+		Pawns.Add(*It);
+	}
+	if (Pawns.Num() != Snapshot.Pawns.Num())
+	{
+		UE_LOG(LogAfterCurfew, Warning, TEXT("Snapshot: saved with %d pawns, restoring the first %d of %d"), Snapshot.Pawns.Num(), FMath::Min(Pawns.Num(), Snapshot.Pawns.Num()), Pawns.Num());
+	}
+
+	for (int32 Index = 0; Index < Pawns.Num() && Index < Snapshot.Pawns.Num(); ++Index)
+	{
+		const FAfterCurfewPawnSnapshot& Saved = Snapshot.Pawns[Index];
+		AAfterCurfewPawn* Pawn = Pawns[Index];
+
+		const FRotator CurrentRotation = Pawn->GetActorRotation();
+		Pawn->SetActorLocationAndRotation(Saved.Location, FRotator(CurrentRotation.Pitch, Saved.Yaw, CurrentRotation.Roll), false, nullptr, ETeleportType::TeleportPhysics);
+
+		FAfterCurfewMoveState MoveState;
+		MoveState.Velocity = Saved.Velocity;
+		MoveState.Yaw = Saved.Yaw;
+		MoveState.YawSpeed = Saved.YawSpeed;
+		Pawn->GetShipMovementComponent()->RestoreMoveState(MoveState, Saved.DesiredYaw, Saved.MoveAccumulator);
+
+		UAfterCurfewWeaponComponent* Weapon = Pawn->GetWeaponComponent();
+		Weapon->SetWeaponSeed(Saved.WeaponSeed);
+		Weapon->RestoreFireState(Saved.ShotCooldown, (Saved.Flags & FAfterCurfewPawnSnapshot::FiringFlag) != 0);
+	}
+
+	if (AAfterCurfewSteeringManager* SteeringManager = FindWorldManager<AAfterCurfewSteeringManager>(World))
+	{
+		SteeringManager->RestoreAgents(Snapshot, Pawns);
+	}
+
+	auto FindOwner = [&Pawns](int32 OwnerIndex) -> AActor*
+	{
+		return Pawns.IsValidIndex(OwnerIndex) ? Pawns[OwnerIndex] : nullptr;
+	};
+
+	// Projectiles in flight are put back into the pool and handed out again, in whichever pool slot comes up
+	AAfterCurfewProjectilePool* Pool = FindWorldManager<AAfterCurfewProjectilePool>(World);
+	if (Pool != nullptr)
+	{
+		for (AAfterCurfewProjectile* Projectile : Pool->GetProjectiles())
+		{
+			Pool->Release(Projectile);
+		}
+	}
+	for (const FAfterCurfewProjectileSnapshot& Saved : Snapshot.Projectiles)
+	{
+		if (Saved.LifeSpan <= 0.f)
+		{
+			continue;
+		}
+
+		if (Pool == nullptr)
+		{
+			Pool = AAfterCurfewProjectilePool::Get(World);
+		}
+
+		const FTransform Transform(Saved.Velocity.Rotation(), Saved.Location, FVector(Saved.Scale));
+		AAfterCurfewProjectile* Projectile = Pool != nullptr ? Pool->Acquire(Transform, Saved.Velocity.Size(), Saved.MaxSpeed, FindOwner(Saved.OwnerIndex)) : nullptr;
+		if (Projectile != nullptr)
+		{
+			Projectile->SetFlightTimeLeft(Saved.LifeSpan);
+		}
+	}
+
+	AAfterCurfewProjectileBatch* Batch = Snapshot.BatchedProjectiles.Num() > 0 ? AAfterCurfewProjectileBatch::Get(World) : FindWorldManager<AAfterCurfewProjectileBatch>(World);
+	if (Batch != nullptr)
+	{
+		Batch->RemoveAllBullets();
+		for (const FAfterCurfewProjectileSnapshot& Saved : Snapshot.BatchedProjectiles)
+		{
+			Batch->AddBullet(Saved.Location, Saved.Velocity, Saved.LifeSpan, Saved.Scale, FindOwner(Saved.OwnerIndex));
+		}
+	}
+
+	UE_LOG(LogAfterCurfew, Log, TEXT("Snapshot: restored %d pawns and %d projectiles from %.2fs"), FMath::Min(Pawns.Num(), Snapshot.Pawns.Num()), (Pool != nullptr ? Pool->GetNumActive() : 0) + Snapshot.BatchedProjectiles.Num(), Snapshot.Time);
+	return true;
+}
+
+void AAfterCurfewSnapshotManager::SaveCheckpoint()
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewSnapshotCheckpoint);
+
+	const double StartTime = FPlatformTime::Seconds();
+	LastCheckpointTime = GetWorld()->GetTimeSeconds();
+
+	Capture(Scratch);
+
+	TArray<uint8> Raw;
+	Raw.Reserve(LastRaw.Num());
+	FMemoryWriter Writer(Raw);
+	Writer << Scratch;
+
+	// The first checkpoint and every KeyframeInterval-th one are whole, the rest only store what changed since the last
+	const bool bKeyframe = Checkpoints.Num() == 0 || NumSinceKeyframe + 1 >= KeyframeInterval;
+	FCheckpoint& Checkpoint = Checkpoints[Checkpoints.AddDefaulted()];
+	FAfterCurfewSnapshot::Encode(Raw, bKeyframe ? nullptr : &LastRaw, Checkpoint.Encoded);
+	Checkpoint.RawSize = Raw.Num();
+	Checkpoint.bKeyframe = bKeyframe;
+	NumSinceKeyframe = bKeyframe ? 0 : NumSinceKeyframe + 1;
+	LastEncodedBytes = Checkpoint.Encoded.Num();
+	LastRaw = MoveTemp(Raw);
+
+	// Drop whole groups from the oldest keyframe up to the next one, a difference is useless without what it is based on
+	while (Checkpoints.Num() > MaxCheckpoints)
+	{
+		int32 NumToDrop = 1;
+		while (NumToDrop < Checkpoints.Num() && !Checkpoints[NumToDrop].bKeyframe)
+		{
+			++NumToDrop;
+		}
+		if (NumToDrop == Checkpoints.Num())
+		{
+			break;
+		}
+		Checkpoints.RemoveAt(0, NumToDrop, false);
+	}
+
+	CheckpointSeconds += FPlatformTime::Seconds() - StartTime;
+	++NumCheckpointsSaved;
+
+	UpdateStats();
+}
+
+bool AAfterCurfewSnapshotManager::DecodeCheckpoint(int32 Index, TArray<uint8>& OutRaw) const
+{
+	int32 First = Index;
+	while (First > 0 && !Checkpoints[First].bKeyframe)
+	{
+		--First;
+	}
+
+	TArray<uint8> Base;
+	for (int32 Step = First; Step <= Index; ++Step)
+	{
+		const FCheckpoint& Checkpoint = Checkpoints[Step];
+		if (!FAfterCurfewSnapshot::Decode(Checkpoint.Encoded, Checkpoint.RawSize, Step == First ? nullptr : &Base, OutRaw))
+		{
+			return false;
+		}
+		if (Step < Index)
+		{
+			Swap(Base, OutRaw);
+		}
+	}
+	return true;
+}
+
+bool AAfterCurfewSnapshotManager::RestoreCheckpoint(int32 Age)
+{
+	const int32 Index = Checkpoints.Num() - 1 - Age;
+	if (!Checkpoints.IsValidIndex(Index))
+	{
+		UE_LOG(LogAfterCurfew, Warning, TEXT("Snapshot: no checkpoint %d back, %d kept"), Age, Checkpoints.Num());
+		return false;
+	}
+
+	TArray<uint8> Raw;
+	if (!DecodeCheckpoint(Index, Raw))
+	{
+		UE_LOG(LogAfterCurfew, Error, TEXT("Snapshot: checkpoint %d back is corrupt"), Age);
+		return false;
+	}
+
+	FMemoryReader Reader(Raw);
+	Reader << Scratch;
+	return !Reader.IsError() && Restore(Scratch);
+}
+
+void AAfterCurfewSnapshotManager::SaveToFile(const FString& File)
+{
+	Capture(Scratch);
+
+	TArray<uint8> Raw;
+	FMemoryWriter RawWriter(Raw);
+	RawWriter << Scratch;
+
+	TArray<uint8> Encoded;
+	FAfterCurfewSnapshot::Encode(Raw, nullptr, Encoded);
+
+	TArray<uint8> FileBytes;
+	FMemoryWriter Writer(FileBytes);
+	uint32 Magic = AfterCurfewSnapshot::Magic;
+	uint32 Version = AfterCurfewSnapshot::Version;
+	int32 RawSize = Raw.Num();
+	Writer << Magic << Version << RawSize;
+	Writer.Serialize(Encoded.GetData(), Encoded.Num());
+
+	// One write at a time, so saving the same file twice keeps the newest
+	if (PendingSave.IsValid())
+	{
+		PendingSave.Wait();
+	}
+
+	PendingSave = Async<bool>(EAsyncExecution::ThreadPool, [File, Bytes = MoveTemp(FileBytes)]()
+	{
+		const bool bSaved = FFileHelper::SaveArrayToFile(Bytes, *File);
+		if (bSaved)
+		{
+			UE_LOG(LogAfterCurfew, Log, TEXT("Snapshot: saved %d bytes to %s"), Bytes.Num(), *File);
+		}
+		else
+		{
+			UE_LOG(LogAfterCurfew, Warning, TEXT("Snapshot: could not write %s"), *File);
+		}
+		return bSaved;
+	});
+}
+
+bool AAfterCurfewSnapshotManager::LoadFromFile(const FString& File)
+{
+	if (PendingSave.IsValid())
+	{
+		PendingSave.Wait();
+	}
+
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *File))
+	{
+		UE_LOG(LogAfterCurfew, Warning, TEXT("Snapshot: could not read %s"), *File);
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	int32 RawSize = 0;
+	Reader << Magic << Version << RawSize;
+	if (Reader.IsError() || Magic != AfterCurfewSnapshot::Magic || Version != AfterCurfewSnapshot::Version)
+	{
+		UE_LOG(LogAfterCurfew, Warning, TEXT("Snapshot: %s is not a version %u snapshot"), *File, AfterCurfewSnapshot::Version);
+		return false;
+	}
+
+	const int64 HeaderSize = Reader.Tell();
+	TArray<uint8> Encoded;
+	Encoded.Append(Bytes.GetData() + HeaderSize, Bytes.Num() - HeaderSize);
+
+	TArray<uint8> Raw;
+	if (!FAfterCurfewSnapshot::Decode(Encoded, RawSize, nullptr, Raw))
+	{
+		UE_LOG(LogAfterCurfew, Error, TEXT("Snapshot: %s is corrupt"), *File);
+		return false;
+	}
+
+	FMemoryReader RawReader(Raw);
+	RawReader << Scratch;
+	if (RawReader.IsError())
+	{
+		UE_LOG(LogAfterCurfew, Error, TEXT("Snapshot: %s is corrupt"), *File);
+		return false;
+	}
+	return Restore(Scratch);
+}
+
+int64 AAfterCurfewSnapshotManager::GetCheckpointBytes() const
+{
+	int64 Bytes = LastRaw.GetAllocatedSize() + Checkpoints.GetAllocatedSize();
+	for (const FCheckpoint& Checkpoint : Checkpoints)
+	{
+		Bytes += Checkpoint.Encoded.GetAllocatedSize();
+	}
+	return Bytes;
+}
+
+void AAfterCurfewSnapshotManager::UpdateStats() const
+{
+	SET_DWORD_STAT(STAT_AfterCurfewSnapshotCheckpoints, Checkpoints.Num());
+	SET_MEMORY_STAT(STAT_AfterCurfewSnapshotMemory, GetCheckpointBytes());
+}
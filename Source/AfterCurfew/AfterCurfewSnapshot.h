@@ -0,0 +1,268 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "Async/Future.h"
+#include "AfterCurfewSnapshot.generated.h"
+
+/** State of one pawn in a snapshot, 76 bytes */
+struct FAfterCurfewPawnSnapshot
+{
+	/** Flag bits */
+	static const uint32 FiringFlag = 1 << 0;
+
+	/** Steered by the AI, the agent state below is set */
+	static const uint32 AgentFlag = 1 << 1;
+
+	/** The agent strafes the other way around its target */
+	static const uint32 ReverseStrafeFlag = 1 << 2;
+
+	/** The agent's last sight trace reached its target */
+	static const uint32 LineOfSightFlag = 1 << 3;
+
+	FVector Location;
+	FVector Velocity;
+	float Yaw;
+	float YawSpeed;
+	float DesiredYaw;
+
+	/** Frame time the movement had not integrated yet */
+	float MoveAccumulator;
+
+	/** Seconds until the weapon's next shot is due */
+	float ShotCooldown;
+
+	/** Seed the weapon stream continues from */
+	int32 WeaponSeed;
+
+	uint32 Flags;
+
+	/** Index of the agent's target in the snapshot, INDEX_NONE for none */
+	int32 TargetIndex;
+
+	/** Seconds after the snapshot the agent picks a target next */
+	float NextDecisionDelay;
+
+	/** Seconds the last obstacle the agent found keeps pushing it along ObstacleNormal */
+	float ObstacleTimeLeft;
+	FVector ObstacleNormal;
+
+	FAfterCurfewPawnSnapshot()
+		: Location(FVector::ZeroVector)
+		, Velocity(FVector::ZeroVector)
+		, Yaw(0.f)
+		, YawSpeed(0.f)
+		, DesiredYaw(0.f)
+		, MoveAccumulator(0.f)
+		, ShotCooldown(0.f)
+		, WeaponSeed(0)
+		, Flags(0)
+		, TargetIndex(INDEX_NONE)
+		, NextDecisionDelay(0.f)
+		, ObstacleTimeLeft(0.f)
+		, ObstacleNormal(FVector::ZeroVector)
+	{
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FAfterCurfewPawnSnapshot& Pawn)
+	{
+		Ar << Pawn.Location << Pawn.Velocity;
+		Ar << Pawn.Yaw << Pawn.YawSpeed << Pawn.DesiredYaw;
+		Ar << Pawn.MoveAccumulator << Pawn.ShotCooldown;
+		Ar << Pawn.WeaponSeed << Pawn.Flags;
+		Ar << Pawn.TargetIndex << Pawn.NextDecisionDelay << Pawn.ObstacleTimeLeft << Pawn.ObstacleNormal;
+		return Ar;
+	}
+};
+
+/** State of one projectile in a snapshot, actor or batched, 40 bytes */
+struct FAfterCurfewProjectileSnapshot
+{
+	FVector Location;
+	FVector Velocity;
+	float MaxSpeed;
+
+	/** Seconds left to fly, zero for a pooled projectile that is not in flight */
+	float LifeSpan;
+
+	float Scale;
+
+	/** Index of the pawn that fired it in the snapshot, INDEX_NONE for none */
+	int32 OwnerIndex;
+
+	FAfterCurfewProjectileSnapshot()
+		: Location(FVector::ZeroVector)
+		, Velocity(FVector::ZeroVector)
+		, MaxSpeed(0.f)
+		, LifeSpan(0.f)
+		, Scale(0.f)
+		, OwnerIndex(INDEX_NONE)
+	{
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FAfterCurfewProjectileSnapshot& Projectile)
+	{
+		Ar << Projectile.Location << Projectile.Velocity;
+		Ar << Projectile.MaxSpeed << Projectile.LifeSpan << Projectile.Scale;
+		Ar << Projectile.OwnerIndex;
+		return Ar;
+	}
+};
+
+/**
+ * State of a whole arena at one frame.
+ * Written in a fixed layout: the time, the AI stream and the counts, then every pawn in world order, every pooled projectile in pool order whether
+ * it flies or not, then every batched bullet. Consecutive snapshots of the same arena line up byte for byte where
+ * nothing changed, which is what the delta encoding relies on.
+ */
+struct FAfterCurfewSnapshot
+{
+	/** World time the snapshot was taken at, the agents' timers are saved relative to it */
+	float Time;
+
+	/** Seed the AI's random stream continues from */
+	int32 SteeringSeed;
+
+	TArray<FAfterCurfewPawnSnapshot> Pawns;
+	TArray<FAfterCurfewProjectileSnapshot> Projectiles;
+	TArray<FAfterCurfewProjectileSnapshot> BatchedProjectiles;
+
+	FAfterCurfewSnapshot()
+		: Time(0.f)
+		, SteeringSeed(0)
+	{
+	}
+
+	void Reset()
+	{
+		Time = 0.f;
+		SteeringSeed = 0;
+		Pawns.Reset();
+		Projectiles.Reset();
+		BatchedProjectiles.Reset();
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FAfterCurfewSnapshot& Snapshot);
+
+	/** Encodes Raw as its difference to Base, zero runs and literal bytes, a null Base stores it whole */
+	static void Encode(const TArray<uint8>& Raw, const TArray<uint8>* Base, TArray<uint8>& OutEncoded);
+
+	/** Reverses Encode, returns false if Encoded is malformed */
+	static bool Decode(const TArray<uint8>& Encoded, int32 RawSize, const TArray<uint8>* Base, TArray<uint8>& OutRaw);
+};
+
+/**
+ * Saves and restores the state of every pawn and projectile in a world, for checkpoints, rollback while debugging and
+ * restarting a benchmark from the same state without reloading the map.
+ * Checkpoints are kept in memory, each stored as its difference to the one before and a whole one every
+ * KeyframeInterval, so a quiet arena costs little more than its moving parts. Snapshots written to a file are whole
+ * and go out on the thread pool.
+ *
+ * Restoring matches pawns by world order and needs the same pawns to exist, it does not spawn or destroy any.
+ * The AI's decisions are restored with its random stream, so a restored run plays out the same as long as the AI
+ * sees the same traces. Traces in flight when the snapshot was taken are not kept: agents hold the line of sight
+ * they had until their next decision traces again.
+ * Only restores where the world is authoritative, clients follow through replication and move corrections.
+ */
+UCLASS(config=Game, notplaceable)
+class AFTERCURFEW_API AAfterCurfewSnapshotManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewSnapshotManager();
+
+	/** Returns the snapshot manager of this world, creating it on first use */
+	static AAfterCurfewSnapshotManager* Get(UWorld* World);
+
+	// Begin Actor Interface
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+	// End Actor Interface
+
+	/** Fills OutSnapshot with the current state of the world */
+	void Capture(FAfterCurfewSnapshot& OutSnapshot) const;
+
+	/** Puts the world back in the state of Snapshot, returns false if this world cannot restore */
+	bool Restore(const FAfterCurfewSnapshot& Snapshot);
+
+	/** Keeps the current state as the newest checkpoint, dropping the oldest ones past MaxCheckpoints */
+	void SaveCheckpoint();
+
+	/** Restores the checkpoint Age places before the newest one, returns false if there is none */
+	bool RestoreCheckpoint(int32 Age = 0);
+
+	/** Writes the current state to File on the thread pool */
+	void SaveToFile(const FString& File);
+
+	/** Reads File and restores it, returns false if it could not be read or restored */
+	bool LoadFromFile(const FString& File);
+
+	FORCEINLINE int32 GetNumCheckpoints() const { return Checkpoints.Num(); }
+
+	/** Memory held by the checkpoints, in bytes */
+	int64 GetCheckpointBytes() const;
+
+	/** Size of the last snapshot taken, before and after encoding, in bytes */
+	FORCEINLINE int32 GetLastRawBytes() const { return LastRaw.Num(); }
+	FORCEINLINE int32 GetLastEncodedBytes() const { return LastEncodedBytes; }
+
+	/** Average time taken to capture and encode a checkpoint, in seconds */
+	FORCEINLINE double GetAverageCheckpointSeconds() const { return NumCheckpointsSaved > 0 ? CheckpointSeconds / NumCheckpointsSaved : 0.0; }
+
+	/** Returns the file snapshots are saved to when none is given */
+	static FString GetDefaultFile();
+
+	/** Seconds between automatic checkpoints, zero turns them off */
+	UPROPERTY(Category = Snapshot, EditAnywhere, config)
+	float CheckpointInterval;
+
+	/** Checkpoints kept in memory */
+	UPROPERTY(Category = Snapshot, EditAnywhere, config, meta = (ClampMin = "1"))
+	int32 MaxCheckpoints;
+
+	/** Every this many checkpoints one is stored whole rather than as a difference */
+	UPROPERTY(Category = Snapshot, EditAnywhere, config, meta = (ClampMin = "1"))
+	int32 KeyframeInterval;
+
+private:
+	/** A snapshot as kept in memory */
+	struct FCheckpoint
+	{
+		TArray<uint8> Encoded;
+		int32 RawSize;
+		bool bKeyframe;
+	};
+
+	/** Decodes checkpoint Index into OutRaw, starting from the keyframe before it */
+	bool DecodeCheckpoint(int32 Index, TArray<uint8>& OutRaw) const;
+
+	bool CanRestore() const;
+
+	void UpdateStats() const;
+
+	/** Checkpoints oldest first, the oldest is always a keyframe */
+	TArray<FCheckpoint> Checkpoints;
+
+	/** Layout of the newest checkpoint, the next one is encoded against it */
+	TArray<uint8> LastRaw;
+
+	int32 LastEncodedBytes;
+
+	/** Checkpoints since the last keyframe */
+	int32 NumSinceKeyframe;
+
+	float LastCheckpointTime;
+
+	double CheckpointSeconds;
+	int32 NumCheckpointsSaved;
+
+	/** Snapshot being written to a file */
+	TFuture<bool> PendingSave;
+
+	/** Every save and load goes through this one, so checkpoints reuse its pawn and projectile arrays */
+	FAfterCurfewSnapshot Scratch;
+};
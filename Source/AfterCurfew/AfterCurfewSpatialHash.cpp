@@ -0,0 +1,582 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewSpatialHash.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewProjectile.h"
+#include "AfterCurfewWorldManager.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Components/ModelComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/Level.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Spatial Hash Update"), STAT_AfterCurfewSpatialHashUpdate, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Spatial Hash Sweep"), STAT_AfterCurfewSpatialHashSweep, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Spatial Hash Entries"), STAT_AfterCurfewSpatialHashEntries, STATGROUP_AfterCurfew);
+DECLARE_MEMORY_STAT(TEXT("Spatial Hash Memory"), STAT_AfterCurfewSpatialHashMemory, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Spatial Hash Candidates"), STAT_AfterCurfewSpatialHashCandidates, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Spatial Hash Narrow Phase"), STAT_AfterCurfewSpatialHashNarrowPhase, STATGROUP_AfterCurfew);
+
+static TAutoConsoleVariable<int32> CVarProjectileSpatialHash(
+	TEXT("ac.Projectile.SpatialHash"),
+	1,
+	TEXT("How projectiles of both backends find what they hit.\n")
+	TEXT("0: sweep the physics scene\n")
+	TEXT("1: sweep the candidates from the arena's spatial hash (default), it holds what blocks projectiles when it is added\n")
+	TEXT("   and misses primitives that only start blocking them later, e.g. after a collision profile change"),
+	ECVF_Default);
+
+static const FName ProjectileProfileName(TEXT("Projectile"));
+
+/** Times scene sweeps against spatial hash sweeps for the same random bullet segments */
+static void BenchSpatialHash(const TArray<FString>& Args, UWorld* World)
+{
+	AAfterCurfewSpatialHash* SpatialHash = AAfterCurfewSpatialHash::Get(World);
+	if (SpatialHash == nullptr)
+	{
+		return;
+	}
+
+	const float Radius = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 10.f;
+	const float SegmentLength = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 50.f;
+	const int32 NumIterations = 10;
+
+	// Bullets fly in the box holding every pawn, about where they would be fired
+	FBox Arena(ForceInit);
+	for (TActorIterator<APawn> It(World); It; ++It)
+	{
+		Arena += It->GetActorLocation();
+	}
+	if (!Arena.IsValid)
+	{
+		UE_LOG(LogAfterCurfew, Display, TEXT("SpatialHash: no pawns to bench around"));
+		return;
+	}
+	Arena = Arena.ExpandBy(FVector(1000.f, 1000.f, 50.f));
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(AfterCurfewSpatialHashBench), false);
+	const FCollisionShape Sphere = FCollisionShape::MakeSphere(Radius);
+
+	UE_LOG(LogAfterCurfew, Display, TEXT("SpatialHash: %d entries, %.0f cm cells, radius %.1f, %.0f cm segments, %d iterations"),
+		SpatialHash->GetNumEntries(), SpatialHash->CellSize, Radius, SegmentLength, NumIterations);
+
+	const int32 BulletCounts[] = { 100, 1000, 10000 };
+	for (const int32 NumBullets : BulletCounts)
+	{
+		FRandomStream Random(NumBullets);
+		TArray<FVector> Starts;
+		TArray<FVector> Ends;
+		Starts.Reserve(NumBullets);
+		Ends.Reserve(NumBullets);
+		for (int32 Index = 0; Index < NumBullets; ++Index)
+		{
+			const FVector Start(Random.FRandRange(Arena.Min.X, Arena.Max.X), Random.FRandRange(Arena.Min.Y, Arena.Max.Y), Random.FRandRange(Arena.Min.Z, Arena.Max.Z));
+			const FVector Direction = FRotator(0.f, Random.FRandRange(-180.f, 180.f), 0.f).Vector();
+			Starts.Add(Start);
+			Ends.Add(Start + Direction * SegmentLength);
+		}
+
+		int32 NumSceneHits = 0;
+		const double SceneStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			for (int32 Index = 0; Index < NumBullets; ++Index)
+			{
+				FHitResult Hit;
+				NumSceneHits += World->SweepSingleByProfile(Hit, Starts[Index], Ends[Index], FQuat::Identity, ProjectileProfileName, Sphere, QueryParams) ? 1 : 0;
+			}
+		}
+		const double SceneSeconds = (FPlatformTime::Seconds() - SceneStart) / NumIterations;
+
+		int32 NumHashHits = 0;
+		const double HashStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			for (int32 Index = 0; Index < NumBullets; ++Index)
+			{
+				FHitResult Hit;
+				NumHashHits += SpatialHash->SweepSphere(Starts[Index], Ends[Index], Radius, nullptr, Hit) ? 1 : 0;
+			}
+		}
+		const double HashSeconds = (FPlatformTime::Seconds() - HashStart) / NumIterations;
+
+		UE_LOG(LogAfterCurfew, Display, TEXT("SpatialHash: %5d bullets, scene %.3f ms (%d hits), hash %.3f ms (%d hits)"),
+			NumBullets, SceneSeconds * 1000.0, NumSceneHits / NumIterations, HashSeconds * 1000.0, NumHashHits / NumIterations);
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs SpatialHashBenchCommand(
+	TEXT("ac.SpatialHash.Bench"),
+	TEXT("Sweeps 100, 1000 and 10000 random bullets around the pawns through the physics scene and through the spatial hash and logs the time each took.\n")
+	TEXT("Optional arguments: bullet radius (default 10), segment length (default 50)."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchSpatialHash));
+
+/** Checks that the spatial hash finds the static geometry a scene sweep finds, e.g. the walls of a generated arena */
+static void CheckSpatialHash(const TArray<FString>& Args, UWorld* World)
+{
+	AAfterCurfewSpatialHash* SpatialHash = AAfterCurfewSpatialHash::Get(World);
+	if (SpatialHash == nullptr)
+	{
+		return;
+	}
+
+	const int32 NumSegments = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+	const float Radius = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 10.f;
+	const float SegmentLength = 2000.f;
+
+	const FBox Bounds = SpatialHash->GetStaticBounds();
+	if (!Bounds.IsValid)
+	{
+		UE_LOG(LogAfterCurfew, Display, TEXT("SpatialHash: no static geometry to check"));
+		return;
+	}
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(AfterCurfewSpatialHashCheck), false);
+	const FCollisionShape Sphere = FCollisionShape::MakeSphere(Radius);
+
+	FRandomStream Random(NumSegments);
+	int32 NumSceneHits = 0;
+	int32 NumMissed = 0;
+	for (int32 Index = 0; Index < NumSegments; ++Index)
+	{
+		const FVector Start(Random.FRandRange(Bounds.Min.X, Bounds.Max.X), Random.FRandRange(Bounds.Min.Y, Bounds.Max.Y), Random.FRandRange(Bounds.Min.Z, Bounds.Max.Z));
+		const FVector End = Start + FRotator(0.f, Random.FRandRange(-180.f, 180.f), 0.f).Vector() * SegmentLength;
+
+		// Only first hits on static geometry are compared, the hash leaves projectiles out
+		FHitResult SceneHit;
+		const bool bSceneHit = World->SweepSingleByProfile(SceneHit, Start, End, FQuat::Identity, ProjectileProfileName, Sphere, QueryParams);
+		const UPrimitiveComponent* SceneComponent = SceneHit.Component.Get();
+		if (!bSceneHit || SceneHit.bStartPenetrating || SceneComponent == nullptr || SceneComponent->Mobility == EComponentMobility::Movable)
+		{
+			continue;
+		}
+		++NumSceneHits;
+
+		FHitResult HashHit;
+		if (!SpatialHash->SweepSphere(Start, End, Radius, nullptr, HashHit))
+		{
+			++NumMissed;
+			UE_LOG(LogAfterCurfew, Verbose, TEXT("SpatialHash: missed %s at %s"), *GetNameSafe(SceneComponent), *SceneHit.ImpactPoint.ToString());
+		}
+	}
+
+	if (NumMissed > 0)
+	{
+		UE_LOG(LogAfterCurfew, Warning, TEXT("SpatialHash: missed %d of %d static hits over %d segments"), NumMissed, NumSceneHits, NumSegments);
+	}
+	else
+	{
+		UE_LOG(LogAfterCurfew, Display, TEXT("SpatialHash: found all %d static hits over %d segments"), NumSceneHits, NumSegments);
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs SpatialHashCheckCommand(
+	TEXT("ac.SpatialHash.Check"),
+	TEXT("Sweeps random bullets across the static geometry through the physics scene and through the spatial hash and warns about hits the hash misses.\n")
+	TEXT("Optional arguments: number of segments (default 1000), bullet radius (default 10)."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&CheckSpatialHash));
+
+AAfterCurfewSpatialHash::AAfterCurfewSpatialHash()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	CellSize = 1000.f;
+	Margin = 50.f;
+
+	ProjectileChannel = ECC_WorldDynamic;
+	QueryStamp = 0;
+}
+
+AAfterCurfewSpatialHash* AAfterCurfewSpatialHash::Get(UWorld* World)
+{
+	return FindOrSpawnWorldManager<AAfterCurfewSpatialHash>(World);
+}
+
+bool AAfterCurfewSpatialHash::IsUsedByProjectiles()
+{
+	return CVarProjectileSpatialHash.GetValueOnGameThread() != 0;
+}
+
+void AAfterCurfewSpatialHash::BeginPlay()
+{
+	Super::BeginPlay();
+
+	FCollisionResponseTemplate ProjectileProfile;
+	if (UCollisionProfile::Get()->GetProfileTemplate(ProjectileProfileName, ProjectileProfile))
+	{
+		ProjectileChannel = ProjectileProfile.ObjectType;
+	}
+
+	UWorld* const World = GetWorld();
+	for (ULevel* Level : World->GetLevels())
+	{
+		if (Level != nullptr && Level->bIsVisible)
+		{
+			RegisterLevel(Level);
+		}
+	}
+
+	ActorSpawnedHandle = World->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &AAfterCurfewSpatialHash::OnActorSpawned));
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &AAfterCurfewSpatialHash::OnLevelAdded);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &AAfterCurfewSpatialHash::OnLevelRemoved);
+}
+
+void AAfterCurfewSpatialHash::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+
+	Entries.Empty();
+	ComponentToEntries.Empty();
+	Cells.Empty();
+	PendingActors.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AAfterCurfewSpatialHash::OnActorSpawned(AActor* Actor)
+{
+	// Deferred spawns are not set up yet, so new actors wait for our next tick
+	PendingActors.Add(Actor);
+}
+
+void AAfterCurfewSpatialHash::OnLevelAdded(ULevel* Level, UWorld* World)
+{
+	// Streamed in actors are loaded rather than spawned, so the spawn handler never sees them
+	if (World == GetWorld())
+	{
+		RegisterLevel(Level);
+	}
+}
+
+void AAfterCurfewSpatialHash::OnLevelRemoved(ULevel* Level, UWorld* World)
+{
+	if (World != GetWorld() || Level == nullptr)
+	{
+		return;
+	}
+
+	for (UModelComponent* ModelComponent : Level->ModelComponents)
+	{
+		Unregister(ModelComponent);
+	}
+	for (AActor* Actor : Level->Actors)
+	{
+		if (Actor != nullptr)
+		{
+			TInlineComponentArray<UPrimitiveComponent*> Primitives(Actor);
+			for (UPrimitiveComponent* Primitive : Primitives)
+			{
+				Unregister(Primitive);
+			}
+		}
+	}
+}
+
+void AAfterCurfewSpatialHash::RegisterLevel(ULevel* Level)
+{
+	if (Level == nullptr)
+	{
+		return;
+	}
+
+	// BSP collision lives in the level's model components, which no actor owns
+	for (UModelComponent* ModelComponent : Level->ModelComponents)
+	{
+		Register(ModelComponent);
+	}
+	for (AActor* Actor : Level->Actors)
+	{
+		RegisterActor(Actor);
+	}
+}
+
+void AAfterCurfewSpatialHash::RegisterActor(AActor* Actor)
+{
+	// Bullets do not stop each other, and pooled ones come and go far too often to track
+	if (Actor == nullptr || Actor == this || Actor->IsPendingKill() || Actor->IsA<AAfterCurfewProjectile>())
+	{
+		return;
+	}
+
+	TInlineComponentArray<UPrimitiveComponent*> Primitives(Actor);
+	for (UPrimitiveComponent* Primitive : Primitives)
+	{
+		Register(Primitive);
+	}
+}
+
+void AAfterCurfewSpatialHash::Register(UPrimitiveComponent* Component)
+{
+	// Collision that is off for now is still added, sweeps check it is on before testing the component
+	if (Component == nullptr || !Component->IsRegistered() || Component->GetCollisionResponseToChannel(ProjectileChannel) != ECR_Block)
+	{
+		return;
+	}
+	if (ComponentToEntries.Contains(Component))
+	{
+		return;
+	}
+
+	// The component's own body is not set up for instanced meshes, each instance has one
+	const UInstancedStaticMeshComponent* Instanced = Cast<UInstancedStaticMeshComponent>(Component);
+	if (Instanced != nullptr)
+	{
+		for (int32 InstanceIndex = 0; InstanceIndex < Instanced->GetInstanceCount(); ++InstanceIndex)
+		{
+			AddEntry(Component, InstanceIndex);
+		}
+	}
+	else
+	{
+		AddEntry(Component, INDEX_NONE);
+	}
+
+	SET_DWORD_STAT(STAT_AfterCurfewSpatialHashEntries, Entries.Num());
+}
+
+void AAfterCurfewSpatialHash::AddEntry(UPrimitiveComponent* Component, int32 InstanceIndex)
+{
+	FEntry Entry;
+	Entry.Component = Component;
+	Entry.ComponentKey = Component;
+	Entry.InstanceIndex = InstanceIndex;
+	Entry.bMovable = Component->Mobility == EComponentMobility::Movable;
+	Entry.Bounds = GetEntryBounds(Component, InstanceIndex, Entry.bMovable);
+	Entry.CellMin = ToCell(Entry.Bounds.Min);
+	Entry.CellMax = ToCell(Entry.Bounds.Max);
+	Entry.QueryStamp = QueryStamp;
+
+	const int32 EntryIndex = Entries.Add(Entry);
+	ComponentToEntries.Add(Component, EntryIndex);
+	AddToCells(EntryIndex);
+}
+
+void AAfterCurfewSpatialHash::Unregister(UPrimitiveComponent* Component)
+{
+	TArray<int32, TInlineAllocator<16>> EntryIndices;
+	ComponentToEntries.MultiFind(Component, EntryIndices);
+	for (const int32 EntryIndex : EntryIndices)
+	{
+		RemoveEntry(EntryIndex);
+	}
+}
+
+void AAfterCurfewSpatialHash::RemoveEntry(int32 EntryIndex)
+{
+	RemoveFromCells(EntryIndex);
+	ComponentToEntries.RemoveSingle(Entries[EntryIndex].ComponentKey, EntryIndex);
+	Entries.RemoveAt(EntryIndex);
+}
+
+FBox AAfterCurfewSpatialHash::GetEntryBounds(const UPrimitiveComponent* Component, int32 InstanceIndex, bool bMovable) const
+{
+	FBox Bounds = Component->Bounds.GetBox();
+	if (InstanceIndex != INDEX_NONE)
+	{
+		const UInstancedStaticMeshComponent* Instanced = static_cast<const UInstancedStaticMeshComponent*>(Component);
+		FTransform InstanceTransform;
+		if (Instanced->GetStaticMesh() != nullptr && Instanced->GetInstanceTransform(InstanceIndex, InstanceTransform, true))
+		{
+			Bounds = Instanced->GetStaticMesh()->GetBounds().GetBox().TransformBy(InstanceTransform);
+		}
+	}
+	return bMovable ? Bounds.ExpandBy(Margin) : Bounds;
+}
+
+FBox AAfterCurfewSpatialHash::GetStaticBounds() const
+{
+	FBox Bounds(ForceInit);
+	for (const FEntry& Entry : Entries)
+	{
+		if (!Entry.bMovable)
+		{
+			Bounds += Entry.Bounds;
+		}
+	}
+	return Bounds;
+}
+
+void AAfterCurfewSpatialHash::AddToCells(int32 EntryIndex)
+{
+	const FEntry& Entry = Entries[EntryIndex];
+	for (int32 X = Entry.CellMin.X; X <= Entry.CellMax.X; ++X)
+	{
+		for (int32 Y = Entry.CellMin.Y; Y <= Entry.CellMax.Y; ++Y)
+		{
+			Cells.FindOrAdd(MakeCellKey(X, Y)).Add(EntryIndex);
+		}
+	}
+}
+
+void AAfterCurfewSpatialHash::RemoveFromCells(int32 EntryIndex)
+{
+	const FEntry& Entry = Entries[EntryIndex];
+	for (int32 X = Entry.CellMin.X; X <= Entry.CellMax.X; ++X)
+	{
+		for (int32 Y = Entry.CellMin.Y; Y <= Entry.CellMax.Y; ++Y)
+		{
+			const uint64 CellKey = MakeCellKey(X, Y);
+			if (TArray<int32>* Cell = Cells.Find(CellKey))
+			{
+				Cell->RemoveSingleSwap(EntryIndex, false);
+				if (Cell->Num() == 0)
+				{
+					Cells.Remove(CellKey);
+				}
+			}
+		}
+	}
+}
+
+void AAfterCurfewSpatialHash::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewSpatialHashUpdate);
+
+	for (const TWeakObjectPtr<AActor>& Actor : PendingActors)
+	{
+		RegisterActor(Actor.Get());
+	}
+	PendingActors.Reset();
+
+	// Movable entries only change cells when they cross a cell border, so most frames just refresh their bounds
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		FEntry& Entry = *It;
+		const UPrimitiveComponent* Component = Entry.Component.Get();
+		if (Component == nullptr)
+		{
+			RemoveEntry(It.GetIndex());
+			continue;
+		}
+		if (!Entry.bMovable)
+		{
+			continue;
+		}
+
+		Entry.Bounds = GetEntryBounds(Component, Entry.InstanceIndex, true);
+		const FIntPoint CellMin = ToCell(Entry.Bounds.Min);
+		const FIntPoint CellMax = ToCell(Entry.Bounds.Max);
+		if (CellMin != Entry.CellMin || CellMax != Entry.CellMax)
+		{
+			RemoveFromCells(It.GetIndex());
+			Entry.CellMin = CellMin;
+			Entry.CellMax = CellMax;
+			AddToCells(It.GetIndex());
+		}
+	}
+
+	SET_DWORD_STAT(STAT_AfterCurfewSpatialHashEntries, Entries.Num());
+	SET_MEMORY_STAT(STAT_AfterCurfewSpatialHashMemory, GetAllocatedSize());
+}
+
+SIZE_T AAfterCurfewSpatialHash::GetAllocatedSize() const
+{
+	SIZE_T Size = Entries.GetAllocatedSize() + ComponentToEntries.GetAllocatedSize() + Cells.GetAllocatedSize() + PendingActors.GetAllocatedSize();
+	for (const TPair<uint64, TArray<int32>>& Cell : Cells)
+	{
+		Size += Cell.Value.GetAllocatedSize();
+	}
+	return Size;
+}
+
+bool AAfterCurfewSpatialHash::SweepSphere(const FVector& Start, const FVector& End, float Radius, const AActor* IgnoreActor, FHitResult& OutHit)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewSpatialHashSweep);
+
+	const FVector Extent(Radius);
+	const FBox SweepBounds = FBox(Start.ComponentMin(End), Start.ComponentMax(End)).ExpandBy(Extent);
+	const FIntPoint CellMin = ToCell(SweepBounds.Min);
+	const FIntPoint CellMax = ToCell(SweepBounds.Max);
+	const FCollisionShape Sphere = FCollisionShape::MakeSphere(Radius);
+
+	// An entry spanning several cells is only tested the first time it is found
+	++QueryStamp;
+
+	bool bHit = false;
+	float BestTime = 1.f;
+	int32 NumCandidates = 0;
+	int32 NumNarrowPhase = 0;
+
+	for (int32 X = CellMin.X; X <= CellMax.X; ++X)
+	{
+		for (int32 Y = CellMin.Y; Y <= CellMax.Y; ++Y)
+		{
+			const TArray<int32>* Cell = Cells.Find(MakeCellKey(X, Y));
+			if (Cell == nullptr)
+			{
+				continue;
+			}
+
+			for (const int32 EntryIndex : *Cell)
+			{
+				FEntry& Entry = Entries[EntryIndex];
+				if (Entry.QueryStamp == QueryStamp)
+				{
+					continue;
+				}
+				Entry.QueryStamp = QueryStamp;
+				++NumCandidates;
+
+				if (!SweepBounds.Intersect(Entry.Bounds))
+				{
+					continue;
+				}
+
+				// Cheap test against the padded bounds, which also rejects anything behind the best hit so far
+				FVector BoxHitLocation;
+				FVector BoxHitNormal;
+				float BoxHitTime;
+				if (!FMath::LineExtentBoxIntersection(Entry.Bounds, Start, End, Extent, BoxHitLocation, BoxHitNormal, BoxHitTime) || BoxHitTime > BestTime)
+				{
+					continue;
+				}
+
+				UPrimitiveComponent* Component = Entry.Component.Get();
+				if (Component == nullptr || Component->GetOwner() == IgnoreActor || !Component->IsQueryCollisionEnabled() || Component->GetCollisionResponseToChannel(ProjectileChannel) != ECR_Block)
+				{
+					continue;
+				}
+
+				++NumNarrowPhase;
+
+				FHitResult Hit;
+				bool bEntryHit;
+				if (Entry.InstanceIndex != INDEX_NONE)
+				{
+					const UInstancedStaticMeshComponent* Instanced = static_cast<const UInstancedStaticMeshComponent*>(Component);
+					const FBodyInstance* InstanceBody = Instanced->InstanceBodies.IsValidIndex(Entry.InstanceIndex) ? Instanced->InstanceBodies[Entry.InstanceIndex] : nullptr;
+					bEntryHit = InstanceBody != nullptr && InstanceBody->Sweep(Hit, Start, End, FQuat::Identity, Sphere);
+				}
+				else
+				{
+					bEntryHit = Component->SweepComponent(Hit, Start, End, FQuat::Identity, Sphere);
+				}
+
+				if (bEntryHit && Hit.Time < BestTime)
+				{
+					BestTime = Hit.Time;
+					OutHit = Hit;
+					OutHit.Component = Component;
+					OutHit.Actor = Component->GetOwner();
+					OutHit.Item = Entry.InstanceIndex;
+					bHit = true;
+				}
+			}
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_AfterCurfewSpatialHashCandidates, NumCandidates);
+	INC_DWORD_STAT_BY(STAT_AfterCurfewSpatialHashNarrowPhase, NumNarrowPhase);
+
+	return bHit;
+}
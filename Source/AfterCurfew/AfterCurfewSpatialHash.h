@@ -0,0 +1,142 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "Engine/EngineTypes.h"
+#include "AfterCurfewSpatialHash.generated.h"
+
+class ULevel;
+class UPrimitiveComponent;
+
+/**
+ * Uniform grid over the arena's XY plane holding every primitive projectiles can hit.
+ * Static primitives are inserted once, movable ones are re-binned after physics each frame when they cross a cell
+ * border, so their bounds are padded by Margin to cover what they move before the next update.
+ * Projectile sweeps, actor and batched alike, only test the primitives in the cells they pass through, first against
+ * their padded bounds and then with a sweep against the single component, instead of going through the physics
+ * scene's broadphase.
+ * Instanced static meshes collide through a body per instance, so each instance is an entry of its own; instances
+ * added to a component after it was registered are not picked up.
+ *
+ * Holds the actors and the BSP of every visible level, following levels as they stream in and out. Primitives are
+ * added by whether their collision responses block projectiles, their collision may be switched on and off later,
+ * but a primitive that does not block projectiles when it is added, e.g. one with the NoCollision profile, never is.
+ */
+UCLASS(config=Game, notplaceable)
+class AFTERCURFEW_API AAfterCurfewSpatialHash : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewSpatialHash();
+
+	/** Returns the spatial hash for this world, creating and filling it on first use */
+	static AAfterCurfewSpatialHash* Get(UWorld* World);
+
+	/** Returns true if projectiles sweep the hash rather than the physics scene, ac.Projectile.SpatialHash */
+	static bool IsUsedByProjectiles();
+
+	// Begin Actor Interface
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+	// End Actor Interface
+
+	/** Adds every primitive of Actor that blocks projectiles */
+	void RegisterActor(AActor* Actor);
+
+	/** Adds the BSP and every actor of Level */
+	void RegisterLevel(ULevel* Level);
+
+	/** Adds Component if it blocks projectiles, movable components are kept up to date */
+	void Register(UPrimitiveComponent* Component);
+
+	void Unregister(UPrimitiveComponent* Component);
+
+	/** Sweeps a sphere from Start to End against the registered primitives, ignoring IgnoreActor, and returns the first blocking hit */
+	bool SweepSphere(const FVector& Start, const FVector& End, float Radius, const AActor* IgnoreActor, FHitResult& OutHit);
+
+	/** Number of registered primitives, counting each instance of an instanced component */
+	int32 GetNumEntries() const { return Entries.Num(); }
+
+	/** Returns the box holding every static entry */
+	FBox GetStaticBounds() const;
+
+	/** Bytes allocated for the entries and cells */
+	SIZE_T GetAllocatedSize() const;
+
+	/** Width of a grid cell in cm */
+	UPROPERTY(Category = SpatialHash, EditAnywhere, config, meta = (ClampMin = "50"))
+	float CellSize;
+
+	/** Padding added to the bounds of movable primitives, in cm */
+	UPROPERTY(Category = SpatialHash, EditAnywhere, config, meta = (ClampMin = "0"))
+	float Margin;
+
+private:
+	struct FEntry
+	{
+		TWeakObjectPtr<UPrimitiveComponent> Component;
+
+		/** Key in ComponentToEntries, only compared so the entry can be removed after the component is gone */
+		const UPrimitiveComponent* ComponentKey;
+
+		/** Instance of an instanced static mesh the entry stands for, INDEX_NONE for the whole component */
+		int32 InstanceIndex;
+
+		/** Bounds the entry is binned with, padded for movable components */
+		FBox Bounds;
+
+		/** Cells covered by Bounds */
+		FIntPoint CellMin;
+		FIntPoint CellMax;
+
+		/** Last query that tested this entry, so an entry spanning several cells is tested once */
+		uint32 QueryStamp;
+
+		uint32 bMovable : 1;
+	};
+
+	FORCEINLINE static uint64 MakeCellKey(int32 X, int32 Y) { return (uint64(uint32(X)) << 32) | uint32(Y); }
+
+	FORCEINLINE FIntPoint ToCell(const FVector& Location) const { return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize)); }
+
+	/** Returns the bounds Component, or its instance InstanceIndex, is binned with */
+	FBox GetEntryBounds(const UPrimitiveComponent* Component, int32 InstanceIndex, bool bMovable) const;
+
+	void AddEntry(UPrimitiveComponent* Component, int32 InstanceIndex);
+
+	void AddToCells(int32 EntryIndex);
+	void RemoveFromCells(int32 EntryIndex);
+	void RemoveEntry(int32 EntryIndex);
+
+	/** Queues actors spawned after us for registration */
+	void OnActorSpawned(AActor* Actor);
+
+	/** Follows levels streaming in and out of our world */
+	void OnLevelAdded(ULevel* Level, UWorld* World);
+	void OnLevelRemoved(ULevel* Level, UWorld* World);
+
+	/** Registered primitives, indices stay stable while others are removed */
+	TSparseArray<FEntry> Entries;
+
+	/** Entries of each registered component, one per instance for instanced components */
+	TMultiMap<const UPrimitiveComponent*, int32> ComponentToEntries;
+
+	/** Entry indices in each occupied cell */
+	TMap<uint64, TArray<int32>> Cells;
+
+	/** Object type projectiles sweep as */
+	TEnumAsByte<ECollisionChannel> ProjectileChannel;
+
+	uint32 QueryStamp;
+
+	/** Actors spawned since our last tick */
+	TArray<TWeakObjectPtr<AActor>> PendingActors;
+
+	FDelegateHandle ActorSpawnedHandle;
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
+};
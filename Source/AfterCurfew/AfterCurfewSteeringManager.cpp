@@ -0,0 +1,489 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewSteeringManager.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewAimComponent.h"
+#include "AfterCurfewGameMode.h"
+#include "AfterCurfewPawn.h"
+#include "AfterCurfewSnapshot.h"
+#include "AfterCurfewWorldManager.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("AI Steering Gather"), STAT_AfterCurfewSteeringGather, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("AI Steering Decide"), STAT_AfterCurfewSteeringDecide, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("AI Steering Evaluate"), STAT_AfterCurfewSteeringEvaluate, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("AI Steering Apply"), STAT_AfterCurfewSteeringApply, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("AI Agents"), STAT_AfterCurfewAIAgents, STATGROUP_AfterCurfew);
+
+/** Fewer agents than this are steered on the game thread */
+static const int32 MinParallelAgents = 64;
+
+/** Height difference to the target at which an agent climbs or dives at full lift */
+static const float LiftRange = 500.f;
+
+AAfterCurfewSteeringManager::AAfterCurfewSteeringManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	PreferredRange = 1500.f;
+	RangeTolerance = 300.f;
+	SeparationRadius = 400.f;
+	SensingRange = 6000.f;
+	ProbeDistance = 600.f;
+	ProbeRadius = 60.f;
+	ObstacleMemory = 1.f;
+	DecisionInterval = 0.5f;
+	StrafeSwitchChance = 0.25f;
+	SeekWeight = 1.f;
+	StrafeWeight = 0.7f;
+	SeparationWeight = 1.5f;
+	ObstacleWeight = 2.f;
+
+	BucketMask = 0;
+}
+
+AAfterCurfewSteeringManager* AAfterCurfewSteeringManager::Get(UWorld* World)
+{
+	return FindOrSpawnWorldManager<AAfterCurfewSteeringManager>(World);
+}
+
+void AAfterCurfewSteeringManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	const AAfterCurfewGameMode* GameMode = GetWorld()->GetAuthGameMode<AAfterCurfewGameMode>();
+	Random.Initialize(GameMode != nullptr ? GameMode->GetRandomSeed() : 0);
+
+	TraceService = AAfterCurfewTraceService::Get(GetWorld());
+}
+
+void AAfterCurfewSteeringManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	while (AgentPawns.Num() > 0)
+	{
+		UnregisterPawn(AgentPawns.Last());
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AAfterCurfewSteeringManager::RegisterPawn(AAfterCurfewPawn* Pawn)
+{
+	if (Pawn == nullptr || AgentPawns.Contains(Pawn))
+	{
+		return;
+	}
+
+	AgentPawns.Add(Pawn);
+
+	FAgent& Agent = Agents[Agents.AddDefaulted()];
+	Agent.ObstacleNormal = FVector::ZeroVector;
+	Agent.ObstacleUntil = 0.f;
+	Agent.NextDecisionTime = GetWorld()->GetTimeSeconds() + Random.FRand() * DecisionInterval;
+	Agent.StrafeSign = Random.FRand() < 0.5f ? -1.f : 1.f;
+	Agent.bHasLineOfSight = false;
+
+	Steering.Add(FVector::ZeroVector);
+
+	// Our intents have to land before the pawn turns them into a command
+	Pawn->AddTickPrerequisiteActor(this);
+}
+
+void AAfterCurfewSteeringManager::UnregisterPawn(AAfterCurfewPawn* Pawn)
+{
+	const int32 Index = AgentPawns.Find(Pawn);
+	if (Index == INDEX_NONE)
+	{
+		return;
+	}
+
+	if (TraceService.IsValid())
+	{
+		TraceService->Cancel(Agents[Index].SightTrace);
+		TraceService->Cancel(Agents[Index].ProbeTrace);
+	}
+
+	if (IsValid(Pawn))
+	{
+		Pawn->RemoveTickPrerequisiteActor(this);
+		Pawn->SetMoveIntent(FVector::ZeroVector);
+		Pawn->StopFiring();
+		Pawn->GetAimComponent()->ClearAimTarget();
+	}
+
+	AgentPawns.RemoveAtSwap(Index, 1, false);
+	Agents.RemoveAtSwap(Index, 1, false);
+	Steering.RemoveAtSwap(Index, 1, false);
+}
+
+void AAfterCurfewSteeringManager::CaptureAgents(FAfterCurfewSnapshot& OutSnapshot, const TMap<const AActor*, int32>& PawnIndices) const
+{
+	const float Now = GetWorld()->GetTimeSeconds();
+	OutSnapshot.SteeringSeed = Random.GetCurrentSeed();
+
+	for (int32 Index = 0; Index < AgentPawns.Num(); ++Index)
+	{
+		const int32* PawnIndex = PawnIndices.Find(AgentPawns[Index]);
+		if (PawnIndex == nullptr)
+		{
+			continue;
+		}
+
+		const FAgent& Agent = Agents[Index];
+		const int32* TargetIndex = Agent.Target.IsValid() ? PawnIndices.Find(Agent.Target.Get()) : nullptr;
+
+		FAfterCurfewPawnSnapshot& Saved = OutSnapshot.Pawns[*PawnIndex];
+		Saved.Flags |= FAfterCurfewPawnSnapshot::AgentFlag;
+		Saved.Flags |= Agent.StrafeSign < 0.f ? FAfterCurfewPawnSnapshot::ReverseStrafeFlag : 0;
+		Saved.Flags |= Agent.bHasLineOfSight ? FAfterCurfewPawnSnapshot::LineOfSightFlag : 0;
+		Saved.TargetIndex = TargetIndex != nullptr ? *TargetIndex : INDEX_NONE;
+		Saved.NextDecisionDelay = Agent.NextDecisionTime - Now;
+		Saved.ObstacleTimeLeft = FMath::Max(Agent.ObstacleUntil - Now, 0.f);
+		Saved.ObstacleNormal = Agent.ObstacleNormal;
+	}
+}
+
+void AAfterCurfewSteeringManager::RestoreAgents(const FAfterCurfewSnapshot& Snapshot, const TArray<AAfterCurfewPawn*>& Pawns)
+{
+	// World time goes on from where it is, the saved timers run from now
+	const float Now = GetWorld()->GetTimeSeconds();
+	Random.Initialize(Snapshot.SteeringSeed);
+
+	for (int32 PawnIndex = 0; PawnIndex < Pawns.Num() && PawnIndex < Snapshot.Pawns.Num(); ++PawnIndex)
+	{
+		const FAfterCurfewPawnSnapshot& Saved = Snapshot.Pawns[PawnIndex];
+		const int32 Index = AgentPawns.Find(Pawns[PawnIndex]);
+		if (Index == INDEX_NONE || (Saved.Flags & FAfterCurfewPawnSnapshot::AgentFlag) == 0)
+		{
+			continue;
+		}
+
+		// What a trace in flight would report no longer holds
+		FAgent& Agent = Agents[Index];
+		if (TraceService.IsValid())
+		{
+			TraceService->Cancel(Agent.SightTrace);
+			TraceService->Cancel(Agent.ProbeTrace);
+		}
+		Agent.SightTrace.Reset();
+		Agent.ProbeTrace.Reset();
+
+		Agent.Target = Pawns.IsValidIndex(Saved.TargetIndex) ? Pawns[Saved.TargetIndex] : nullptr;
+		Agent.bHasLineOfSight = (Saved.Flags & FAfterCurfewPawnSnapshot::LineOfSightFlag) != 0;
+		Agent.StrafeSign = (Saved.Flags & FAfterCurfewPawnSnapshot::ReverseStrafeFlag) != 0 ? -1.f : 1.f;
+		Agent.NextDecisionTime = Now + Saved.NextDecisionDelay;
+		Agent.ObstacleUntil = Saved.ObstacleTimeLeft > 0.f ? Now + Saved.ObstacleTimeLeft : 0.f;
+		Agent.ObstacleNormal = Saved.ObstacleNormal;
+	}
+}
+
+int32 AAfterCurfewSteeringManager::GetBucket(int32 CellX, int32 CellY) const
+{
+	return (int32)(((uint32)CellX * 73856093u) ^ ((uint32)CellY * 19349663u)) & BucketMask;
+}
+
+int32 AAfterCurfewSteeringManager::GetBucket(const FVector& Location) const
+{
+	return GetBucket(FMath::FloorToInt(Location.X / SeparationRadius), FMath::FloorToInt(Location.Y / SeparationRadius));
+}
+
+void AAfterCurfewSteeringManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	for (int32 Index = AgentPawns.Num() - 1; Index >= 0; --Index)
+	{
+		if (!IsValid(AgentPawns[Index]))
+		{
+			UnregisterPawn(AgentPawns[Index]);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_AfterCurfewAIAgents, AgentPawns.Num());
+
+	if (AgentPawns.Num() == 0)
+	{
+		return;
+	}
+
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	Gather();
+	Decide(Now);
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_AfterCurfewSteeringEvaluate);
+		ParallelFor(AgentPawns.Num(), [this, Now](int32 Index)
+		{
+			Steer(Index, Now);
+		}, AgentPawns.Num() < MinParallelAgents);
+	}
+
+	Apply();
+}
+
+void AAfterCurfewSteeringManager::Gather()
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewSteeringGather);
+
+	const int32 NumAgents = AgentPawns.Num();
+
+	// Agents come first so an agent's entity index is its agent index
+	Entities.Reset();
+	Entities.Append(AgentPawns);
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		AAfterCurfewPawn* PlayerPawn = PlayerController != nullptr ? Cast<AAfterCurfewPawn>(PlayerController->GetPawn()) : nullptr;
+		if (PlayerPawn != nullptr)
+		{
+			Entities.Add(PlayerPawn);
+		}
+	}
+
+	const int32 NumEntities = Entities.Num();
+	Locations.SetNumUninitialized(NumEntities, false);
+	for (int32 Index = 0; Index < NumEntities; ++Index)
+	{
+		Locations[Index] = Entities[Index]->GetActorLocation();
+	}
+
+	TargetLocations.SetNumUninitialized(NumAgents, false);
+	HasTarget.SetNumUninitialized(NumAgents, false);
+	for (int32 Index = 0; Index < NumAgents; ++Index)
+	{
+		const AAfterCurfewPawn* Target = Agents[Index].Target.Get();
+		HasTarget[Index] = Target != nullptr;
+		TargetLocations[Index] = Target != nullptr ? Target->GetActorLocation() : Locations[Index];
+	}
+
+	// Counting sort of the entities by bucket, so neighbours are read from one contiguous run per cell
+	const int32 NumBuckets = FMath::RoundUpToPowerOfTwo(FMath::Max(NumEntities * 2, 16));
+	BucketMask = NumBuckets - 1;
+
+	BucketStart.Reset();
+	BucketStart.AddZeroed(NumBuckets + 1);
+	EntityBuckets.SetNumUninitialized(NumEntities, false);
+	for (int32 Index = 0; Index < NumEntities; ++Index)
+	{
+		const int32 Bucket = GetBucket(Locations[Index]);
+		EntityBuckets[Index] = Bucket;
+		++BucketStart[Bucket];
+	}
+	for (int32 Bucket = 1; Bucket < NumBuckets; ++Bucket)
+	{
+		BucketStart[Bucket] += BucketStart[Bucket - 1];
+	}
+	BucketStart[NumBuckets] = NumEntities;
+
+	BucketEntities.SetNumUninitialized(NumEntities, false);
+	for (int32 Index = NumEntities - 1; Index >= 0; --Index)
+	{
+		BucketEntities[--BucketStart[EntityBuckets[Index]]] = Index;
+	}
+}
+
+void AAfterCurfewSteeringManager::Decide(float Now)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewSteeringDecide);
+
+	AAfterCurfewTraceService* Traces = TraceService.Get();
+	const float SensingRangeSquared = FMath::Square(SensingRange);
+
+	for (int32 Index = 0; Index < Agents.Num(); ++Index)
+	{
+		FAgent& Agent = Agents[Index];
+		AAfterCurfewPawn* Pawn = AgentPawns[Index];
+
+		// Traces requested on an earlier frame
+		if (Traces != nullptr)
+		{
+			FHitResult Hit;
+			const EAfterCurfewTraceStatus SightStatus = Traces->FetchResult(Agent.SightTrace, Hit);
+			if (SightStatus != EAfterCurfewTraceStatus::Pending)
+			{
+				if (SightStatus == EAfterCurfewTraceStatus::Done)
+				{
+					Agent.bHasLineOfSight = !Hit.bBlockingHit;
+				}
+				Agent.SightTrace.Reset();
+			}
+
+			const EAfterCurfewTraceStatus ProbeStatus = Traces->FetchResult(Agent.ProbeTrace, Hit);
+			if (ProbeStatus != EAfterCurfewTraceStatus::Pending)
+			{
+				if (ProbeStatus == EAfterCurfewTraceStatus::Done && Hit.bBlockingHit)
+				{
+					Agent.ObstacleNormal = FVector(Hit.ImpactNormal.X, Hit.ImpactNormal.Y, 0.f).GetSafeNormal();
+					Agent.ObstacleUntil = Now + ObstacleMemory;
+				}
+				Agent.ProbeTrace.Reset();
+			}
+		}
+
+		if (Now < Agent.NextDecisionTime)
+		{
+			continue;
+		}
+		Agent.NextDecisionTime = Now + DecisionInterval;
+
+		// Nearest pawn in range, a linear scan over the packed locations
+		const FVector Location = Locations[Index];
+		int32 NearestIndex = INDEX_NONE;
+		float NearestDistanceSquared = SensingRangeSquared;
+		for (int32 Other = 0; Other < Locations.Num(); ++Other)
+		{
+			const float DistanceSquared = FVector::DistSquared(Location, Locations[Other]);
+			if (Other != Index && DistanceSquared < NearestDistanceSquared)
+			{
+				NearestIndex = Other;
+				NearestDistanceSquared = DistanceSquared;
+			}
+		}
+
+		AAfterCurfewPawn* NewTarget = NearestIndex != INDEX_NONE ? Entities[NearestIndex] : nullptr;
+		if (NewTarget != Agent.Target.Get())
+		{
+			Agent.Target = NewTarget;
+			Agent.bHasLineOfSight = false;
+		}
+		HasTarget[Index] = NewTarget != nullptr;
+		TargetLocations[Index] = NewTarget != nullptr ? Locations[NearestIndex] : Location;
+
+		if (Random.FRand() < StrafeSwitchChance)
+		{
+			Agent.StrafeSign = -Agent.StrafeSign;
+		}
+
+		if (Traces == nullptr)
+		{
+			continue;
+		}
+
+		// Sight only matters with a target, the probe looks where we are heading
+		Traces->Cancel(Agent.SightTrace);
+		Traces->Cancel(Agent.ProbeTrace);
+
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(AfterCurfewAISight), false, Pawn);
+		if (NewTarget != nullptr)
+		{
+			QueryParams.AddIgnoredActor(NewTarget);
+			Agent.SightTrace = Traces->RequestLineTrace(Location, TargetLocations[Index], ECC_Visibility, QueryParams, EAfterCurfewTracePriority::Normal);
+		}
+
+		const FVector Heading = FVector(Steering[Index].X, Steering[Index].Y, 0.f).GetSafeNormal();
+		if (!Heading.IsZero())
+		{
+			const FCollisionQueryParams ProbeParams(SCENE_QUERY_STAT(AfterCurfewAIProbe), false, Pawn);
+			Agent.ProbeTrace = Traces->RequestSweep(Location, Location + Heading * ProbeDistance, ECC_Pawn, FCollisionShape::MakeSphere(ProbeRadius), ProbeParams, EAfterCurfewTracePriority::Low);
+		}
+	}
+}
+
+void AAfterCurfewSteeringManager::Steer(int32 Index, float Now)
+{
+	const FAgent& Agent = Agents[Index];
+	const FVector Location = Locations[Index];
+
+	FVector Move = FVector::ZeroVector;
+	float Lift = 0.f;
+
+	// Close in or back off to hold our range, and circle the target while in it
+	if (HasTarget[Index])
+	{
+		const FVector ToTarget = TargetLocations[Index] - Location;
+		const FVector ToTargetPlanar(ToTarget.X, ToTarget.Y, 0.f);
+		const float Distance = ToTargetPlanar.Size();
+		if (Distance > KINDA_SMALL_NUMBER)
+		{
+			const FVector Direction = ToTargetPlanar / Distance;
+			if (Distance > PreferredRange + RangeTolerance)
+			{
+				Move += Direction * SeekWeight;
+			}
+			else if (Distance < PreferredRange - RangeTolerance)
+			{
+				Move -= Direction * SeekWeight;
+			}
+			Move += FVector(-Direction.Y, Direction.X, 0.f) * (Agent.StrafeSign * StrafeWeight);
+		}
+		Lift = FMath::Clamp(ToTarget.Z / LiftRange, -1.f, 1.f);
+	}
+
+	// Push away from everyone in the surrounding cells, each bucket read once even if two cells share it
+	const int32 CellX = FMath::FloorToInt(Location.X / SeparationRadius);
+	const int32 CellY = FMath::FloorToInt(Location.Y / SeparationRadius);
+	int32 VisitedBuckets[9];
+	int32 NumVisited = 0;
+	for (int32 OffsetY = -1; OffsetY <= 1; ++OffsetY)
+	{
+		for (int32 OffsetX = -1; OffsetX <= 1; ++OffsetX)
+		{
+			const int32 Bucket = GetBucket(CellX + OffsetX, CellY + OffsetY);
+			bool bVisited = false;
+			for (int32 Visited = 0; Visited < NumVisited; ++Visited)
+			{
+				bVisited |= VisitedBuckets[Visited] == Bucket;
+			}
+			if (bVisited)
+			{
+				continue;
+			}
+			VisitedBuckets[NumVisited++] = Bucket;
+
+			for (int32 Entry = BucketStart[Bucket]; Entry < BucketStart[Bucket + 1]; ++Entry)
+			{
+				const int32 Other = BucketEntities[Entry];
+				const FVector Away(Location.X - Locations[Other].X, Location.Y - Locations[Other].Y, 0.f);
+				const float Distance = Away.Size();
+				if (Other != Index && Distance < SeparationRadius && Distance > KINDA_SMALL_NUMBER)
+				{
+					Move += Away / Distance * ((1.f - Distance / SeparationRadius) * SeparationWeight);
+				}
+			}
+		}
+	}
+
+	if (Now < Agent.ObstacleUntil)
+	{
+		Move += Agent.ObstacleNormal * ObstacleWeight;
+	}
+
+	Move = Move.GetClampedToMaxSize(1.f);
+	Steering[Index] = FVector(Move.X, Move.Y, Lift);
+}
+
+void AAfterCurfewSteeringManager::Apply()
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewSteeringApply);
+
+	for (int32 Index = 0; Index < AgentPawns.Num(); ++Index)
+	{
+		AAfterCurfewPawn* Pawn = AgentPawns[Index];
+		const FVector& Move = Steering[Index];
+		Pawn->SetMoveIntent(Move);
+
+		UAfterCurfewAimComponent* Aim = Pawn->GetAimComponent();
+		if (HasTarget[Index])
+		{
+			Aim->SetAimTarget(TargetLocations[Index]);
+		}
+		else if (!FMath::IsNearlyZero(Move.X) || !FMath::IsNearlyZero(Move.Y))
+		{
+			Aim->SetAimTarget(Locations[Index] + FVector(Move.X, Move.Y, 0.f) * 1000.f);
+		}
+
+		if (HasTarget[Index] && Agents[Index].bHasLineOfSight)
+		{
+			Pawn->StartFiring();
+		}
+		else
+		{
+			Pawn->StopFiring();
+		}
+	}
+}
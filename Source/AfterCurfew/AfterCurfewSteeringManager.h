@@ -0,0 +1,163 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "AfterCurfewTraceService.h"
+#include "AfterCurfewSteeringManager.generated.h"
+
+class AAfterCurfewPawn;
+struct FAfterCurfewSnapshot;
+
+/**
+ * Steers every AI controlled AfterCurfew pawn in a world.
+ * Each frame the agents' locations are gathered into flat arrays and binned into a grid, and the steering of all
+ * agents is evaluated together: seek or back off to hold PreferredRange from the target, strafe around it, keep
+ * clear of close neighbours and turn away from obstacles ahead. The result is handed to each pawn as move, lift,
+ * aim and fire intents before the pawns tick.
+ * Every DecisionInterval an agent picks the nearest pawn as its target and requests a line of sight trace to it and
+ * a probe sweep ahead of it from the trace service, an agent only fires while it sees its target.
+ */
+UCLASS(config=Game, notplaceable)
+class AFTERCURFEW_API AAfterCurfewSteeringManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewSteeringManager();
+
+	/** Returns the steering manager for this world, creating it on first use */
+	static AAfterCurfewSteeringManager* Get(UWorld* World);
+
+	// Begin Actor Interface
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+	// End Actor Interface
+
+	/** Starts steering Pawn */
+	void RegisterPawn(AAfterCurfewPawn* Pawn);
+
+	/** Stops steering Pawn and clears its intents */
+	void UnregisterPawn(AAfterCurfewPawn* Pawn);
+
+	/** Number of pawns we steer */
+	FORCEINLINE int32 GetNumAgents() const { return AgentPawns.Num(); }
+
+	/** Saves our random stream and the decision state of every agent to the entries of their pawns, found through PawnIndices */
+	void CaptureAgents(FAfterCurfewSnapshot& OutSnapshot, const TMap<const AActor*, int32>& PawnIndices) const;
+
+	/** Puts our random stream and the agents among Pawns, in snapshot order, back in the state of Snapshot */
+	void RestoreAgents(const FAfterCurfewSnapshot& Snapshot, const TArray<AAfterCurfewPawn*>& Pawns);
+
+	/** Distance agents try to hold from their target, in cm */
+	UPROPERTY(Category = Steering, EditAnywhere, config)
+	float PreferredRange;
+
+	/** How far from PreferredRange an agent may drift before it closes in or backs off */
+	UPROPERTY(Category = Steering, EditAnywhere, config)
+	float RangeTolerance;
+
+	/** Agents closer than this push each other apart, also the size of a grid cell */
+	UPROPERTY(Category = Steering, EditAnywhere, config, meta = (ClampMin = "1"))
+	float SeparationRadius;
+
+	/** Farthest a target is picked from */
+	UPROPERTY(Category = Steering, EditAnywhere, config)
+	float SensingRange;
+
+	/** How far ahead an agent probes for obstacles */
+	UPROPERTY(Category = Steering, EditAnywhere, config)
+	float ProbeDistance;
+
+	/** Radius of the obstacle probe */
+	UPROPERTY(Category = Steering, EditAnywhere, config)
+	float ProbeRadius;
+
+	/** Seconds an obstacle found by a probe keeps pushing the agent away */
+	UPROPERTY(Category = Steering, EditAnywhere, config)
+	float ObstacleMemory;
+
+	/** Seconds between an agent's target choices and traces */
+	UPROPERTY(Category = Steering, EditAnywhere, config, meta = (ClampMin = "0.01"))
+	float DecisionInterval;
+
+	/** Chance an agent reverses its strafe direction when it decides */
+	UPROPERTY(Category = Steering, EditAnywhere, config, meta = (ClampMin = "0", ClampMax = "1"))
+	float StrafeSwitchChance;
+
+	UPROPERTY(Category = Steering, EditAnywhere, config)
+	float SeekWeight;
+
+	UPROPERTY(Category = Steering, EditAnywhere, config)
+	float StrafeWeight;
+
+	UPROPERTY(Category = Steering, EditAnywhere, config)
+	float SeparationWeight;
+
+	UPROPERTY(Category = Steering, EditAnywhere, config)
+	float ObstacleWeight;
+
+private:
+	/** Decision state of one agent, parallel to AgentPawns */
+	struct FAgent
+	{
+		TWeakObjectPtr<AAfterCurfewPawn> Target;
+		FVector ObstacleNormal;
+		float ObstacleUntil;
+		float NextDecisionTime;
+		float StrafeSign;
+		FAfterCurfewTraceHandle SightTrace;
+		FAfterCurfewTraceHandle ProbeTrace;
+		bool bHasLineOfSight;
+	};
+
+	/** Copies the locations of every pawn that may be a target, agents first, and bins them into the grid */
+	void Gather();
+
+	/** Picks up finished traces and lets the agents due for it choose a target and trace again */
+	void Decide(float Now);
+
+	/** Evaluates the steering of agent Index from the gathered arrays only, safe to run on any thread */
+	void Steer(int32 Index, float Now);
+
+	/** Hands the steering result to every agent's pawn */
+	void Apply();
+
+	/** Returns the grid bucket Location falls in */
+	int32 GetBucket(const FVector& Location) const;
+	int32 GetBucket(int32 CellX, int32 CellY) const;
+
+	/** Steered pawns */
+	UPROPERTY(Transient)
+	TArray<AAfterCurfewPawn*> AgentPawns;
+
+	TArray<FAgent> Agents;
+
+	/** Pawns agents may target this frame, the agents followed by player pawns */
+	TArray<AAfterCurfewPawn*> Entities;
+
+	/** Location of each entry of Entities */
+	TArray<FVector> Locations;
+
+	/** Per agent, where its target is and whether it has one */
+	TArray<FVector> TargetLocations;
+	TArray<bool> HasTarget;
+
+	/** Per agent steering result, X and Y move input and Z lift input */
+	TArray<FVector> Steering;
+
+	/** Entities sorted by grid bucket, bucket B holds BucketEntities[BucketStart[B]] to BucketEntities[BucketStart[B + 1] - 1] */
+	TArray<int32> BucketStart;
+	TArray<int32> BucketEntities;
+	TArray<int32> EntityBuckets;
+
+	/** Number of grid buckets minus one, the bucket count is a power of two */
+	int32 BucketMask;
+
+	TWeakObjectPtr<AAfterCurfewTraceService> TraceService;
+
+	/** Stream strafe decisions are drawn from, seeded from the game mode. AI only runs where the game mode is, so no other machine draws from it */
+	FRandomStream Random;
+};
@@ -0,0 +1,184 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewTelemetry.h"
+#include "AfterCurfewWorldManager.h"
+#include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "RenderCore.h"
+#include "Serialization/JsonWriter.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+
+DECLARE_CYCLE_STAT(TEXT("Telemetry Sample"), STAT_AfterCurfewTelemetrySample, STATGROUP_AfterCurfew);
+
+static void DumpTelemetry(const TArray<FString>& Args, UWorld* World)
+{
+	if (AAfterCurfewTelemetry* Telemetry = AAfterCurfewTelemetry::Get(World))
+	{
+		const bool bJson = Args.Num() > 0 && Args[0].Equals(TEXT("json"), ESearchCase::IgnoreCase);
+		Telemetry->Dump(TEXT("Manual"), bJson ? EAfterCurfewTelemetryFormat::Json : EAfterCurfewTelemetryFormat::Csv);
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs DumpTelemetryCommand(
+	TEXT("ac.Telemetry.Dump"),
+	TEXT("Writes the last frames of telemetry to Saved/Telemetry, as CSV or as JSON with 'json'."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&DumpTelemetry));
+
+AAfterCurfewTelemetry::AAfterCurfewTelemetry()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+	PrimaryActorTick.bTickEvenWhenPaused = true;
+
+	HitchThresholdMs = 100.f;
+	PostHitchFrames = 60;
+	MinSecondsBetweenHitchDumps = 30.f;
+	HitchDumpFormat = EAfterCurfewTelemetryFormat::Csv;
+
+	LastSampleTime = 0.0;
+	HitchDumpCountdown = INDEX_NONE;
+	LastHitchDumpTime = -BIG_NUMBER;
+}
+
+AAfterCurfewTelemetry* AAfterCurfewTelemetry::Get(UWorld* World)
+{
+	return FindOrSpawnWorldManager<AAfterCurfewTelemetry>(World);
+}
+
+void AAfterCurfewTelemetry::BeginPlay()
+{
+	Super::BeginPlay();
+
+	DumpSamples.Reserve(FSamples::Max());
+	LastCounters = GAfterCurfewCounters;
+	LastSampleTime = FPlatformTime::Seconds();
+}
+
+void AAfterCurfewTelemetry::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (PendingDump.IsValid())
+	{
+		PendingDump.Wait();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AAfterCurfewTelemetry::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewTelemetrySample);
+
+	const double Now = FPlatformTime::Seconds();
+	const FAfterCurfewCounters& Counters = GAfterCurfewCounters;
+
+	FAfterCurfewTelemetrySample Sample;
+	Sample.Frame = uint32(GFrameCounter);
+	Sample.WorldTime = GetWorld()->GetTimeSeconds();
+	Sample.FrameMs = float((Now - LastSampleTime) * 1000.0);
+	Sample.GameThreadMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+	Sample.PawnTickMs = float(FPlatformTime::ToMilliseconds64(Counters.PawnTickCycles - LastCounters.PawnTickCycles));
+	Sample.ProjectilesAlive = uint32(FMath::Max<int64>(Counters.GetProjectilesAlive(), 0));
+	Sample.ProjectilesSpawned = uint32(Counters.ProjectilesSpawned - LastCounters.ProjectilesSpawned);
+	Sample.MoveSweeps = uint32(Counters.MoveSweeps - LastCounters.MoveSweeps);
+	Sample.ProjectileSweeps = uint32(Counters.ProjectileSweeps - LastCounters.ProjectileSweeps);
+	Samples.Push(Sample);
+
+	LastCounters = Counters;
+	LastSampleTime = Now;
+
+	// The first frame includes loading, it is never a hitch
+	const bool bHitch = HitchThresholdMs > 0.f && Sample.FrameMs > HitchThresholdMs && Samples.Num() > 1;
+	if (bHitch && HitchDumpCountdown == INDEX_NONE && Now - LastHitchDumpTime >= MinSecondsBetweenHitchDumps)
+	{
+		UE_LOG(LogAfterCurfew, Log, TEXT("Telemetry: %.1fms hitch on frame %u"), Sample.FrameMs, Sample.Frame);
+		HitchDumpCountdown = PostHitchFrames;
+		LastHitchDumpTime = Now;
+	}
+
+	if (HitchDumpCountdown != INDEX_NONE && HitchDumpCountdown-- == 0)
+	{
+		HitchDumpCountdown = INDEX_NONE;
+		Dump(TEXT("Hitch"), HitchDumpFormat);
+	}
+}
+
+void AAfterCurfewTelemetry::Dump(const TCHAR* Reason, EAfterCurfewTelemetryFormat Format)
+{
+	// The copy is reused, so it must not change under a write still in progress
+	if (PendingDump.IsValid() && !PendingDump.IsReady())
+	{
+		UE_LOG(LogAfterCurfew, Warning, TEXT("Telemetry: still writing the last dump, skipped a %s dump"), Reason);
+		return;
+	}
+
+	DumpSamples.Reset();
+	for (int32 Index = 0; Index < Samples.Num(); ++Index)
+	{
+		DumpSamples.Add(Samples[Index]);
+	}
+
+	const FString File = FPaths::ProjectSavedDir() / TEXT("Telemetry") / FString::Printf(TEXT("AfterCurfew-%s-%s.%s"), Reason, *FDateTime::Now().ToString(), Format == EAfterCurfewTelemetryFormat::Json ? TEXT("json") : TEXT("csv"));
+	const TArray<FAfterCurfewTelemetrySample>* const SamplesToWrite = &DumpSamples;
+	const FString ReasonString(Reason);
+	PendingDump = Async<bool>(EAsyncExecution::ThreadPool, [SamplesToWrite, ReasonString, Format, File]()
+	{
+		return WriteDump(*SamplesToWrite, ReasonString, Format, File);
+	});
+}
+
+bool AAfterCurfewTelemetry::WriteDump(const TArray<FAfterCurfewTelemetrySample>& DumpSamples, const FString& Reason, EAfterCurfewTelemetryFormat Format, const FString& File)
+{
+	FString Text;
+	if (Format == EAfterCurfewTelemetryFormat::Json)
+	{
+		TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Text);
+		Writer->WriteObjectStart();
+		Writer->WriteValue(TEXT("reason"), Reason);
+		Writer->WriteArrayStart(TEXT("frames"));
+		for (const FAfterCurfewTelemetrySample& Sample : DumpSamples)
+		{
+			Writer->WriteObjectStart();
+			Writer->WriteValue(TEXT("frame"), int64(Sample.Frame));
+			Writer->WriteValue(TEXT("world_time"), Sample.WorldTime);
+			Writer->WriteValue(TEXT("frame_ms"), Sample.FrameMs);
+			Writer->WriteValue(TEXT("game_thread_ms"), Sample.GameThreadMs);
+			Writer->WriteValue(TEXT("pawn_tick_ms"), Sample.PawnTickMs);
+			Writer->WriteValue(TEXT("projectiles_alive"), int64(Sample.ProjectilesAlive));
+			Writer->WriteValue(TEXT("projectile_spawns"), int64(Sample.ProjectilesSpawned));
+			Writer->WriteValue(TEXT("move_sweeps"), int64(Sample.MoveSweeps));
+			Writer->WriteValue(TEXT("projectile_sweeps"), int64(Sample.ProjectileSweeps));
+			Writer->WriteObjectEnd();
+		}
+		Writer->WriteArrayEnd();
+		Writer->WriteObjectEnd();
+		Writer->Close();
+	}
+	else
+	{
+		// About 64 characters a line
+		Text.Reserve((DumpSamples.Num() + 1) * 64);
+		Text += TEXT("frame,world_time,frame_ms,game_thread_ms,pawn_tick_ms,projectiles_alive,projectile_spawns,move_sweeps,projectile_sweeps\n");
+		for (const FAfterCurfewTelemetrySample& Sample : DumpSamples)
+		{
+			Text += FString::Printf(TEXT("%u,%.4f,%.3f,%.3f,%.3f,%u,%u,%u,%u\n"), Sample.Frame, Sample.WorldTime, Sample.FrameMs, Sample.GameThreadMs, Sample.PawnTickMs,
+				Sample.ProjectilesAlive, Sample.ProjectilesSpawned, Sample.MoveSweeps, Sample.ProjectileSweeps);
+		}
+	}
+
+	const bool bSaved = FFileHelper::SaveStringToFile(Text, *File);
+	if (bSaved)
+	{
+		UE_LOG(LogAfterCurfew, Log, TEXT("Telemetry: wrote %d frames to %s"), DumpSamples.Num(), *File);
+	}
+	else
+	{
+		UE_LOG(LogAfterCurfew, Warning, TEXT("Telemetry: could not write %s"), *File);
+	}
+	return bSaved;
+}
@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "Async/Future.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewRingBuffer.h"
+#include "AfterCurfewTelemetry.generated.h"
+
+/** File format of a telemetry dump */
+UENUM()
+enum class EAfterCurfewTelemetryFormat : uint8
+{
+	/** One line per frame under a header line */
+	Csv,
+	/** An object with the dump's reason and an array of one object per frame */
+	Json,
+};
+
+/** What the module did in one frame, 36 bytes */
+struct FAfterCurfewTelemetrySample
+{
+	/** Engine frame number */
+	uint32 Frame;
+
+	/** World time at the end of the frame */
+	float WorldTime;
+
+	/** Wall time since the previous sample */
+	float FrameMs;
+
+	/** Game thread time of the last drawn frame as stat unit shows it, zero where nothing is drawn */
+	float GameThreadMs;
+
+	/** Time spent in AAfterCurfewPawn::Tick */
+	float PawnTickMs;
+
+	uint32 ProjectilesAlive;
+	uint32 ProjectilesSpawned;
+	uint32 MoveSweeps;
+	uint32 ProjectileSweeps;
+
+	FAfterCurfewTelemetrySample()
+		: Frame(0)
+		, WorldTime(0.f)
+		, FrameMs(0.f)
+		, GameThreadMs(0.f)
+		, PawnTickMs(0.f)
+		, ProjectilesAlive(0)
+		, ProjectilesSpawned(0)
+		, MoveSweeps(0)
+		, ProjectileSweeps(0)
+	{
+	}
+};
+
+/**
+ * Always-on recorder of per-frame performance, for diagnosing hitches from the field.
+ * Every frame one sample is pushed into a ring buffer of the last 1024 frames that never allocates. When a frame
+ * takes longer than HitchThresholdMs the window is dumped PostHitchFrames later, so the file shows the run-up to the
+ * hitch and the recovery from it. ac.Telemetry.Dump dumps it on demand.
+ * Dumps copy the window into a buffer reserved up front and are formatted and written on the thread pool, to
+ * Saved/Telemetry. A dump asked for while the previous one is still being written is skipped.
+ */
+UCLASS(config=Game, notplaceable)
+class AFTERCURFEW_API AAfterCurfewTelemetry : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewTelemetry();
+
+	/** Returns the telemetry recorder of this world, creating it on first use */
+	static AAfterCurfewTelemetry* Get(UWorld* World);
+
+	// Begin Actor Interface
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+	// End Actor Interface
+
+	/** Writes the recorded window to a file on the thread pool, Reason ends up in the file name */
+	void Dump(const TCHAR* Reason, EAfterCurfewTelemetryFormat Format);
+
+	/** Frames kept in memory */
+	typedef TAfterCurfewRingBuffer<FAfterCurfewTelemetrySample, 1024> FSamples;
+
+	/** Returns the recorded window, oldest first */
+	FORCEINLINE const FSamples& GetSamples() const { return Samples; }
+
+	/** Frames longer than this are hitches, in milliseconds, zero turns hitch dumps off */
+	UPROPERTY(Category = Telemetry, EditAnywhere, config)
+	float HitchThresholdMs;
+
+	/** Frames recorded after a hitch before the window is dumped */
+	UPROPERTY(Category = Telemetry, EditAnywhere, config, meta = (ClampMin = "0", ClampMax = "512"))
+	int32 PostHitchFrames;
+
+	/** Fewest seconds between two hitch dumps, so a bad stretch does not write a file every few frames */
+	UPROPERTY(Category = Telemetry, EditAnywhere, config)
+	float MinSecondsBetweenHitchDumps;
+
+	/** Format hitch dumps are written in */
+	UPROPERTY(Category = Telemetry, EditAnywhere, config)
+	EAfterCurfewTelemetryFormat HitchDumpFormat;
+
+private:
+	/** Formats DumpSamples and writes them to File, on the thread pool */
+	static bool WriteDump(const TArray<FAfterCurfewTelemetrySample>& DumpSamples, const FString& Reason, EAfterCurfewTelemetryFormat Format, const FString& File);
+
+	FSamples Samples;
+
+	/** Copy of the window being written, reserved on begin play */
+	TArray<FAfterCurfewTelemetrySample> DumpSamples;
+
+	TFuture<bool> PendingDump;
+
+	/** Counters at the previous sample */
+	FAfterCurfewCounters LastCounters;
+
+	double LastSampleTime;
+
+	/** Frames left until a pending hitch dump, INDEX_NONE for none */
+	int32 HitchDumpCountdown;
+
+	/** Wall time of the last hitch dump */
+	double LastHitchDumpTime;
+};
@@ -0,0 +1,175 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewTraceService.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewWorldManager.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Trace Service Submit"), STAT_AfterCurfewTraceSubmit, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Traces Requested"), STAT_AfterCurfewTracesRequested, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Traces Submitted"), STAT_AfterCurfewTracesSubmitted, STATGROUP_AfterCurfew);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Traces Deferred"), STAT_AfterCurfewTracesDeferred, STATGROUP_AfterCurfew);
+
+AAfterCurfewTraceService::AAfterCurfewTraceService()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+
+	MaxTracesPerFrame = 64;
+	ResultLifetimeFrames = 2;
+
+	LastRequestId = 0;
+
+	TraceDoneDelegate.BindUObject(this, &AAfterCurfewTraceService::OnTraceDone);
+}
+
+AAfterCurfewTraceService* AAfterCurfewTraceService::Get(UWorld* World)
+{
+	return FindOrSpawnWorldManager<AAfterCurfewTraceService>(World);
+}
+
+FAfterCurfewTraceHandle AAfterCurfewTraceService::RequestLineTrace(const FVector& Start, const FVector& End, ECollisionChannel Channel, const FCollisionQueryParams& Params, EAfterCurfewTracePriority Priority)
+{
+	return QueueRequest(Start, End, Channel, FCollisionShape(), Params, Priority, false);
+}
+
+FAfterCurfewTraceHandle AAfterCurfewTraceService::RequestSweep(const FVector& Start, const FVector& End, ECollisionChannel Channel, const FCollisionShape& Shape, const FCollisionQueryParams& Params, EAfterCurfewTracePriority Priority)
+{
+	return QueueRequest(Start, End, Channel, Shape, Params, Priority, true);
+}
+
+FAfterCurfewTraceHandle AAfterCurfewTraceService::QueueRequest(const FVector& Start, const FVector& End, ECollisionChannel Channel, const FCollisionShape& Shape, const FCollisionQueryParams& Params, EAfterCurfewTracePriority Priority, bool bSweep)
+{
+	INC_DWORD_STAT(STAT_AfterCurfewTracesRequested);
+
+	// Skip 0 on wrap around, it marks an invalid handle
+	LastRequestId = LastRequestId == MAX_uint32 ? 1 : LastRequestId + 1;
+
+	FTraceRequest& Request = Queued[Queued.AddDefaulted()];
+	Request.Id = LastRequestId;
+	Request.Start = Start;
+	Request.End = End;
+	Request.Shape = Shape;
+	Request.Params = Params;
+	Request.RequestFrame = GFrameCounter;
+	Request.Channel = Channel;
+	Request.Priority = Priority;
+	Request.bSweep = bSweep;
+	QueuedIds.Add(LastRequestId);
+
+	FAfterCurfewTraceHandle Handle;
+	Handle.Id = LastRequestId;
+	return Handle;
+}
+
+EAfterCurfewTraceStatus AAfterCurfewTraceService::FetchResult(const FAfterCurfewTraceHandle& Handle, FHitResult& OutHit)
+{
+	if (!Handle.IsValid())
+	{
+		return EAfterCurfewTraceStatus::Invalid;
+	}
+
+	const FTraceResult* Result = Results.Find(Handle.Id);
+	if (Result == nullptr)
+	{
+		return QueuedIds.Contains(Handle.Id) ? EAfterCurfewTraceStatus::Pending : EAfterCurfewTraceStatus::Invalid;
+	}
+	if (Result->DoneFrame == 0)
+	{
+		return EAfterCurfewTraceStatus::Pending;
+	}
+
+	OutHit = Result->Hit;
+	Results.Remove(Handle.Id);
+	return EAfterCurfewTraceStatus::Done;
+}
+
+void AAfterCurfewTraceService::Cancel(const FAfterCurfewTraceHandle& Handle)
+{
+	// A queued request stays in Queued until the next submit drops it
+	if (Handle.IsValid() && Results.Remove(Handle.Id) == 0)
+	{
+		QueuedIds.Remove(Handle.Id);
+	}
+}
+
+void AAfterCurfewTraceService::OnTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceData)
+{
+	// Cancelled while it ran
+	FTraceResult* Result = Results.Find(TraceData.UserData);
+	if (Result == nullptr)
+	{
+		return;
+	}
+
+	Result->DoneFrame = GFrameCounter;
+	if (TraceData.OutHits.Num() > 0)
+	{
+		Result->Hit = TraceData.OutHits[0];
+	}
+	else
+	{
+		Result->Hit = FHitResult(TraceData.Start, TraceData.End);
+	}
+}
+
+void AAfterCurfewTraceService::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	// Drop results their requester never came back for
+	for (auto It = Results.CreateIterator(); It; ++It)
+	{
+		if (It.Value().DoneFrame != 0 && It.Value().DoneFrame + ResultLifetimeFrames < GFrameCounter)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	// Every id is queued once, so a difference means some were cancelled
+	if (Queued.Num() != QueuedIds.Num())
+	{
+		Queued.RemoveAll([this](const FTraceRequest& Request) { return !QueuedIds.Contains(Request.Id); });
+	}
+
+	if (Queued.Num() == 0)
+	{
+		SET_DWORD_STAT(STAT_AfterCurfewTracesDeferred, 0);
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewTraceSubmit);
+
+	// Highest priority first, then oldest first so a deferred request is not starved by its own priority
+	if (Queued.Num() > MaxTracesPerFrame)
+	{
+		Queued.StableSort([](const FTraceRequest& A, const FTraceRequest& B)
+		{
+			return A.Priority != B.Priority ? A.Priority > B.Priority : A.RequestFrame < B.RequestFrame;
+		});
+	}
+
+	UWorld* World = GetWorld();
+	const int32 NumToSubmit = FMath::Min(Queued.Num(), MaxTracesPerFrame);
+	for (int32 Index = 0; Index < NumToSubmit; ++Index)
+	{
+		const FTraceRequest& Request = Queued[Index];
+		if (Request.bSweep)
+		{
+			World->AsyncSweepByChannel(EAsyncTraceType::Single, Request.Start, Request.End, FQuat::Identity, Request.Channel, Request.Shape, Request.Params, FCollisionResponseParams::DefaultResponseParam, &TraceDoneDelegate, Request.Id);
+		}
+		else
+		{
+			World->AsyncLineTraceByChannel(EAsyncTraceType::Single, Request.Start, Request.End, Request.Channel, Request.Params, FCollisionResponseParams::DefaultResponseParam, &TraceDoneDelegate, Request.Id);
+		}
+
+		FTraceResult& Result = Results.Add(Request.Id);
+		Result.DoneFrame = 0;
+		QueuedIds.Remove(Request.Id);
+	}
+	Queued.RemoveAt(0, NumToSubmit, false);
+
+	INC_DWORD_STAT_BY(STAT_AfterCurfewTracesSubmitted, NumToSubmit);
+	SET_DWORD_STAT(STAT_AfterCurfewTracesDeferred, Queued.Num());
+}
@@ -0,0 +1,133 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "CollisionQueryParams.h"
+#include "Engine/EngineTypes.h"
+#include "WorldCollision.h"
+#include "AfterCurfewTraceService.generated.h"
+
+/** Order in which queued traces get the frame's budget */
+UENUM()
+enum class EAfterCurfewTracePriority : uint8
+{
+	Low,
+	Normal,
+	High,
+};
+
+/** Where a requested trace is at */
+enum class EAfterCurfewTraceStatus : uint8
+{
+	/** Unknown handle, or the trace was cancelled or its result expired */
+	Invalid,
+	/** Queued or running */
+	Pending,
+	/** Finished, the hit result has been handed out */
+	Done,
+};
+
+/** Refers to a trace requested from the trace service */
+struct FAfterCurfewTraceHandle
+{
+	FAfterCurfewTraceHandle()
+		: Id(0)
+	{
+	}
+
+	FORCEINLINE bool IsValid() const { return Id != 0; }
+
+	FORCEINLINE void Reset() { Id = 0; }
+
+	uint32 Id;
+};
+
+/**
+ * Runs the line traces and sweeps of every pawn in a world as asynchronous scene queries.
+ * Requests are collected during the frame and submitted together at its end, highest priority first and oldest
+ * first within a priority, no more than MaxTracesPerFrame of them. The rest wait for a later frame.
+ * Results arrive at the start of the next frame and are fetched through the handle a request returned.
+ * A result nobody fetched is thrown away after ResultLifetimeFrames frames.
+ */
+UCLASS(config=Game, notplaceable)
+class AFTERCURFEW_API AAfterCurfewTraceService : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AAfterCurfewTraceService();
+
+	/** Returns the trace service for this world, creating it on first use */
+	static AAfterCurfewTraceService* Get(UWorld* World);
+
+	// Begin Actor Interface
+	virtual void Tick(float DeltaSeconds) override;
+	// End Actor Interface
+
+	/** Queues a line trace for the first blocking hit on Channel */
+	FAfterCurfewTraceHandle RequestLineTrace(const FVector& Start, const FVector& End, ECollisionChannel Channel, const FCollisionQueryParams& Params, EAfterCurfewTracePriority Priority = EAfterCurfewTracePriority::Normal);
+
+	/** Queues a sweep of Shape for the first blocking hit on Channel */
+	FAfterCurfewTraceHandle RequestSweep(const FVector& Start, const FVector& End, ECollisionChannel Channel, const FCollisionShape& Shape, const FCollisionQueryParams& Params, EAfterCurfewTracePriority Priority = EAfterCurfewTracePriority::Normal);
+
+	/** Returns the status of the trace behind Handle, once Done the result is in OutHit and the handle is spent */
+	EAfterCurfewTraceStatus FetchResult(const FAfterCurfewTraceHandle& Handle, FHitResult& OutHit);
+
+	/** Drops the trace behind Handle, its result is discarded if it is already running */
+	void Cancel(const FAfterCurfewTraceHandle& Handle);
+
+	/** Number of requests waiting to be submitted */
+	FORCEINLINE int32 GetNumQueued() const { return QueuedIds.Num(); }
+
+	/** Most traces submitted in one frame */
+	UPROPERTY(Category = Trace, EditAnywhere, config, meta = (ClampMin = "1"))
+	int32 MaxTracesPerFrame;
+
+	/** Frames a result is kept for its requester before it is thrown away */
+	UPROPERTY(Category = Trace, EditAnywhere, config, meta = (ClampMin = "1"))
+	int32 ResultLifetimeFrames;
+
+private:
+	struct FTraceRequest
+	{
+		uint32 Id;
+		FVector Start;
+		FVector End;
+		FCollisionShape Shape;
+		FCollisionQueryParams Params;
+		uint64 RequestFrame;
+		TEnumAsByte<ECollisionChannel> Channel;
+		EAfterCurfewTracePriority Priority;
+		bool bSweep;
+	};
+
+	/** A submitted trace, and its hit once it finished */
+	struct FTraceResult
+	{
+		FHitResult Hit;
+
+		/** Frame the trace finished on, 0 while it is running */
+		uint64 DoneFrame;
+	};
+
+	FAfterCurfewTraceHandle QueueRequest(const FVector& Start, const FVector& End, ECollisionChannel Channel, const FCollisionShape& Shape, const FCollisionQueryParams& Params, EAfterCurfewTracePriority Priority, bool bSweep);
+
+	/** Called by the world with the hits of a trace we submitted */
+	void OnTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceData);
+
+	/** Requests not submitted yet, cancelled ones included until the next submit */
+	TArray<FTraceRequest> Queued;
+
+	/** Ids of the requests in Queued that were not cancelled, so fetching a queued request does not search Queued */
+	TSet<uint32> QueuedIds;
+
+	/** Submitted traces by request id */
+	TMap<uint32, FTraceResult> Results;
+
+	FTraceDelegate TraceDoneDelegate;
+
+	/** Id of the last request, 0 is never used */
+	uint32 LastRequestId;
+};
@@ -0,0 +1,523 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewWeaponComponent.h"
+#include "AfterCurfew.h"
+#include "AfterCurfewEffectPool.h"
+#include "AfterCurfewFireAudioComponent.h"
+#include "AfterCurfewLagCompensation.h"
+#include "AfterCurfewLog.h"
+#include "AfterCurfewPawn.h"
+#include "AfterCurfewProjectile.h"
+#include "AfterCurfewProjectilePool.h"
+#include "AfterCurfewWeaponDefinition.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PawnMovementComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "Net/UnrealNetwork.h"
+#include "Particles/ParticleSystem.h"
+#include "Sound/SoundBase.h"
+
+DECLARE_CYCLE_STAT(TEXT("Weapon Tick"), STAT_AfterCurfewWeaponTick, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Fire Shot"), STAT_AfterCurfewFireShot, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Projectile Spawn"), STAT_AfterCurfewProjectileSpawn, STATGROUP_AfterCurfew);
+DECLARE_CYCLE_STAT(TEXT("Fire Sound"), STAT_AfterCurfewFireSound, STATGROUP_AfterCurfew);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Shots Fired"), STAT_AfterCurfewShots, STATGROUP_AfterCurfew);
+
+/** Most shots fired in one tick, any more due after a hitch are dropped */
+static const int32 MaxShotsPerTick = 8;
+
+/** Seconds of fire a client's shots may arrive bunched up by, to the server */
+static const float MaxShotBunching = 0.25f;
+
+/** Packs how long ago a shot left into a byte, as a fraction of MaxShotBunching */
+static FORCEINLINE uint8 CompressShotAge(float Age)
+{
+	return uint8(FMath::RoundToInt(FMath::Clamp(Age / MaxShotBunching, 0.f, 1.f) * 255.f));
+}
+
+static FORCEINLINE float DecompressShotAge(uint8 CompressedAge)
+{
+	return CompressedAge * (MaxShotBunching / 255.f);
+}
+
+/** Equips every pawn in the world with the named weapon, or the defaults without a name */
+static void EquipWeaponOnAllPawns(const TArray<FString>& Args, UWorld* World)
+{
+	const FPrimaryAssetId NewWeaponId = Args.Num() > 0 ? FPrimaryAssetId(UAfterCurfewWeaponDefinition::PrimaryAssetType, FName(*Args[0])) : FPrimaryAssetId();
+	for (TActorIterator<APawn> It(World); It; ++It)
+	{
+		if (UAfterCurfewWeaponComponent* Weapon = It->FindComponentByClass<UAfterCurfewWeaponComponent>())
+		{
+			Weapon->EquipWeapon(NewWeaponId);
+		}
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs EquipWeaponCommand(
+	TEXT("ac.Weapon.Equip"),
+	TEXT("Swaps every pawn's weapon for the named weapon definition, or back to the defaults without a name.\n")
+	TEXT("Run it on the server in a networked game, clients follow."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&EquipWeaponOnAllPawns));
+
+UAfterCurfewWeaponComponent::UAfterCurfewWeaponComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	bReplicates = true;
+
+	ProjectileBackend = EAfterCurfewProjectileBackend::Actor;
+
+	WeaponDefinition = nullptr;
+	bWantsToFire = false;
+	bWasFiring = false;
+	ShotCooldown = 0.f;
+	bCosmeticsEnabled = true;
+	FireAudio = nullptr;
+	LastShotId = 0;
+	LastServerShotTime = -BIG_NUMBER;
+	WeaponSeed = 0;
+}
+
+void UAfterCurfewWeaponComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UAfterCurfewWeaponComponent, WeaponId);
+	DOREPLIFETIME_CONDITION(UAfterCurfewWeaponComponent, WeaponSeed, COND_OwnerOnly);
+}
+
+void UAfterCurfewWeaponComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Fire along the facing movement settled on this frame
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	if (Pawn != nullptr && Pawn->GetMovementComponent() != nullptr)
+	{
+		AddTickPrerequisiteComponent(Pawn->GetMovementComponent());
+	}
+
+	// Creating the pool here pre-warms it before the first shot instead of during it
+	ProjectilePool = AAfterCurfewProjectilePool::Get(GetWorld());
+
+	FireAudio = GetOwner()->FindComponentByClass<UAfterCurfewFireAudioComponent>();
+	EffectPool = AAfterCurfewEffectPool::Get(GetWorld());
+
+	if (GetOwner()->HasAuthority())
+	{
+		LagCompensation = AAfterCurfewLagCompensation::Get(GetWorld());
+	}
+
+	LoadWeapon();
+}
+
+void UAfterCurfewWeaponComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (WeaponLoadHandle.IsValid())
+	{
+		WeaponLoadHandle->CancelHandle();
+		WeaponLoadHandle.Reset();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+const UAfterCurfewWeaponDefinition* UAfterCurfewWeaponComponent::GetWeaponDefinition() const
+{
+	return WeaponDefinition != nullptr ? WeaponDefinition : GetDefault<UAfterCurfewWeaponDefinition>();
+}
+
+void UAfterCurfewWeaponComponent::SetWeaponSeed(int32 Seed)
+{
+	WeaponSeed = Seed;
+	WeaponRandom.Initialize(Seed);
+}
+
+void UAfterCurfewWeaponComponent::OnRep_WeaponSeed()
+{
+	WeaponRandom.Initialize(WeaponSeed);
+}
+
+void UAfterCurfewWeaponComponent::RestoreFireState(float Cooldown, bool bFiring)
+{
+	ShotCooldown = Cooldown;
+	bWasFiring = bFiring;
+}
+
+void UAfterCurfewWeaponComponent::EquipWeapon(FPrimaryAssetId NewWeaponId)
+{
+	if (NewWeaponId != WeaponId)
+	{
+		WeaponId = NewWeaponId;
+		LoadWeapon();
+	}
+}
+
+void UAfterCurfewWeaponComponent::OnRep_WeaponId()
+{
+	LoadWeapon();
+}
+
+void UAfterCurfewWeaponComponent::LoadWeapon()
+{
+	if (WeaponLoadHandle.IsValid())
+	{
+		WeaponLoadHandle->CancelHandle();
+		WeaponLoadHandle.Reset();
+	}
+
+	// The class defaults are always in memory, only their assets need loading
+	if (!WeaponId.IsValid())
+	{
+		WeaponDefinition = nullptr;
+
+		TArray<FSoftObjectPath> AssetsToLoad;
+		GetDefault<UAfterCurfewWeaponDefinition>()->GatherGameAssets(AssetsToLoad);
+		WeaponLoadHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(AssetsToLoad);
+		return;
+	}
+
+	// Pawns equipping the same weapon share the one definition the asset manager loads
+	TArray<FName> Bundles;
+	Bundles.Add(TEXT("Game"));
+	WeaponLoadHandle = UAssetManager::Get().LoadPrimaryAsset(WeaponId, Bundles, FStreamableDelegate::CreateUObject(this, &UAfterCurfewWeaponComponent::OnWeaponLoaded, WeaponId));
+}
+
+void UAfterCurfewWeaponComponent::OnWeaponLoaded(FPrimaryAssetId LoadedWeaponId)
+{
+	// Another weapon was equipped while this one was loading
+	if (LoadedWeaponId != WeaponId)
+	{
+		return;
+	}
+
+	WeaponDefinition = UAssetManager::Get().GetPrimaryAssetObject<UAfterCurfewWeaponDefinition>(LoadedWeaponId);
+	if (WeaponDefinition == nullptr)
+	{
+		UE_LOG(LogAfterCurfew, Warning, TEXT("%s: weapon %s is not a weapon definition, using the defaults"), *GetOwner()->GetName(), *LoadedWeaponId.ToString());
+		return;
+	}
+
+	AC_LOG(Weapon, Log, TEXT("%s equipped %s"), *GetOwner()->GetName(), *LoadedWeaponId.ToString());
+}
+
+void UAfterCurfewWeaponComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction *ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewWeaponTick);
+
+	// Time past a due shot only carries over while the trigger stays held, a fresh press fires now
+	ShotCooldown -= DeltaTime;
+	if (!bWantsToFire || !bWasFiring)
+	{
+		ShotCooldown = FMath::Max(ShotCooldown, 0.f);
+	}
+	bWasFiring = bWantsToFire;
+
+	// Fire every shot due this frame if fire button is being held down, along the forward vector of the ship
+	if (bWantsToFire)
+	{
+		const FVector Forward = GetOwner()->GetActorForwardVector();
+		const FVector FireDirection(Forward.X, Forward.Y, 0.f);
+		const float FireRate = GetWeaponDefinition()->FireRate;
+		for (int32 NumShots = 0; ShotCooldown <= 0.f && NumShots < MaxShotsPerTick; ++NumShots)
+		{
+			if (!FireShot(FireDirection, -ShotCooldown))
+			{
+				break;
+			}
+			ShotCooldown += FireRate;
+		}
+		ShotCooldown = FMath::Max(ShotCooldown, 0.f);
+	}
+}
+
+bool UAfterCurfewWeaponComponent::FireShot(FVector FireDirection, float Age)
+{
+	// If we are pressing fire stick in a direction
+	if (FireDirection.SizeSquared() > 0.0f)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_AfterCurfewFireShot);
+		INC_DWORD_STAT(STAT_AfterCurfewShots);
+
+		const UAfterCurfewWeaponDefinition* Weapon = GetWeaponDefinition();
+		AActor* const Owner = GetOwner();
+
+		// Add slight variance for better looking bullet spread, drawn from our own stream so shots can be re-simulated.
+		const FRotator FireRotation = FireDirection.Rotation().Add(0, WeaponRandom.FRandRange(-Weapon->FireSpread, Weapon->FireSpread), 0);
+
+		// Spawn projectile at an offset from where this pawn was when the shot was due, and as far along as it has flown since
+		const FVector SpawnLocation = Owner->GetActorLocation() - Owner->GetVelocity() * Age + FireRotation.RotateVector(Weapon->GunOffset);
+		const float Speed = FMath::Min(Weapon->ProjectileInitialSpeed, Weapon->ProjectileMaxSpeed);
+
+		AAfterCurfewProjectile* Projectile = SpawnProjectile(SpawnLocation + FireRotation.Vector() * (Speed * Age), FireRotation);
+
+		if (Owner->Role == ROLE_AutonomousProxy)
+		{
+			// Our shot is predicted, the server spawns its own and shows it to everyone else
+			FPredictedShot Shot;
+			Shot.ShotId = ++LastShotId;
+			Shot.Projectile = Projectile;
+			Shot.PoolSerial = Projectile != nullptr ? Projectile->GetPoolSerial() : 0;
+			PredictedShots.Push(Shot);
+
+			// The server checks the location against where it has us, so it gets the age to advance the shot with
+			ServerFire(Shot.ShotId, SpawnLocation, FRotator::CompressAxisToShort(FireRotation.Yaw), CompressShotAge(Age));
+		}
+		else if (Owner->Role == ROLE_Authority && GetNetMode() != NM_Standalone)
+		{
+			LastServerShotTime = GetWorld()->GetTimeSeconds();
+			MulticastFire(SpawnLocation, FRotator::CompressAxisToShort(FireRotation.Yaw));
+		}
+
+		PlayFireSound(Owner->GetActorLocation());
+		PlayShotEffects(SpawnLocation, FireRotation, Projectile);
+		return true;
+	}
+	return false;
+}
+
+AAfterCurfewProjectile* UAfterCurfewWeaponComponent::SpawnProjectile(const FVector& Location, const FRotator& Rotation)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewProjectileSpawn);
+
+	UWorld* const World = GetWorld();
+	if (World == nullptr)
+	{
+		return nullptr;
+	}
+
+	const UAfterCurfewWeaponDefinition* Weapon = GetWeaponDefinition();
+	const FTransform SpawnTransform(Rotation, Location, FVector(Weapon->ProjectileScale));
+	if (AAfterCurfewProjectileBatch::ResolveBackend(ProjectileBackend) == EAfterCurfewProjectileBackend::Batched)
+	{
+		if (!ProjectileBatch.IsValid())
+		{
+			ProjectileBatch = AAfterCurfewProjectileBatch::Get(World);
+		}
+		if (ProjectileBatch.IsValid())
+		{
+			ProjectileBatch->Fire(SpawnTransform, Weapon->ProjectileInitialSpeed, Weapon->ProjectileMaxSpeed, GetOwner());
+		}
+		return nullptr;
+	}
+
+	// take the projectile from the pool
+	if (!ProjectilePool.IsValid())
+	{
+		ProjectilePool = AAfterCurfewProjectilePool::Get(World);
+	}
+	return ProjectilePool.IsValid() ? ProjectilePool->Acquire(SpawnTransform, Weapon->ProjectileInitialSpeed, Weapon->ProjectileMaxSpeed, GetOwner(), Weapon->ProjectileMesh.Get()) : nullptr;
+}
+
+void UAfterCurfewWeaponComponent::PlayFireSound(const FVector& Location) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_AfterCurfewFireSound);
+
+	if (!bCosmeticsEnabled)
+	{
+		return;
+	}
+
+	// Voices are pooled and bursts share one loop when the owner has fire audio
+	if (FireAudio != nullptr)
+	{
+		FireAudio->NotifyShot(GetWeaponDefinition(), Location);
+		return;
+	}
+
+	// Still loading, the shot goes out silent
+	USoundBase* FireSound = GetWeaponDefinition()->FireSound.Get();
+	if (FireSound != nullptr)
+	{
+		UGameplayStatics::PlaySoundAtLocation(this, FireSound, Location);
+	}
+}
+
+void UAfterCurfewWeaponComponent::PlayShotEffects(const FVector& Location, const FRotator& Rotation, AAfterCurfewProjectile* Projectile)
+{
+	AAfterCurfewEffectPool* const Effects = EffectPool.Get();
+	if (!bCosmeticsEnabled || Effects == nullptr)
+	{
+		return;
+	}
+
+	// Effects still loading are skipped by the pool
+	const UAfterCurfewWeaponDefinition* Weapon = GetWeaponDefinition();
+	Effects->PlayEffect(EAfterCurfewEffectType::Muzzle, Weapon->MuzzleEffect.Get(), Location, Rotation, Weapon->MuzzleEffectScale);
+	if (Projectile != nullptr)
+	{
+		Effects->PlayTrail(Weapon->TrailEffect.Get(), Projectile->GetRootComponent(), Weapon->TrailEffectScale);
+	}
+}
+
+bool UAfterCurfewWeaponComponent::ServerFire_Validate(uint8 ShotId, FVector_NetQuantize10 Location, uint16 CompressedYaw, uint8 CompressedAge)
+{
+	// Every yaw and age fits in its bits, only a location no honest client could send drops it
+	return !Location.ContainsNaN() && FMath::Abs(Location.X) < HALF_WORLD_MAX && FMath::Abs(Location.Y) < HALF_WORLD_MAX && FMath::Abs(Location.Z) < HALF_WORLD_MAX;
+}
+
+void UAfterCurfewWeaponComponent::ServerFire_Implementation(uint8 ShotId, FVector_NetQuantize10 Location, uint16 CompressedYaw, uint8 CompressedAge)
+{
+	const UAfterCurfewWeaponDefinition* Weapon = GetWeaponDefinition();
+
+	// Allow for shots bunching up on the way over and several fired in one frame, but not for firing faster than the weapon can
+	const float Now = GetWorld()->GetTimeSeconds();
+	const float ShotTime = FMath::Max(LastServerShotTime + Weapon->FireRate, Now - MaxShotBunching);
+	const bool bTooSoon = ShotTime > Now + Weapon->FireRate * 0.5f;
+	const bool bTooFar = FVector::DistSquared(Location, GetOwner()->GetActorLocation()) > FMath::Square(Weapon->GunOffset.Size() + Weapon->MaxShotLocationError);
+	if (bTooSoon || bTooFar)
+	{
+		AC_LOG(Weapon, Verbose, TEXT("%s: rejected shot %d, %s"), *GetOwner()->GetName(), ShotId, bTooSoon ? TEXT("too soon") : TEXT("too far"));
+		ClientRejectShot(ShotId);
+		return;
+	}
+	LastServerShotTime = ShotTime;
+
+	// Start where the client's predicted projectile started, as far along as it flew since the shot was due
+	const FRotator Rotation(0.f, FRotator::DecompressAxisFromShort(CompressedYaw), 0.f);
+	const FVector Velocity = Rotation.Vector() * FMath::Min(Weapon->ProjectileInitialSpeed, Weapon->ProjectileMaxSpeed);
+	const FVector SpawnLocation = Location + Velocity * DecompressShotAge(CompressedAge);
+	SpawnProjectile(SpawnLocation, Rotation);
+	MulticastFire(Location, CompressedYaw);
+
+	// Our projectile left a round trip late, so its hits on pawns are the client's to report and ours to check
+	if (LagCompensation.IsValid())
+	{
+		const APawn* Pawn = Cast<APawn>(GetOwner());
+
+		FServerShot Shot;
+		Shot.ShotId = ShotId;
+		Shot.Origin = SpawnLocation;
+		Shot.Velocity = Velocity;
+		Shot.FireTime = LagCompensation->GetClientViewTime(Pawn != nullptr ? Pawn->GetController() : nullptr);
+		ServerShots.Push(Shot);
+	}
+}
+
+void UAfterCurfewWeaponComponent::NotifyProjectileHit(AAfterCurfewProjectile* Projectile, AActor* OtherActor, const FVector& Location, const FVector& Normal)
+{
+	// Impacts land wherever the shot went, however far its shooter is, the pool culls them by distance to the view
+	if (EffectPool.IsValid())
+	{
+		const UAfterCurfewWeaponDefinition* Weapon = GetWeaponDefinition();
+		EffectPool->PlayEffect(EAfterCurfewEffectType::Impact, Weapon->ImpactEffect.Get(), Location, Normal.Rotation(), Weapon->ImpactEffectScale);
+	}
+
+	AAfterCurfewPawn* Target = Cast<AAfterCurfewPawn>(OtherActor);
+	AAfterCurfewPawn* Pawn = Cast<AAfterCurfewPawn>(GetOwner());
+	if (Target == nullptr || Pawn == nullptr || Target == Pawn)
+	{
+		return;
+	}
+
+	if (Pawn->Role == ROLE_AutonomousProxy)
+	{
+		// Only our own predicted projectiles know which shot they are
+		for (int32 Index = PredictedShots.Num() - 1; Index >= 0 && Projectile != nullptr; --Index)
+		{
+			const FPredictedShot& Shot = PredictedShots[Index];
+			if (Shot.Projectile.Get() == Projectile && Shot.PoolSerial == Projectile->GetPoolSerial())
+			{
+				ServerConfirmHit(Shot.ShotId, Target, Location);
+				break;
+			}
+		}
+	}
+	else if (Pawn->Role == ROLE_Authority && (Pawn->IsLocallyControlled() || !Pawn->IsPlayerControlled()))
+	{
+		// Fired here and now, there is nothing to rewind
+		if (LagCompensation.IsValid())
+		{
+			LagCompensation->ConfirmHit(Pawn, Target, Location);
+		}
+	}
+}
+
+bool UAfterCurfewWeaponComponent::ServerConfirmHit_Validate(uint8 ShotId, AAfterCurfewPawn* Target, FVector_NetQuantize10 Location)
+{
+	return true;
+}
+
+void UAfterCurfewWeaponComponent::ServerConfirmHit_Implementation(uint8 ShotId, AAfterCurfewPawn* Target, FVector_NetQuantize10 Location)
+{
+	AAfterCurfewLagCompensation* const LagComp = LagCompensation.Get();
+	if (LagComp == nullptr || Target == nullptr)
+	{
+		return;
+	}
+
+	const UAfterCurfewWeaponDefinition* Weapon = GetWeaponDefinition();
+	const UStaticMesh* Mesh = Weapon->ProjectileMesh.Get();
+
+	// Newest first, shot ids wrap around
+	for (int32 Index = ServerShots.Num() - 1; Index >= 0; --Index)
+	{
+		FServerShot& Shot = ServerShots[Index];
+		if (Shot.ShotId != ShotId)
+		{
+			continue;
+		}
+
+		// A projectile stops at its first hit, a repeated report of it is neither confirmed nor rejected again
+		if (Shot.bHit)
+		{
+			return;
+		}
+
+		FAfterCurfewRewindShot RewindShot;
+		RewindShot.Origin = Shot.Origin;
+		RewindShot.Velocity = Shot.Velocity;
+		RewindShot.Radius = Mesh != nullptr ? Mesh->GetBounds().SphereRadius * Weapon->ProjectileScale : 0.f;
+		RewindShot.FireTime = Shot.FireTime;
+		RewindShot.MaxFlightTime = GetDefault<AAfterCurfewProjectile>()->InitialLifeSpan;
+		float HitTime;
+		if (LagComp->ValidateHit(RewindShot, Target, HitTime))
+		{
+			Shot.bHit = true;
+			const FVector HitPoint = Shot.Origin + Shot.Velocity * (HitTime - Shot.FireTime);
+			LagComp->ConfirmHitIfUnobstructed(Cast<AAfterCurfewPawn>(GetOwner()), Target, Location, Shot.Origin, HitPoint);
+			return;
+		}
+		break;
+	}
+
+	AC_LOG(Weapon, Verbose, TEXT("%s: rejected hit of shot %d on %s"), *GetOwner()->GetName(), ShotId, *Target->GetName());
+	LagComp->RejectHit();
+}
+
+void UAfterCurfewWeaponComponent::ClientRejectShot_Implementation(uint8 ShotId)
+{
+	for (int32 Index = 0; Index < PredictedShots.Num(); ++Index)
+	{
+		const FPredictedShot& Shot = PredictedShots[Index];
+		AAfterCurfewProjectile* Projectile = Shot.Projectile.Get();
+
+		// The pool may have handed the projectile to a newer shot already
+		if (Shot.ShotId == ShotId && Projectile != nullptr && Projectile->IsPooledActive() && Projectile->GetPoolSerial() == Shot.PoolSerial)
+		{
+			Projectile->ReturnToPool();
+			break;
+		}
+	}
+}
+
+void UAfterCurfewWeaponComponent::MulticastFire_Implementation(FVector_NetQuantize10 Location, uint16 CompressedYaw)
+{
+	// The server and the shooter already spawned this shot
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	if (GetOwner()->HasAuthority() || (Pawn != nullptr && Pawn->IsLocallyControlled()))
+	{
+		return;
+	}
+
+	const FRotator Rotation(0.f, FRotator::DecompressAxisFromShort(CompressedYaw), 0.f);
+	AAfterCurfewProjectile* Projectile = SpawnProjectile(Location, Rotation);
+	PlayFireSound(Location);
+	PlayShotEffects(Location, Rotation, Projectile);
+}
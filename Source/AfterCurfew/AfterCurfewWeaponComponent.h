@@ -0,0 +1,219 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Engine/NetSerialization.h"
+#include "Engine/StreamableManager.h"
+#include "UObject/PrimaryAssetId.h"
+#include "AfterCurfewProjectileBatch.h"
+#include "AfterCurfewRingBuffer.h"
+#include "AfterCurfewWeaponComponent.generated.h"
+
+class AAfterCurfewEffectPool;
+class AAfterCurfewLagCompensation;
+class AAfterCurfewPawn;
+class AAfterCurfewProjectile;
+class AAfterCurfewProjectilePool;
+class UAfterCurfewWeaponDefinition;
+
+/**
+ * Fires a pawn's weapon.
+ * All tuning comes from a shared UAfterCurfewWeaponDefinition, equipping another one swaps the weapon at runtime.
+ * Ticks after the owner's movement so shots leave along this frame's facing. While the trigger is held every shot due
+ * within the frame is fired, each placed as far along as it would be had it left on time, so the rate of fire does
+ * not depend on the frame rate.
+ *
+ * In a networked game the owning client predicts its shots and sends them to the server, which checks them,
+ * spawns its own projectile and shows the shot to the other clients. Projectile actors are never replicated.
+ * Hits on pawns are decided by the shooter's own projectiles: the owning client reports the hits it predicted and the
+ * server checks each against the shot it accepted and where the target was when the shot was fired, and that no wall
+ * was in its way.
+ */
+UCLASS(ClassGroup = (AfterCurfew), meta = (BlueprintSpawnableComponent))
+class AFTERCURFEW_API UAfterCurfewWeaponComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UAfterCurfewWeaponComponent();
+
+	// Begin ActorComponent Interface
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction *ThisTickFunction) override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	// End ActorComponent Interface
+
+	/** Sets whether we fire this frame, the owner calls this every frame it drives the pawn */
+	FORCEINLINE void SetWantsToFire(bool bWants) { bWantsToFire = bWants; }
+
+	/** Loads the definition with the given id through the asset manager and equips it once loaded, on the server it replicates to clients */
+	UFUNCTION(BlueprintCallable, Category = Weapon)
+	void EquipWeapon(FPrimaryAssetId NewWeaponId);
+
+	/** Returns the equipped definition, the class defaults until one has loaded */
+	const UAfterCurfewWeaponDefinition* GetWeaponDefinition() const;
+
+	/** Reseeds the stream all weapon randomness is drawn from, replays restore the recorded seed through this. The server's seed replicates to the owning client */
+	void SetWeaponSeed(int32 Seed);
+
+	/** Returns the seed the weapon stream started from */
+	FORCEINLINE int32 GetWeaponSeed() const { return WeaponRandom.GetInitialSeed(); }
+
+	/** Returns the seed the weapon stream continues from, reseeding with it draws the same shots from here on */
+	FORCEINLINE int32 GetCurrentWeaponSeed() const { return WeaponRandom.GetCurrentSeed(); }
+
+	/** Returns the seconds until the next shot is due */
+	FORCEINLINE float GetShotCooldown() const { return ShotCooldown; }
+
+	/** Returns true if the owner wanted to fire last tick */
+	FORCEINLINE bool WasFiring() const { return bWasFiring; }
+
+	/** Puts the fire schedule back in a saved state */
+	void RestoreFireState(float Cooldown, bool bFiring);
+
+	/** Turns fire sounds and muzzle and trail effects on or off, shots still fire and impacts still play */
+	FORCEINLINE void SetCosmeticsEnabled(bool bEnabled) { bCosmeticsEnabled = bEnabled; }
+
+	/** Fires a shot in the specified direction as if it left Age seconds ago, returns false if there is no direction */
+	bool FireShot(FVector FireDirection, float Age = 0.f);
+
+	/** Called when one of our projectiles hits OtherActor at Location, Projectile is null for batched ones */
+	void NotifyProjectileHit(AAfterCurfewProjectile* Projectile, AActor* OtherActor, const FVector& Location, const FVector& Normal);
+
+	/** Weapon equipped on begin play, none uses the class defaults */
+	UPROPERTY(Category = Weapon, EditAnywhere, ReplicatedUsing = OnRep_WeaponId)
+	FPrimaryAssetId WeaponId;
+
+	/** Whether bullets are individual actors or simulated in a batch, ac.ProjectileBackend overrides this */
+	UPROPERTY(Category = Weapon, EditAnywhere)
+	EAfterCurfewProjectileBackend ProjectileBackend;
+
+private:
+	/** Shot the owning client spawned before the server accepted it */
+	struct FPredictedShot
+	{
+		uint8 ShotId;
+		TWeakObjectPtr<AAfterCurfewProjectile> Projectile;
+		uint32 PoolSerial;
+
+		FPredictedShot()
+			: ShotId(0)
+			, PoolSerial(0)
+		{
+		}
+	};
+
+	/** Shot the server accepted from the owning client, kept to check the hits reported for it */
+	struct FServerShot
+	{
+		uint8 ShotId;
+		bool bHit;
+		FVector Origin;
+		FVector Velocity;
+
+		/** Server time the client saw the world at when it fired */
+		float FireTime;
+
+		FServerShot()
+			: ShotId(0)
+			, bHit(false)
+			, Origin(FVector::ZeroVector)
+			, Velocity(FVector::ZeroVector)
+			, FireTime(0.f)
+		{
+		}
+	};
+
+	/** Spawns a projectile with the current backend, returns it if it is an actor */
+	AAfterCurfewProjectile* SpawnProjectile(const FVector& Location, const FRotator& Rotation);
+
+	void PlayFireSound(const FVector& Location) const;
+
+	/** Plays the muzzle effect of a shot and the trail of its projectile, if it is an actor */
+	void PlayShotEffects(const FVector& Location, const FRotator& Rotation, AAfterCurfewProjectile* Projectile);
+
+	/** Starts loading WeaponId */
+	void LoadWeapon();
+
+	/** Equips the loaded definition once it and its Game bundle are in memory */
+	void OnWeaponLoaded(FPrimaryAssetId LoadedWeaponId);
+
+	UFUNCTION()
+	void OnRep_WeaponId();
+
+	UFUNCTION()
+	void OnRep_WeaponSeed();
+
+	/** Spawns a shot the owning client already predicted, advanced by how long ago it was due, rejecting it if the client could not have fired it */
+	UFUNCTION(Unreliable, Server, WithValidation)
+	void ServerFire(uint8 ShotId, FVector_NetQuantize10 Location, uint16 CompressedYaw, uint8 CompressedAge);
+
+	/** Reports that a predicted shot hit Target, the server confirms it if the target was in the shot's way back then */
+	UFUNCTION(Reliable, Server, WithValidation)
+	void ServerConfirmHit(uint8 ShotId, AAfterCurfewPawn* Target, FVector_NetQuantize10 Location);
+
+	/** Removes a predicted shot the server did not accept */
+	UFUNCTION(Unreliable, Client)
+	void ClientRejectShot(uint8 ShotId);
+
+	/** Shows a shot on the clients that did not fire it */
+	UFUNCTION(Unreliable, NetMulticast)
+	void MulticastFire(FVector_NetQuantize10 Location, uint16 CompressedYaw);
+
+	/** Equipped definition, shared with every other pawn using it, null while the class defaults are used */
+	UPROPERTY(Transient)
+	UAfterCurfewWeaponDefinition* WeaponDefinition;
+
+	/** Keeps the equipped definition's bundle loaded */
+	TSharedPtr<FStreamableHandle> WeaponLoadHandle;
+
+	/** Flag set while the owner wants to fire */
+	uint32 bWantsToFire : 1;
+
+	/** Flag set if the owner wanted to fire last tick */
+	uint32 bWasFiring : 1;
+
+	/** Flag cleared while the owner is too insignificant for fire sounds and muzzle and trail effects */
+	uint32 bCosmeticsEnabled : 1;
+
+	/** Seconds until the next shot is due, below zero while shots are due this frame */
+	float ShotCooldown;
+
+	/** Stream every weapon random decision is drawn from, seeded by the game mode so shots can be re-simulated from inputs */
+	FRandomStream WeaponRandom;
+
+	/** Seed the server last gave WeaponRandom, the owning client draws its predicted shots from the same stream */
+	UPROPERTY(ReplicatedUsing = OnRep_WeaponSeed)
+	int32 WeaponSeed;
+
+	/** Shots predicted recently, a rejection for an older one comes too late to matter */
+	TAfterCurfewRingBuffer<FPredictedShot, 16> PredictedShots;
+
+	/** Shots accepted from the owning client recently, on the server */
+	TAfterCurfewRingBuffer<FServerShot, 16> ServerShots;
+
+	/** Id of the last shot sent to the server */
+	uint8 LastShotId;
+
+	/** When the server counts the last shot it accepted from us as fired, never before now less MaxShotBunching */
+	float LastServerShotTime;
+
+	/** Pool our projectiles are taken from, cached on BeginPlay */
+	TWeakObjectPtr<AAfterCurfewProjectilePool> ProjectilePool;
+
+	/** Batch simulating our projectiles when using the batched backend */
+	TWeakObjectPtr<AAfterCurfewProjectileBatch> ProjectileBatch;
+
+	/** Pool our effects play through, null where nothing is rendered */
+	TWeakObjectPtr<AAfterCurfewEffectPool> EffectPool;
+
+	/** Pawn history hits are checked against, on the server */
+	TWeakObjectPtr<AAfterCurfewLagCompensation> LagCompensation;
+
+	/** Owner's component voicing our shots, without one each shot plays its own sound */
+	UPROPERTY(Transient)
+	class UAfterCurfewFireAudioComponent* FireAudio;
+};
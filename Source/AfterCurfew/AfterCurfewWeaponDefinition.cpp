@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AfterCurfewWeaponDefinition.h"
+#include "Engine/StaticMesh.h"
+#include "Particles/ParticleSystem.h"
+#include "Sound/SoundBase.h"
+
+const FPrimaryAssetType UAfterCurfewWeaponDefinition::PrimaryAssetType(TEXT("AfterCurfewWeapon"));
+
+UAfterCurfewWeaponDefinition::UAfterCurfewWeaponDefinition()
+{
+	GunOffset = FVector(90.f, 0.f, 0.f);
+	FireRate = 0.1f;
+	FireSpread = 2.5f;
+	MaxShotLocationError = 200.f;
+	ProjectileScale = 1.f;
+	ProjectileInitialSpeed = 3000.f;
+	ProjectileMaxSpeed = 3000.f;
+	ProjectileMesh = TSoftObjectPtr<UStaticMesh>(FSoftObjectPath(TEXT("/Game/TwinStick/Meshes/TwinStickProjectile.TwinStickProjectile")));
+	FireSound = TSoftObjectPtr<USoundBase>(FSoftObjectPath(TEXT("/Game/TwinStick/Audio/TwinStickFire.TwinStickFire")));
+	MuzzleEffect = TSoftObjectPtr<UParticleSystem>(FSoftObjectPath(TEXT("/Game/StarterContent/Particles/P_Explosion.P_Explosion")));
+	MuzzleEffectScale = 0.1f;
+	TrailEffectScale = 1.f;
+	ImpactEffect = TSoftObjectPtr<UParticleSystem>(FSoftObjectPath(TEXT("/Game/StarterContent/Particles/P_Sparks.P_Sparks")));
+	ImpactEffectScale = 0.3f;
+}
+
+FPrimaryAssetId UAfterCurfewWeaponDefinition::GetPrimaryAssetId() const
+{
+	return FPrimaryAssetId(PrimaryAssetType, GetFName());
+}
+
+void UAfterCurfewWeaponDefinition::GatherGameAssets(TArray<FSoftObjectPath>& OutAssets) const
+{
+	const FSoftObjectPath Assets[] =
+	{
+		ProjectileMesh.ToSoftObjectPath(),
+		FireSound.ToSoftObjectPath(),
+		FireLoopSound.ToSoftObjectPath(),
+		FireTailSound.ToSoftObjectPath(),
+		MuzzleEffect.ToSoftObjectPath(),
+		TrailEffect.ToSoftObjectPath(),
+		ImpactEffect.ToSoftObjectPath(),
+	};
+	for (const FSoftObjectPath& Asset : Assets)
+	{
+		if (!Asset.IsNull())
+		{
+			OutAssets.Add(Asset);
+		}
+	}
+}
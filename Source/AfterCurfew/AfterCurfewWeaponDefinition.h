@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "AfterCurfewWeaponDefinition.generated.h"
+
+class UParticleSystem;
+class USoundBase;
+class UStaticMesh;
+
+/**
+ * Tuning of one weapon, shared by every pawn that equips it.
+ * Definitions are primary assets of type AfterCurfewWeapon scanned from /Game/Weapons and loaded through the asset manager.
+ * Their sounds, effects and projectile mesh are soft references in the Game bundle, loaded together with the definition.
+ * The class default object holds the stock twin stick gun and is used until a pawn's definition has loaded.
+ */
+UCLASS(BlueprintType)
+class AFTERCURFEW_API UAfterCurfewWeaponDefinition : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UAfterCurfewWeaponDefinition();
+
+	/** Primary asset type weapon definitions are registered under */
+	static const FPrimaryAssetType PrimaryAssetType;
+
+	// Begin UObject Interface
+	virtual FPrimaryAssetId GetPrimaryAssetId() const override;
+	// End UObject Interface
+
+	/** Adds the set assets of the Game bundle to OutAssets, for loading them without the asset manager */
+	void GatherGameAssets(TArray<FSoftObjectPath>& OutAssets) const;
+
+	/** Offset from the ships location to spawn projectiles */
+	UPROPERTY(Category = Weapon, EditDefaultsOnly, BlueprintReadOnly)
+	FVector GunOffset;
+
+	/* How fast the weapon will fire */
+	UPROPERTY(Category = Weapon, EditDefaultsOnly, BlueprintReadOnly, meta = (ClampMin = "0.01"))
+	float FireRate;
+
+	/* The maximum spread of the bullets */
+	UPROPERTY(Category = Weapon, EditDefaultsOnly, BlueprintReadOnly)
+	float FireSpread;
+
+	/* How far, in cm, a client's shot may start from where the server has the gun before it is rejected */
+	UPROPERTY(Category = Weapon, EditDefaultsOnly, BlueprintReadOnly)
+	float MaxShotLocationError;
+
+	/* The scale of the bullets */
+	UPROPERTY(Category = Projectile, EditDefaultsOnly, BlueprintReadOnly)
+	float ProjectileScale;
+
+	/* The initial speed of the bullets */
+	UPROPERTY(Category = Projectile, EditDefaultsOnly, BlueprintReadOnly)
+	float ProjectileInitialSpeed;
+
+	/* The max speed of the bullets */
+	UPROPERTY(Category = Projectile, EditDefaultsOnly, BlueprintReadOnly)
+	float ProjectileMaxSpeed;
+
+	/** Mesh of the bullets fired as actors, the batched backend keeps its own instanced mesh */
+	UPROPERTY(Category = Projectile, EditDefaultsOnly, BlueprintReadOnly, meta = (AssetBundles = "Game"))
+	TSoftObjectPtr<UStaticMesh> ProjectileMesh;
+
+	/** Sound to play each time we fire, unused when FireLoopSound is set */
+	UPROPERTY(Category = Audio, EditDefaultsOnly, BlueprintReadOnly, meta = (AssetBundles = "Game"))
+	TSoftObjectPtr<USoundBase> FireSound;
+
+	/** Looping sound played for as long as we keep firing, instead of a sound per shot */
+	UPROPERTY(Category = Audio, EditDefaultsOnly, BlueprintReadOnly, meta = (AssetBundles = "Game"))
+	TSoftObjectPtr<USoundBase> FireLoopSound;
+
+	/** Sound played when we stop firing with FireLoopSound */
+	UPROPERTY(Category = Audio, EditDefaultsOnly, BlueprintReadOnly, meta = (AssetBundles = "Game"))
+	TSoftObjectPtr<USoundBase> FireTailSound;
+
+	/** Effect played where each shot leaves the gun */
+	UPROPERTY(Category = Effects, EditDefaultsOnly, BlueprintReadOnly, meta = (AssetBundles = "Game"))
+	TSoftObjectPtr<UParticleSystem> MuzzleEffect;
+
+	UPROPERTY(Category = Effects, EditDefaultsOnly, BlueprintReadOnly)
+	float MuzzleEffectScale;
+
+	/** Effect following each bullet fired as an actor */
+	UPROPERTY(Category = Effects, EditDefaultsOnly, BlueprintReadOnly, meta = (AssetBundles = "Game"))
+	TSoftObjectPtr<UParticleSystem> TrailEffect;
+
+	UPROPERTY(Category = Effects, EditDefaultsOnly, BlueprintReadOnly)
+	float TrailEffectScale;
+
+	/** Effect played where a bullet hits something */
+	UPROPERTY(Category = Effects, EditDefaultsOnly, BlueprintReadOnly, meta = (AssetBundles = "Game"))
+	TSoftObjectPtr<UParticleSystem> ImpactEffect;
+
+	UPROPERTY(Category = Effects, EditDefaultsOnly, BlueprintReadOnly)
+	float ImpactEffectScale;
+};
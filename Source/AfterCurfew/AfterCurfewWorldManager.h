@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+
+/** Returns the single instance of a per-world manager actor if it has been spawned, nullptr otherwise */
+template<typename TManager>
+TManager* FindWorldManager(UWorld* World)
+{
+	if (World == nullptr || World->bIsTearingDown)
+	{
+		return nullptr;
+	}
+
+	for (TActorIterator<TManager> It(World); It; ++It)
+	{
+		if (!It->IsPendingKill())
+		{
+			return *It;
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * Returns the single instance of a per-world manager actor, spawning it on first use.
+ * Callers are expected to cache the result rather than look it up every frame.
+ */
+template<typename TManager>
+TManager* FindOrSpawnWorldManager(UWorld* World)
+{
+	if (World == nullptr || World->bIsTearingDown)
+	{
+		return nullptr;
+	}
+
+	if (TManager* Manager = FindWorldManager<TManager>(World))
+	{
+		return Manager;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	return World->SpawnActor<TManager>(SpawnParams);
+}